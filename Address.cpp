@@ -13,182 +13,111 @@
 // limitations under the License.
 
 #include "Address.hpp"
-#include <regex>
 #include <stdexcept>
+#include <charconv>
+#include <ostream>
 
 namespace PjonHL
 {
 
 // -----------------------------------------------------------------------------
-Address::Address()
+Address::Address(const std::string & f_addrString) : Address(f_addrString.c_str())
 {
 }
 
 // -----------------------------------------------------------------------------
-Address::Address(int f_id) :
-    id(static_cast<uint8_t>(f_id))
+Address::Address(const char* f_addrString)
 {
+    ParseResult result = parse(f_addrString);
+    if(result.error != ParseError::None)
+    {
+        throw(std::runtime_error(std::string("Invalid Address: ") + parseErrorToString(result.error) + " " + f_addrString));
+    }
+    *this = result.address;
 }
 
 // -----------------------------------------------------------------------------
-Address::Address(uint8_t f_id) :
-    id(f_id)
+Expect<Address> Address::tryParse(std::string_view f_addrString) noexcept
 {
+    ParseResult result = parse(f_addrString);
+    if(result.error != ParseError::None)
+    {
+        return Expect<Address>();
+    }
+    return Expect<Address>(std::move(result.address));
 }
 
 // -----------------------------------------------------------------------------
-Address::Address(const std::string & f_addrString) : Address(f_addrString.c_str())
+const char * Address::parseErrorToString(ParseError f_error)
 {
+    switch(f_error)
+    {
+        case ParseError::None:
+            return "No error.";
+        case ParseError::Format:
+            return "Invalid format, expected [Bus/]Device[:Port].";
+        case ParseError::BusIdRange:
+            return "BusId out of range.";
+        case ParseError::DeviceIdRange:
+            return "DeviceId out of range.";
+        case ParseError::PortRange:
+            return "Port out of range.";
+    }
+    return "Unknown error.";
 }
 
 // -----------------------------------------------------------------------------
-Address::Address(const char* f_addrString)
+char * Address::toChars(char * f_first, char * f_last) const noexcept
 {
-    static const std::regex regex_bus_device_port("(\\d+\\.\\d+\\.\\d+\\.\\d+)\\/(\\d+):(\\d+)");
-    static const std::regex regex_bus_device("(\\d+\\.\\d+\\.\\d+\\.\\d+)\\/(\\d+)");
-    static const std::regex regex_device_port("(\\d+):(\\d+)");
-    static const std::regex regex_device("\\d+");
-    
-    static const std::regex regex_bus("(\\d+)\\.(\\d+)\\.(\\d+)\\.(\\d+)");
-
-    // default values:
-    std::string busStr = "0.0.0.0";
-    std::string devStr = "0";
-    std::string portStr = "0";
-
-    std::cmatch matches;
-    if(std::regex_match(f_addrString, matches, regex_bus_device_port))
+    auto writeNumber = [&f_first, f_last](unsigned f_value, char f_separator) noexcept
     {
-        if(matches.size() < 4)
+        if(f_first == nullptr)
         {
-            throw(std::runtime_error("Invalid Address: Expected Bus/Device:Port. " + std::string(f_addrString)));
+            return;
         }
-        busStr = matches[1];
-        devStr = matches[2];
-        portStr = matches[3];
-    }
-    else if(std::regex_match(f_addrString, matches, regex_bus_device))
-    {
-        if(matches.size() < 3)
-        {
-            throw(std::runtime_error("Invalid Address: Expected Bus/Device. " + std::string(f_addrString)));
-        }
-        busStr = matches[1];
-        devStr = matches[2];
-    }
-    else if(std::regex_match(f_addrString, matches, regex_device_port))
-    {
-        if(matches.size() < 3)
+        std::to_chars_result result = std::to_chars(f_first, f_last, f_value);
+        if(result.ec != std::errc() or (f_separator != 0 and result.ptr == f_last))
         {
-            throw(std::runtime_error("Invalid Address: Expected Device:Port. " + std::string(f_addrString)));
+            f_first = nullptr;
+            return;
         }
-        devStr = matches[1];
-        portStr = matches[2];
-    }
-    else if(std::regex_match(f_addrString, matches, regex_device))
-    {
-        if(matches.size() < 1)
+        f_first = result.ptr;
+        if(f_separator != 0)
         {
-            throw(std::runtime_error("Invalid Address: Expected Device. " + std::string(f_addrString)));
+            *f_first++ = f_separator;
         }
-        devStr = matches[0];
-    }
-    else
-    {
-            throw(std::runtime_error("Invalid Address format" + std::string(f_addrString)));
-    }
-
-
-    // parse bus:
-    std::smatch bus_matches;
-    if(not std::regex_match(busStr, bus_matches, regex_bus))
-    {
-        throw(std::runtime_error("Invalid Address: Error parsing BusId. " + std::string(f_addrString)));
-    }
-    if(bus_matches.size() < 5)
-    {
-        throw(std::runtime_error("Invalid Address: Error parsing BusId. " + std::string(f_addrString)));
-    }
-    for(size_t i = 0; i<4; i++)
-    {
-        size_t pos = 0;
-        long unsigned int value = stoul(bus_matches[i+1], &pos);
-        if(pos == 0)
-        {
-            throw(std::runtime_error("Invalid Address: Error parsing BusId. " + std::string(f_addrString)));
-        }
-        if(value > 0xff)
-        {
-            throw(std::runtime_error("Invalid Address: BusId out of range. " + std::string(f_addrString)));
-        }
-        busId[i] = value;
-    }
-
-    // parse device id:
-    size_t pos = 0;
-    long unsigned int value = stoul(devStr, &pos);
-    if(pos == 0)
-    {
-        throw(std::runtime_error("Invalid Address: Error parsing DeviceId. " + std::string(f_addrString)));
-    }
-    if(value > 0xff)
-    {
-        throw(std::runtime_error("Invalid Address: DeviceId out of range. " + std::string(f_addrString)));
-    }
-    id = value;
-
-    // parse port:
-    pos = 0;
-    value = stoul(portStr, &pos);
-    if(pos == 0)
-    {
-        throw(std::runtime_error("Invalid Address: Error parsing Port. " + std::string(f_addrString)));
-    }
-    if(value > 0xffff)
-    {
-        throw(std::runtime_error("Invalid Address: Port out of range. " + std::string(f_addrString)));
-    }
-    port = value;
+    };
+    writeNumber(busId[0], '.');
+    writeNumber(busId[1], '.');
+    writeNumber(busId[2], '.');
+    writeNumber(busId[3], '/');
+    writeNumber(id, ':');
+    writeNumber(port, 0);
+    return f_first;
 }
 
 // -----------------------------------------------------------------------------
-bool Address::matches(Address f_other, Address f_mask) const
+void Address::appendTo(std::string & f_output) const
 {
-    bool match = true;
-    match = match and maskMatch(id, f_other.id, f_mask.id);
-    match = match and maskMatch(port, f_other.port, f_mask.port);
-    for(int i = 0; i<4; i++)
-    {
-        match = match and maskMatch(busId[i], f_other.busId[i], f_mask.busId[i]);
-    }
-    return match;
+    char buffer[MaxStringLength];
+    char * end = toChars(buffer, buffer + sizeof(buffer));
+    f_output.append(buffer, end);
 }
 
 // -----------------------------------------------------------------------------
-std::string Address::toString()
+std::string Address::toString() const
 {
     std::string result;
-    result += std::to_string(busId[0]) + ".";
-    result += std::to_string(busId[1]) + ".";
-    result += std::to_string(busId[2]) + ".";
-    result += std::to_string(busId[3]) + "/";
-    result += std::to_string(static_cast<uint16_t>(id));
-    result += ":";
-    result += std::to_string(port);
+    appendTo(result);
     return result;
 }
 
 // -----------------------------------------------------------------------------
-Address Address::createAllOneAddress()
+std::ostream & operator<<(std::ostream & f_stream, const Address & f_address)
 {
-    Address mask;
-    mask.id = 0xff;
-    mask.port = 0xffff;
-    mask.busId[0] = 0xff;
-    mask.busId[1] = 0xff;
-    mask.busId[2] = 0xff;
-    mask.busId[3] = 0xff;
-    return mask;
+    char buffer[Address::MaxStringLength];
+    char * end = f_address.toChars(buffer, buffer + sizeof(buffer));
+    return f_stream.write(buffer, end - buffer);
 }
 
 }
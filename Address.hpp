@@ -16,28 +16,52 @@
 
 #include <inttypes.h>
 #include <string>
+#include <string_view>
 #include <array>
 #include <cstring>
+#include <functional>
+#include <iosfwd>
+#include <stdexcept>
+#include "Expect.hpp"
 #include "PJONDefines.h"
 namespace PjonHL
 {
+enum class AddressParseError : uint8_t
+{
+    None,
+    Format,
+    BusIdRange,
+    DeviceIdRange,
+    PortRange
+};
+
+struct AddressParseResult;
+
 struct Address
 {
     /// Construct default address:
     /// deviceId will be 0
     /// busId will be 0.0.0.0
     /// port will be PJON_BROADCAST
-    Address();
+    constexpr Address()
+    {
+    }
 
     /// Construct address with given device Id only.
     /// busId will be 0.0.0.0
     /// port will be PJON_BROADCAST
-    Address(int f_id);
+    constexpr Address(int f_id) :
+        id(static_cast<uint8_t>(f_id))
+    {
+    }
 
     /// Construct address with given device Id only.
     /// busId will be 0.0.0.0
     /// port will be PJON_BROADCAST
-    Address(uint8_t f_id);
+    constexpr Address(uint8_t f_id) :
+        id(f_id)
+    {
+    }
 
     /// Constructs address from given string representation.
     /// Valid String formats:
@@ -64,22 +88,109 @@ struct Address
     /// See Address(const std::string & f_addrString). Uses C style string instead.
     Address(const char* f_addrString);
 
+    using ParseError = AddressParseError;
+    using ParseResult = AddressParseResult;
+
+    /// Parses the string representation of an address (see
+    /// Address(const std::string & f_addrString) for valid formats) in a
+    /// single pass. Does not allocate and does not throw, so it can be used
+    /// at compile time.
+    /// @returns parsed address if error is ParseError::None.
+    static constexpr ParseResult parse(std::string_view f_addrString) noexcept;
+
+    /// Non throwing variant of Address(const std::string & f_addrString).
+    /// @returns the address, or an invalid Expect if f_addrString is not a
+    ///          valid address.
+    static Expect<Address> tryParse(std::string_view f_addrString) noexcept;
+
+    /// @returns human readable description of a parse error.
+    static const char * parseErrorToString(ParseError f_error);
+
     /// Check if this address matches other address given a mask.
     /// @param f_other: other mask to check against
     /// @param f_mask: address to use as a bitwise mask (only bits equal to 1 are included in a match)
     /// @returns true if this address matched other address given the mask.
-    bool matches(Address f_other, Address f_mask) const;
+    constexpr bool matches(Address f_other, Address f_mask) const noexcept
+    {
+        return keyMatches(toKey(), f_other.toKey(), f_mask.toKey());
+    }
+
+    /// Converts the address into its canonical packed 64 bit form ("key"):
+    ///   bits 63..56: 0
+    ///   bits 55..24: busId (busId[0] in most significant byte)
+    ///   bits 23..16: device id
+    ///   bits 15..0:  port
+    /// Two addresses are equal if and only if their keys are equal. Masks
+    /// can be converted the same way, so masked matching is a single
+    /// operation (see keyMatches()).
+    constexpr uint64_t toKey() const noexcept
+    {
+        return
+            (uint64_t(busId[0]) << 48) |
+            (uint64_t(busId[1]) << 40) |
+            (uint64_t(busId[2]) << 32) |
+            (uint64_t(busId[3]) << 24) |
+            (uint64_t(id) << 16) |
+            uint64_t(port);
+    }
+
+    /// Inverse of toKey().
+    static constexpr Address fromKey(uint64_t f_key) noexcept
+    {
+        Address address;
+        address.busId[0] = static_cast<uint8_t>(f_key >> 48);
+        address.busId[1] = static_cast<uint8_t>(f_key >> 40);
+        address.busId[2] = static_cast<uint8_t>(f_key >> 32);
+        address.busId[3] = static_cast<uint8_t>(f_key >> 24);
+        address.id = static_cast<uint8_t>(f_key >> 16);
+        address.port = static_cast<uint16_t>(f_key);
+        return address;
+    }
+
+    /// @returns true if both keys are equal in all bits set in f_maskKey.
+    static constexpr bool keyMatches(uint64_t f_key1, uint64_t f_key2, uint64_t f_maskKey) noexcept
+    {
+        return ((f_key1 ^ f_key2) & f_maskKey) == 0;
+    }
+
+    constexpr bool operator==(const Address & f_other) const noexcept
+    {
+        return toKey() == f_other.toKey();
+    }
+
+    constexpr bool operator!=(const Address & f_other) const noexcept
+    {
+        return toKey() != f_other.toKey();
+    }
+
+    /// Maximum number of characters written by toChars(), e.g.
+    /// "255.255.255.255/255:65535". No null terminator is written.
+    static constexpr size_t MaxStringLength = 25;
+
+    /// Writes the string representation (see toString()) into the given
+    /// buffer [f_first, f_last) without allocating.
+    /// Buffers of MaxStringLength characters are always large enough.
+    /// @returns pointer behind last written character or nullptr if the
+    ///          buffer was too small (buffer content is unspecified then).
+    char * toChars(char * f_first, char * f_last) const noexcept;
+
+    /// Appends the string representation (see toString()) to f_output.
+    /// Does not allocate if f_output has MaxStringLength spare capacity.
+    void appendTo(std::string & f_output) const;
 
     /// Convert the address into a string representation.
     /// @returns string representation in same format as the string constructor
     ///          also expects for parsing.
-    std::string toString();
+    std::string toString() const;
 
 
     /// Constructs an Address with all fields set to maximum value / all ones
     /// in binary.
     /// @returns the Address as described.
-    static Address createAllOneAddress();
+    static constexpr Address createAllOneAddress() noexcept
+    {
+        return fromKey(0x00ffffffffffffffULL);
+    }
 
     /// The device ID
     uint8_t id = 0;
@@ -93,10 +204,163 @@ struct Address
     // TODO: Support MAC
 
     private:
-        template<class T>
-        static bool maskMatch(T v1, T v2, T mask)
+        /// Parses a decimal number starting at f_position.
+        /// f_position points behind the last digit afterwards (also if the
+        /// value is out of range).
+        /// @param f_inRange set to false if the value exceeds f_max, f_value
+        ///          is then not valid.
+        /// @returns false if there is no digit.
+        static constexpr bool parseNumber(std::string_view f_string, size_t & f_position, uint32_t f_max, uint32_t & f_value, bool & f_inRange) noexcept
+        {
+            size_t start = f_position;
+            f_value = 0;
+            f_inRange = true;
+            while(f_position < f_string.size() and f_string[f_position] >= '0' and f_string[f_position] <= '9')
+            {
+                uint32_t digit = static_cast<uint32_t>(f_string[f_position] - '0');
+                // checked before multiplying, so the value can not wrap:
+                if(f_inRange and f_value > (f_max - digit) / 10)
+                {
+                    f_inRange = false;
+                }
+                if(f_inRange)
+                {
+                    f_value = f_value * 10 + digit;
+                }
+                f_position++;
+            }
+            return f_position != start;
+        }
+};
+
+struct AddressParseResult
+{
+    AddressParseError error = AddressParseError::None;
+    Address address;
+};
+
+// -----------------------------------------------------------------------------
+constexpr Address::ParseResult Address::parse(std::string_view f_addrString) noexcept
+{
+    ParseResult result;
+    result.address.port = 0;
+    size_t position = 0;
+
+    // first number is either first byte of busId or device id (both at
+    // most 0xff):
+    uint32_t value = 0;
+    bool inRange = true;
+    bool isNumber = parseNumber(f_addrString, position, 0xff, value, inRange);
+    if(not isNumber)
+    {
+        result.error = ParseError::Format;
+        return result;
+    }
+
+    if(position < f_addrString.size() and f_addrString[position] == '.')
+    {
+        // BusId/DeviceId...
+        bool busIdInRange = inRange;
+        result.address.busId[0] = static_cast<uint8_t>(value);
+        for(size_t i = 1; i < 4; i++)
+        {
+            if(position >= f_addrString.size() or f_addrString[position] != '.')
+            {
+                result.error = ParseError::Format;
+                return result;
+            }
+            position++;
+            if(not parseNumber(f_addrString, position, 0xff, value, inRange))
+            {
+                result.error = ParseError::Format;
+                return result;
+            }
+            busIdInRange = busIdInRange and inRange;
+            result.address.busId[i] = static_cast<uint8_t>(value);
+        }
+        if(position >= f_addrString.size() or f_addrString[position] != '/')
         {
-            return ((v1 bitand mask) == (v2 bitand mask));
+            result.error = ParseError::Format;
+            return result;
         }
+        position++;
+        if(not parseNumber(f_addrString, position, 0xff, value, inRange))
+        {
+            result.error = ParseError::Format;
+            return result;
+        }
+        if(not busIdInRange)
+        {
+            result.error = ParseError::BusIdRange;
+            return result;
+        }
+    }
+
+    if(not inRange)
+    {
+        result.error = ParseError::DeviceIdRange;
+        return result;
+    }
+    result.address.id = static_cast<uint8_t>(value);
+
+    if(position < f_addrString.size() and f_addrString[position] == ':')
+    {
+        position++;
+        if(not parseNumber(f_addrString, position, 0xffff, value, inRange))
+        {
+            result.error = ParseError::Format;
+            return result;
+        }
+        if(not inRange)
+        {
+            result.error = ParseError::PortRange;
+            return result;
+        }
+        result.address.port = static_cast<uint16_t>(value);
+    }
+
+    if(position != f_addrString.size())
+    {
+        result.error = ParseError::Format;
+    }
+    return result;
+}
+
+}
+
+namespace std
+{
+template<>
+struct hash<PjonHL::Address>
+{
+    size_t operator()(const PjonHL::Address & f_address) const noexcept
+    {
+        return hash<uint64_t>{}(f_address.toKey());
+    }
 };
 }
+
+namespace PjonHL
+{
+
+/// Writes the string representation of f_address (see Address::toString()).
+std::ostream & operator<<(std::ostream & f_stream, const Address & f_address);
+
+namespace literals
+{
+/// Address literal, e.g. "0.0.0.0/42:1337"_pjon
+/// If used in a constant expression (e.g. to initialize a constexpr
+/// variable), invalid addresses are rejected at compile time. Otherwise
+/// std::invalid_argument is thrown at runtime.
+constexpr Address operator""_pjon(const char * f_addrString, size_t f_length)
+{
+    Address::ParseResult result = Address::parse(std::string_view(f_addrString, f_length));
+    if(result.error != Address::ParseError::None)
+    {
+        throw std::invalid_argument("Invalid PJON address literal");
+    }
+    return result.address;
+}
+}
+
+}
@@ -0,0 +1,59 @@
+// Copyright 2021 Rainer Schoenberger
+// 
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+// 
+//     http://www.apache.org/licenses/LICENSE-2.0
+// 
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+// Formatter integration for PjonHL::Address with {fmt} and/or C++20
+// std::format. Only formatters for available libraries are defined, so this
+// header can be included unconditionally. PjonHL itself does not depend on
+// any of those libraries.
+//
+// Usage:
+//   fmt::format("{}", address);    // "1.2.3.4/42:1337"
+
+#include "Address.hpp"
+
+#if __has_include(<fmt/format.h>)
+#include <fmt/format.h>
+
+template<>
+struct fmt::formatter<PjonHL::Address> : fmt::formatter<fmt::string_view>
+{
+    template<typename FormatContext>
+    auto format(const PjonHL::Address & f_address, FormatContext & f_context) const
+    {
+        char buffer[PjonHL::Address::MaxStringLength];
+        char * end = f_address.toChars(buffer, buffer + sizeof(buffer));
+        return fmt::formatter<fmt::string_view>::format(fmt::string_view(buffer, end - buffer), f_context);
+    }
+};
+#endif
+
+#if __cplusplus >= 202002L and __has_include(<format>)
+#include <format>
+#ifdef __cpp_lib_format
+
+template<>
+struct std::formatter<PjonHL::Address> : std::formatter<std::string_view>
+{
+    template<typename FormatContext>
+    auto format(const PjonHL::Address & f_address, FormatContext & f_context) const
+    {
+        char buffer[PjonHL::Address::MaxStringLength];
+        char * end = f_address.toChars(buffer, buffer + sizeof(buffer));
+        return std::formatter<std::string_view>::format(std::string_view(buffer, end - buffer), f_context);
+    }
+};
+#endif
+#endif
@@ -0,0 +1,167 @@
+// Copyright 2021 Rainer Schoenberger
+// 
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+// 
+//     http://www.apache.org/licenses/LICENSE-2.0
+// 
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "AddressMatchTable.hpp"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+namespace PjonHL
+{
+
+// -----------------------------------------------------------------------------
+void AddressMatchTable::clear()
+{
+    m_remoteKeys.clear();
+    m_remoteMasks.clear();
+    m_localKeys.clear();
+    m_localMasks.clear();
+}
+
+// -----------------------------------------------------------------------------
+void AddressMatchTable::add(Address f_remote, Address f_remoteMask, Address f_local, Address f_localMask)
+{
+    addKeys(
+            f_remote.toKey() & f_remoteMask.toKey(),
+            f_remoteMask.toKey(),
+            f_local.toKey() & f_localMask.toKey(),
+            f_localMask.toKey()
+            );
+}
+
+// -----------------------------------------------------------------------------
+void AddressMatchTable::addKeys(uint64_t f_maskedRemoteKey, uint64_t f_remoteMaskKey, uint64_t f_maskedLocalKey, uint64_t f_localMaskKey)
+{
+    m_remoteKeys.push_back(f_maskedRemoteKey);
+    m_remoteMasks.push_back(f_remoteMaskKey);
+    m_localKeys.push_back(f_maskedLocalKey);
+    m_localMasks.push_back(f_localMaskKey);
+}
+
+// -----------------------------------------------------------------------------
+void AddressMatchTable::matchScalar(Address f_remote, Address f_target, std::vector<uint32_t> & f_matches) const
+{
+    f_matches.clear();
+    matchScalarRange(f_remote.toKey(), f_target.toKey(), 0, f_matches);
+}
+
+// -----------------------------------------------------------------------------
+void AddressMatchTable::matchScalarRange(uint64_t f_remoteKey, uint64_t f_targetKey, size_t f_begin, std::vector<uint32_t> & f_matches) const
+{
+    for(size_t i = f_begin; i < m_remoteKeys.size(); i++)
+    {
+        bool match =
+            ((f_remoteKey & m_remoteMasks[i]) == m_remoteKeys[i]) and
+            ((f_targetKey & m_localMasks[i]) == m_localKeys[i]);
+        if(match)
+        {
+            f_matches.push_back(static_cast<uint32_t>(i));
+        }
+    }
+}
+
+// -----------------------------------------------------------------------------
+void AddressMatchTable::match(Address f_remote, Address f_target, std::vector<uint32_t> & f_matches) const
+{
+    f_matches.clear();
+    const uint64_t remoteKey = f_remote.toKey();
+    const uint64_t targetKey = f_target.toKey();
+    const size_t count = m_remoteKeys.size();
+    size_t i = 0;
+
+#if defined(__AVX2__)
+    const __m256i remote = _mm256_set1_epi64x(static_cast<long long>(remoteKey));
+    const __m256i target = _mm256_set1_epi64x(static_cast<long long>(targetKey));
+    for(; i + 4 <= count; i += 4)
+    {
+        __m256i remoteMatch = _mm256_cmpeq_epi64(
+                _mm256_and_si256(remote, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(&m_remoteMasks[i]))),
+                _mm256_loadu_si256(reinterpret_cast<const __m256i*>(&m_remoteKeys[i])));
+        __m256i localMatch = _mm256_cmpeq_epi64(
+                _mm256_and_si256(target, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(&m_localMasks[i]))),
+                _mm256_loadu_si256(reinterpret_cast<const __m256i*>(&m_localKeys[i])));
+        int bits = _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_and_si256(remoteMatch, localMatch)));
+        while(bits != 0)
+        {
+            f_matches.push_back(static_cast<uint32_t>(i + __builtin_ctz(bits)));
+            bits &= bits - 1;
+        }
+    }
+#elif defined(__SSE2__)
+    const __m128i remote = _mm_set1_epi64x(static_cast<long long>(remoteKey));
+    const __m128i target = _mm_set1_epi64x(static_cast<long long>(targetKey));
+    for(; i + 2 <= count; i += 2)
+    {
+        // SSE2 has no 64 bit compare: compare 32 bit halves and combine them
+        __m128i remoteMatch = _mm_cmpeq_epi32(
+                _mm_and_si128(remote, _mm_loadu_si128(reinterpret_cast<const __m128i*>(&m_remoteMasks[i]))),
+                _mm_loadu_si128(reinterpret_cast<const __m128i*>(&m_remoteKeys[i])));
+        __m128i localMatch = _mm_cmpeq_epi32(
+                _mm_and_si128(target, _mm_loadu_si128(reinterpret_cast<const __m128i*>(&m_localMasks[i]))),
+                _mm_loadu_si128(reinterpret_cast<const __m128i*>(&m_localKeys[i])));
+        __m128i both = _mm_and_si128(remoteMatch, localMatch);
+        both = _mm_and_si128(both, _mm_shuffle_epi32(both, _MM_SHUFFLE(2, 3, 0, 1)));
+        int bits = _mm_movemask_pd(_mm_castsi128_pd(both));
+        if(bits & 1)
+        {
+            f_matches.push_back(static_cast<uint32_t>(i));
+        }
+        if(bits & 2)
+        {
+            f_matches.push_back(static_cast<uint32_t>(i + 1));
+        }
+    }
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+    const uint64x2_t remote = vdupq_n_u64(remoteKey);
+    const uint64x2_t target = vdupq_n_u64(targetKey);
+    for(; i + 2 <= count; i += 2)
+    {
+        uint64x2_t remoteMatch = vceqq_u64(vandq_u64(remote, vld1q_u64(&m_remoteMasks[i])), vld1q_u64(&m_remoteKeys[i]));
+        uint64x2_t localMatch = vceqq_u64(vandq_u64(target, vld1q_u64(&m_localMasks[i])), vld1q_u64(&m_localKeys[i]));
+        uint64x2_t both = vandq_u64(remoteMatch, localMatch);
+        if(vgetq_lane_u64(both, 0))
+        {
+            f_matches.push_back(static_cast<uint32_t>(i));
+        }
+        if(vgetq_lane_u64(both, 1))
+        {
+            f_matches.push_back(static_cast<uint32_t>(i + 1));
+        }
+    }
+#endif
+
+    // remaining entries (or all, if no SIMD is available):
+    matchScalarRange(remoteKey, targetKey, i, f_matches);
+}
+
+// -----------------------------------------------------------------------------
+const char * AddressMatchTable::implementationName()
+{
+#if defined(__AVX2__)
+    return "avx2";
+#elif defined(__SSE2__)
+    return "sse2";
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+    return "neon";
+#else
+    return "scalar";
+#endif
+}
+
+}
@@ -0,0 +1,69 @@
+// Copyright 2021 Rainer Schoenberger
+// 
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+// 
+//     http://www.apache.org/licenses/LICENSE-2.0
+// 
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <inttypes.h>
+#include <vector>
+
+#include "Address.hpp"
+
+namespace PjonHL
+{
+
+/// Table of (remote, remoteMask, local, localMask) address filters, which can
+/// be matched against an incoming (remote, target) address pair in one batch.
+/// Filters are stored as packed, pre-masked keys (see Address::toKey()) in
+/// separate arrays, so matching uses SIMD instructions where available
+/// (AVX2, SSE2 or AArch64 NEON) and falls back to scalar code otherwise.
+class AddressMatchTable
+{
+    public:
+        void clear();
+
+        void add(Address f_remote, Address f_remoteMask, Address f_local, Address f_localMask);
+
+        /// Same as add(), but takes keys (see Address::toKey()).
+        /// f_maskedRemoteKey and f_maskedLocalKey have to be masked already.
+        void addKeys(uint64_t f_maskedRemoteKey, uint64_t f_remoteMaskKey, uint64_t f_maskedLocalKey, uint64_t f_localMaskKey);
+
+        inline size_t size() const
+        {
+            return m_remoteKeys.size();
+        }
+
+        /// Finds all filters matching the given addresses.
+        /// @param f_remote address of the sender of a packet
+        /// @param f_target address the packet was sent to
+        /// @param f_matches receives indices (in order of add()) of all
+        ///         matching filters. Cleared before. Does not allocate if
+        ///         capacity is sufficient.
+        void match(Address f_remote, Address f_target, std::vector<uint32_t> & f_matches) const;
+
+        /// Same as match(), but never uses SIMD. Reference implementation.
+        void matchScalar(Address f_remote, Address f_target, std::vector<uint32_t> & f_matches) const;
+
+        /// @returns name of the instruction set used by match().
+        static const char * implementationName();
+
+    private:
+        void matchScalarRange(uint64_t f_remoteKey, uint64_t f_targetKey, size_t f_begin, std::vector<uint32_t> & f_matches) const;
+
+        std::vector<uint64_t> m_remoteKeys;
+        std::vector<uint64_t> m_remoteMasks;
+        std::vector<uint64_t> m_localKeys;
+        std::vector<uint64_t> m_localMasks;
+};
+
+}
@@ -0,0 +1,160 @@
+// Copyright 2021 Rainer Schoenberger
+// 
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+// 
+//     http://www.apache.org/licenses/LICENSE-2.0
+// 
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "AsyncLogger.hpp"
+
+#include <algorithm>
+#include <iterator>
+
+namespace PjonHL
+{
+
+// -----------------------------------------------------------------------------
+AsyncLogger::AsyncLogger(std::ostream & f_output, size_t f_capacity, std::chrono::milliseconds f_flushInterval) :
+    m_output(f_output),
+    m_records(f_capacity),
+    m_flushInterval(f_flushInterval)
+{
+    m_drainedRecords.reserve(m_records.capacity());
+    m_thread = std::thread([this]{backgroundLoop();});
+}
+
+// -----------------------------------------------------------------------------
+AsyncLogger::~AsyncLogger()
+{
+    {
+        std::lock_guard<std::mutex> guard(m_wakeupMutex);
+        m_running = false;
+    }
+    m_wakeup.notify_all();
+    m_thread.join();
+    drain();
+}
+
+// -----------------------------------------------------------------------------
+void AsyncLogger::log(LogLevel f_level, std::string f_message)
+{
+    if(not isEnabled(f_level))
+    {
+        return;
+    }
+    std::lock_guard<std::mutex> guard(m_messagesMutex);
+    m_messages.push_back(SequencedMessage{m_sequence.fetch_add(1, std::memory_order_release), std::move(f_message)});
+}
+
+// -----------------------------------------------------------------------------
+void AsyncLogger::logRecord(const LogRecord & f_record)
+{
+    if(not isEnabled(f_record.level))
+    {
+        return;
+    }
+    if(not m_records.push(SequencedRecord{m_sequence.fetch_add(1, std::memory_order_release), f_record}))
+    {
+        m_dropped.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+// -----------------------------------------------------------------------------
+void AsyncLogger::flush()
+{
+    drain();
+}
+
+// -----------------------------------------------------------------------------
+void AsyncLogger::backgroundLoop()
+{
+    std::unique_lock<std::mutex> lock(m_wakeupMutex);
+    while(m_running)
+    {
+        m_wakeup.wait_for(lock, m_flushInterval, [this]{return not m_running;});
+        lock.unlock();
+        drain();
+        lock.lock();
+    }
+}
+
+// -----------------------------------------------------------------------------
+void AsyncLogger::drain()
+{
+    std::lock_guard<std::mutex> drainGuard(m_drainMutex);
+
+    // entries numbered before are queued (unless their thread is preempted
+    // right between numbering and queueing, they are then written late).
+    // Later entries are kept for the next drain, as entries numbered before
+    // them may still be missing:
+    uint64_t end = m_sequence.load(std::memory_order_acquire);
+
+    SequencedRecord record;
+    while(m_drainedRecords.size() < m_drainedRecords.capacity() and m_records.pop(record))
+    {
+        m_drainedRecords.push_back(record);
+    }
+    {
+        std::lock_guard<std::mutex> guard(m_messagesMutex);
+        std::move(m_messages.begin(), m_messages.end(), std::back_inserter(m_drainedMessages));
+        m_messages.clear();
+    }
+
+    // concurrent producers may complete their push out of order, messages
+    // are numbered under the lock and already are in order:
+    std::sort(
+            m_drainedRecords.begin(),
+            m_drainedRecords.end(),
+            [](const SequencedRecord & f_a, const SequencedRecord & f_b){ return f_a.sequence < f_b.sequence; }
+            );
+
+    bool written = false;
+    auto nextRecord = m_drainedRecords.begin();
+    auto nextMessage = m_drainedMessages.begin();
+    while(true)
+    {
+        bool recordDue = nextRecord != m_drainedRecords.end() and nextRecord->sequence < end;
+        bool messageDue = nextMessage != m_drainedMessages.end() and nextMessage->sequence < end;
+        if(recordDue and (not messageDue or nextRecord->sequence < nextMessage->sequence))
+        {
+            m_formatBuffer.clear();
+            nextRecord->record.format(m_formatBuffer);
+            m_output << "PjonHl: " << m_formatBuffer << '\n';
+            nextRecord++;
+        }
+        else if(messageDue)
+        {
+            m_output << "PjonHl: " << nextMessage->message << '\n';
+            nextMessage++;
+        }
+        else
+        {
+            break;
+        }
+        written = true;
+    }
+    m_drainedRecords.erase(m_drainedRecords.begin(), nextRecord);
+    m_drainedMessages.erase(m_drainedMessages.begin(), nextMessage);
+
+    uint64_t dropped = getDroppedCount();
+    if(dropped != m_droppedReported)
+    {
+        m_output << "PjonHl: " << (dropped - m_droppedReported) << " log records dropped (buffer full)" << '\n';
+        m_droppedReported = dropped;
+        written = true;
+    }
+
+    if(written)
+    {
+        m_output.flush();
+    }
+}
+
+}
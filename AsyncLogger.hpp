@@ -0,0 +1,111 @@
+// Copyright 2021 Rainer Schoenberger
+// 
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+// 
+//     http://www.apache.org/licenses/LICENSE-2.0
+// 
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Logger.hpp"
+#include "LockFreeQueue.hpp"
+
+namespace PjonHL
+{
+
+/// Logger which moves all formatting and I/O out of the calling thread.
+/// - Records (logRecord()) are copied into a preallocated lock free ring.
+///   This never allocates or blocks. If the ring is full, the record is
+///   dropped and counted (see getDroppedCount()).
+/// - Text messages (log()) are queued under a mutex (they are already
+///   allocated by the caller anyway).
+/// A background thread periodically formats queued messages and writes
+/// them to the given stream. Both are numbered when logged and written in
+/// that order.
+class AsyncLogger : public Logger
+{
+    public:
+        /// @param f_output stream to write to. Needs to outlive the logger.
+        /// @param f_capacity number of records which can be buffered.
+        /// @param f_flushInterval interval in which the background thread
+        ///         writes buffered messages.
+        AsyncLogger(
+                std::ostream & f_output,
+                size_t f_capacity = 4096,
+                std::chrono::milliseconds f_flushInterval = std::chrono::milliseconds(20)
+                );
+
+        /// Writes all remaining messages and stops the background thread.
+        ~AsyncLogger();
+
+        virtual void log(LogLevel f_level, std::string f_message) override;
+
+        virtual void logRecord(const LogRecord & f_record) override;
+
+        /// Blocks until all messages logged before this call are written.
+        void flush();
+
+        /// @returns number of records dropped because the ring was full.
+        inline uint64_t getDroppedCount() const
+        {
+            return m_dropped.load(std::memory_order_relaxed);
+        }
+
+    private:
+        struct SequencedRecord
+        {
+            uint64_t sequence;
+            LogRecord record;
+        };
+
+        struct SequencedMessage
+        {
+            uint64_t sequence;
+            std::string message;
+        };
+
+        void backgroundLoop();
+        void drain();
+
+        std::ostream & m_output;
+        // numbers records and text messages in the order they are logged:
+        std::atomic<uint64_t> m_sequence{0};
+        BoundedMpmcQueue<SequencedRecord> m_records;
+        std::atomic<uint64_t> m_dropped{0};
+        uint64_t m_droppedReported = 0;
+
+        std::mutex m_messagesMutex;
+        std::vector<SequencedMessage> m_messages;
+
+        // serializes drain() between background thread and flush():
+        std::mutex m_drainMutex;
+        std::string m_formatBuffer;
+        // only used by drain(), taken from the queues but not yet written
+        // (records preallocated to the capacity of m_records):
+        std::vector<SequencedRecord> m_drainedRecords;
+        std::vector<SequencedMessage> m_drainedMessages;
+
+        std::chrono::milliseconds m_flushInterval;
+        std::mutex m_wakeupMutex;
+        std::condition_variable m_wakeup;
+        bool m_running = true;
+        std::thread m_thread;
+};
+
+}
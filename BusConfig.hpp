@@ -1,3 +1,10 @@
+#pragma once
+
+#include <cstddef>
+#include <inttypes.h>
+#include <string>
+#include <vector>
+
 namespace PjonHL
 {
 
@@ -6,6 +13,8 @@ namespace PjonHL
 /// You can optionally pass an instance of the BusConfig into the PjonHL constructor.
 /// All config options will be forwarded to the PJON backend.
 /// For detailed documentation please have a look at the PJON protocol spec.
+/// Exception: Options grouped in sub-structs (e.g. retransmit) are handled by
+/// PjonHL itself and are local to this participant.
 struct BusConfig
 {
     enum class BusTopology
@@ -32,11 +41,114 @@ struct BusConfig
         Crc32
     };
 
+    /// Configuration of PjonHL level retransmissions (see
+    /// Connection::send() f_enableRetransmit).
+    /// PjonHL measures the time from dispatching a packet to PJON until PJON
+    /// reports completion for every remote and derives a retransmit timeout
+    /// (RTO) from it (smoothed RTT + 4 * RTT variance, as in RFC 6298).
+    /// Failed packets are re-dispatched after an exponential backoff based on
+    /// this RTO, until either the attempts are exhausted or the timeout given
+    /// in send() would be exceeded.
+    struct RetransmitConfig
+    {
+        /// Maximum number of attempts (including the first one) for a
+        /// remote which did not fail recently.
+        /// Each recent failure of a remote reduces this number by one, down
+        /// to a single attempt.
+        uint8_t maxAttempts = 4;
+
+        /// RTO used for remotes without any RTT measurement yet.
+        uint32_t initialRtoMilliseconds = 100;
+
+        /// Lower bound of the RTO.
+        uint32_t minRtoMilliseconds = 5;
+
+        /// Upper bound of the RTO and of a single backoff period.
+        uint32_t maxRtoMilliseconds = 5000;
+
+        /// Time after the last failure, after which a remote is no longer
+        /// considered as recently failed.
+        uint32_t failureMemoryMilliseconds = 10000;
+    };
+
+    /// Limits of the TX queue of the Bus, which holds all packets passed to
+    /// send() until PJON completed them. Without limits, producers faster
+    /// than the bus make the queue (and the latency of every packet) grow
+    /// without bound.
+    /// Packets sent without a connection (Bus::send(), MulticastGroup) only
+    /// count against maxPackets.
+    struct TxQueueConfig
+    {
+        enum class OverflowPolicy
+        {
+            /// send() fails immediately with a Result for which
+            /// isTxQueueFull() is true.
+            Reject,
+            /// send() waits up to blockTimeoutMilliseconds for space, then
+            /// fails as with Reject. Sends from the event-loop thread (e.g.
+            /// from completion handlers) never wait.
+            Block
+        };
+
+        /// Maximum number of packets queued in the Bus, 0 means unlimited.
+        size_t maxPackets = 0;
+
+        /// Maximum number of packets queued per connection, 0 means
+        /// unlimited.
+        size_t maxPacketsPerConnection = 0;
+
+        OverflowPolicy overflowPolicy = OverflowPolicy::Reject;
+
+        uint32_t blockTimeoutMilliseconds = 1000;
+    };
+
+    /// Scheduling and memory options of the event-loop thread, which
+    /// handles all PJON traffic (see ThreadSetup.hpp).
+    /// Failures (e.g. missing privileges) are reported through the Logger of
+    /// the Bus, the thread then continues with the settings it has.
+    struct ThreadConfig
+    {
+        enum class SchedulingPolicy
+        {
+            /// Do not change scheduling (SCHED_OTHER).
+            Default,
+            /// Real-time SCHED_FIFO.
+            Fifo,
+            /// Real-time SCHED_RR.
+            RoundRobin
+        };
+
+        SchedulingPolicy schedulingPolicy = SchedulingPolicy::Default;
+
+        /// Real-time priority (1..99 on Linux), only used with Fifo and
+        /// RoundRobin.
+        int priority = 50;
+
+        /// CPUs the thread may run on. Empty means no restriction.
+        std::vector<int> cpuAffinity;
+
+        /// Lock all current and future pages of the process into memory
+        /// (mlockall), so the event-loop never waits for page faults.
+        bool lockMemory = false;
+
+        /// Bytes of stack touched when the thread starts, so its working set
+        /// is faulted in (and locked if lockMemory is set) upfront.
+        size_t prefaultStackBytes = 0;
+
+        /// Thread name shown e.g. in top/htop (truncated to 15 characters on
+        /// Linux). Empty keeps the inherited name.
+        std::string name = "PjonHL";
+    };
+
     BusTopology       busTopology       = BusTopology::Local;
     CommunicationMode communicationMode = CommunicationMode::HalfDuplex;
     AckType           ackType           = AckType::AckEnabled;
     CrcType           crcType           = CrcType::Crc8;
 
+    RetransmitConfig  retransmit;
+    TxQueueConfig     txQueue;
+    ThreadConfig      eventLoopThread;
+
     // Mac not yet suppored
 };
 
@@ -0,0 +1,148 @@
+// Copyright 2021 Rainer Schoenberger
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace PjonHL
+{
+
+template<class Strategy>
+class Bus;
+
+/// Withdraws queued packets, see Connection::send().
+/// Copies share their state, so the caller keeps a copy and may pass the
+/// token to any number of send() calls. cancel() then withdraws all of them
+/// which were not yet handed to PJON (including ones waiting for a
+/// retransmission): they are removed from the TX queue and complete right
+/// away.
+class CancelToken
+{
+    public:
+        /// Notified by cancel(), implemented by Bus to withdraw its queued
+        /// packets of the token.
+        class Listener
+        {
+            public:
+                /// @param f_tokenId identifies the cancelled token (see
+                ///          getId()).
+                virtual void onCancel(const void * f_tokenId) = 0;
+
+            protected:
+                ~Listener() = default;
+        };
+
+        /// Token which can not be cancelled (does not allocate).
+        CancelToken() = default;
+
+        /// Creates a token which can be cancelled.
+        static inline CancelToken create()
+        {
+            CancelToken token;
+            token.m_state = std::make_shared<State>();
+            return token;
+        }
+
+        /// Thread safe. Completes the withdrawn packets from the calling
+        /// thread, i.e. their completion handlers are called from it.
+        inline void cancel()
+        {
+            if(not m_state)
+            {
+                return;
+            }
+            std::vector<std::weak_ptr<Listener>> listeners;
+            {
+                std::lock_guard<std::mutex> guard(m_state->mutex);
+                if(m_state->cancelled)
+                {
+                    return;
+                }
+                m_state->cancelled = true;
+                listeners.swap(m_state->listeners);
+            }
+            // not locked, so listeners may add other tokens:
+            for(auto & weakListener : listeners)
+            {
+                if(auto listener = weakListener.lock())
+                {
+                    listener->onCancel(getId());
+                }
+            }
+        }
+
+        inline bool isCancelled() const
+        {
+            return m_state and m_state->cancelled;
+        }
+
+    private:
+        struct State
+        {
+            std::mutex mutex;
+            // only set with mutex locked:
+            std::atomic<bool> cancelled{false};
+            // guarded by mutex:
+            std::vector<std::weak_ptr<Listener>> listeners;
+        };
+
+        /// Identifies the shared state of the token, nullptr if it can not
+        /// be cancelled.
+        inline const void * getId() const
+        {
+            return m_state.get();
+        }
+
+        /// Makes cancel() notify f_listener. If the token is already
+        /// cancelled, f_listener is notified right away instead.
+        inline void addListener(const std::shared_ptr<Listener> & f_listener) const
+        {
+            if(not m_state)
+            {
+                return;
+            }
+            {
+                std::lock_guard<std::mutex> guard(m_state->mutex);
+                if(not m_state->cancelled)
+                {
+                    auto & listeners = m_state->listeners;
+                    listeners.erase(
+                            std::remove_if(listeners.begin(), listeners.end(), [](const std::weak_ptr<Listener> & f_listener){ return f_listener.expired(); }),
+                            listeners.end()
+                            );
+                    bool known = std::any_of(listeners.begin(), listeners.end(), [&](const std::weak_ptr<Listener> & f_known){ return f_known.lock() == f_listener; });
+                    if(not known)
+                    {
+                        listeners.push_back(f_listener);
+                    }
+                    return;
+                }
+            }
+            f_listener->onCancel(getId());
+        }
+
+        std::shared_ptr<State> m_state;
+
+        template<class Strategy>
+        friend class Bus;
+        template<class Strategy>
+        friend class Connection;
+};
+
+}
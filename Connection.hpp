@@ -13,18 +13,35 @@
 // limitations under the License.
 
 #pragma once
+#include <algorithm>
+#include <chrono>
+#include <functional>
 #include <future>
+#include <memory>
+#include <optional>
+#include <unordered_map>
 #include <vector>
+#include "CancelToken.hpp"
+#include "ConstBuffer.hpp"
+#include "MutableBuffer.hpp"
+#include "TypedMessage.hpp"
 #include "Expect.hpp"
 #include "Address.hpp"
+#include "LatencyHistogram.hpp"
+#include "Metrics.hpp"
 #include "PjonHlBus.hpp"
 
 namespace PjonHL
 {
 
+template<class Strategy>
+class Bus;
+
 class Result
 {
     public:
+        using TimePoint = std::chrono::steady_clock::time_point;
+
         inline
         Result() :
             m_success{true}
@@ -44,29 +61,136 @@ class Result
         {
         }
 
-        inline bool isGood()
+        // without this, string literals would select Result(bool):
+        explicit inline
+        Result(const char * f_errorMessage) :
+            Result(std::string(f_errorMessage))
+        {
+        }
+
+        inline bool isGood() const
         {
             return m_success;
         }
-        inline bool isBad()
+        inline bool isBad() const
         {
             return not m_success;
         }
-        inline std::string getErrorMessage()
+        inline std::string getErrorMessage() const
         {
             return m_errorMessage;
         }
+
+        /// @returns true if the packet was not queued, as the TX queue was
+        ///          full (see BusConfig::TxQueueConfig).
+        inline bool isTxQueueFull() const
+        {
+            return m_txQueueFull;
+        }
+
+        static inline Result createTxQueueFullResult()
+        {
+            Result result("TX queue full");
+            result.m_txQueueFull = true;
+            return result;
+        }
+
+        /// @returns true if the packet was withdrawn through its CancelToken
+        ///          and not sent.
+        inline bool isCancelled() const
+        {
+            return m_cancelled;
+        }
+
+        static inline Result createCancelledResult()
+        {
+            Result result("Cancelled");
+            result.m_cancelled = true;
+            return result;
+        }
+
+        /// @returns true if the packet was not sent, as a newer packet of its
+        ///          stream replaced it (see Connection::sendLatest()).
+        inline bool isSuperseded() const
+        {
+            return m_superseded;
+        }
+
+        static inline Result createSupersededResult()
+        {
+            Result result("Superseded");
+            result.m_superseded = true;
+            return result;
+        }
+
+        // Timestamps of the transmission (steady_clock). Default constructed
+        // (epoch) if the packet never got that far, e.g. getDispatchTime()
+        // if it failed before being handed to PJON.
+
+        /// Time send() queued the packet.
+        inline TimePoint getEnqueueTime() const
+        {
+            return m_enqueueTime;
+        }
+
+        /// Time the packet was handed to PJON the first time.
+        /// getDispatchTime() - getEnqueueTime() is the time spent in the TX
+        /// queue of the Bus.
+        inline TimePoint getDispatchTime() const
+        {
+            return m_dispatchTime;
+        }
+
+        /// Time the packet was handed to PJON the last time (differs from
+        /// getDispatchTime() if it was retransmitted).
+        inline TimePoint getLastDispatchTime() const
+        {
+            return m_lastDispatchTime;
+        }
+
+        /// Time PJON reported success (e.g. ACK received) or failure.
+        /// getCompletionTime() - getLastDispatchTime() is the time spent on
+        /// the wire.
+        inline TimePoint getCompletionTime() const
+        {
+            return m_completionTime;
+        }
+
     private:
         bool m_success;
         std::string m_errorMessage;
+        bool m_txQueueFull = false;
+        bool m_cancelled = false;
+        bool m_superseded = false;
+
+        TimePoint m_enqueueTime;
+        TimePoint m_dispatchTime;
+        TimePoint m_lastDispatchTime;
+        TimePoint m_completionTime;
+
+        template<class Strategy>
+        friend class Bus;
 };
 
+/// Called with the result of a transmission, instead of fulfilling a future.
+/// Called from the event-loop thread, so it should return quickly. Must not
+/// destroy the Bus.
+using SendCompletionHandler = std::function<void(Result)>;
+
 struct ReceivedPacket 
 {
-    inline ReceivedPacket(std::vector<uint8_t> && f_payload, Address f_remoteAddress, Address f_targetAddress) :
+    inline ReceivedPacket(
+            std::vector<uint8_t> && f_payload,
+            Address f_remoteAddress,
+            Address f_targetAddress,
+            std::chrono::steady_clock::time_point f_rxTime = std::chrono::steady_clock::time_point(),
+            std::chrono::steady_clock::time_point f_frameStartTime = std::chrono::steady_clock::time_point()
+            ) :
         remoteAddress(f_remoteAddress),
         targetAddress(f_targetAddress),
-        payload(f_payload)
+        payload(std::move(f_payload)),
+        rxTime(f_rxTime),
+        frameStartTime(f_frameStartTime)
     {}
 
     ReceivedPacket() = default;
@@ -74,11 +198,56 @@ struct ReceivedPacket
     Address remoteAddress;
     Address targetAddress;
     std::vector<uint8_t> payload;
+
+    /// Time (steady_clock) the packet was handed to PjonHL by PJON.
+    /// now - rxTime after receive() is the time the packet was queued.
+    std::chrono::steady_clock::time_point rxTime;
+
+    /// Time the first byte of the frame was received, if the strategy
+    /// reports it (see Bus), otherwise equal to rxTime.
+    std::chrono::steady_clock::time_point frameStartTime;
 };
 
+/// Metadata of a packet received with Connection::receiveInto(), see
+/// ReceivedPacket for the meaning of the fields.
+struct ReceivedPacketInfo
+{
+    /// Bytes written to the caller's buffer.
+    size_t size = 0;
+
+    /// Size of the received payload. Larger than size if the caller's buffer
+    /// was too small, the remaining bytes are lost.
+    size_t payloadSize = 0;
+
+    Address remoteAddress;
+    Address targetAddress;
+    std::chrono::steady_clock::time_point rxTime;
+    std::chrono::steady_clock::time_point frameStartTime;
+
+    inline bool isTruncated() const
+    {
+        return size < payloadSize;
+    }
+};
+
+/// Key of a received packet for RX conflation, see
+/// Connection::setRxConflation().
+using RxConflationKeyFunction = std::function<uint64_t(const ReceivedPacket &)>;
+
+/// Packet received with Connection::receive<Message>(), the payload is
+/// validated to be a Message.
+template<class Message>
+struct ReceivedMessage
+{
+    ReceivedPacket packet;
+
+    /// View of packet.payload, valid as long as packet.payload is.
+    inline MessageView<Message> view() const
+    {
+        return MessageView<Message>::validate(packet.payload).unwrap();
+    }
+};
 
-template<class Strategy>
-class Bus;
 
 template<class Strategy>
 class Connection
@@ -89,18 +258,111 @@ class Connection
         /// @param f_payload data moved in to be transmitted
         /// @param f_timeout_milliseconds time until which retransmissions are
         ///          attempted before transmission is aborted with an error.
-        /// @param f_enableRetransmit not yet implemented, has no effect
-        ///        TODO: remove or implement
+        /// @param f_enableRetransmit if true, PjonHL retransmits the packet if
+        ///          PJON reports a failure. Time between attempts and number of
+        ///          attempts adapt to the measured round trip times and
+        ///          recent failures of the remote (see
+        ///          BusConfig::RetransmitConfig).
+        /// @param f_cancelToken allows withdrawing the packet as long as it was
+        ///          not handed to PJON. Cancelled packets are not sent, give
+        ///          back their place in the TX queue and complete with a
+        ///          Result for which isCancelled() is true from within
+        ///          CancelToken::cancel() (from within send() if the token
+        ///          already is cancelled). A packet cancelled while on the
+        ///          wire is only dropped if it is to be retransmitted.
         /// @returns A future which may be used to check if packet was sent
         ///          successfully or not. A call to .get() will block until the
         ///          result is known for sure (I.e. packet could be sent or
         ///          failed to send).
         std::future<Result> send(
-                const std::vector<uint8_t> && f_payload,
+                std::vector<uint8_t> && f_payload,
                 uint32_t f_timeout_milliseconds = 1000,
-                bool f_enableRetransmit=true
+                bool f_enableRetransmit=true,
+                CancelToken f_cancelToken = CancelToken()
                 );
 
+        /// Same as above, but copies f_payload (once) as the caller keeps
+        /// ownership of it. Use this for data not held in a std::vector.
+        std::future<Result> send(
+                ConstBuffer f_payload,
+                uint32_t f_timeout_milliseconds = 1000,
+                bool f_enableRetransmit=true,
+                CancelToken f_cancelToken = CancelToken()
+                );
+
+        /// Zero-copy send of a caller-owned buffer.
+        /// f_payload is not copied, the caller has to keep it alive and
+        /// unmodified until f_onComplete was called.
+        /// @param f_onComplete called exactly once with the result. Called
+        ///          from the event-loop thread, or immediately from the
+        ///          calling thread if the connection is not active or the
+        ///          TX queue is full.
+        void send(
+                ConstBuffer f_payload,
+                SendCompletionHandler f_onComplete,
+                uint32_t f_timeout_milliseconds = 1000,
+                bool f_enableRetransmit=true,
+                CancelToken f_cancelToken = CancelToken()
+                );
+
+        /// Sends the concatenation of f_segments as one packet, e.g. a
+        /// header and a body, without concatenating them first.
+        /// The segments are copied (once) into the request.
+        std::future<Result> send(
+                const ConstBufferList & f_segments,
+                uint32_t f_timeout_milliseconds = 1000,
+                bool f_enableRetransmit=true,
+                CancelToken f_cancelToken = CancelToken()
+                );
+
+        /// Zero-copy variant of the above, the segments are gathered directly
+        /// into the buffer handed to PJON when the packet is dispatched.
+        /// As for send(ConstBuffer, SendCompletionHandler), the caller has to
+        /// keep all segments alive and unmodified until f_onComplete was
+        /// called.
+        void send(
+                const ConstBufferList & f_segments,
+                SendCompletionHandler f_onComplete,
+                uint32_t f_timeout_milliseconds = 1000,
+                bool f_enableRetransmit=true,
+                CancelToken f_cancelToken = CancelToken()
+                );
+
+        /// Conflating send ("latest value wins") for telemetry and set-point
+        /// streams, where only the newest value matters.
+        /// If a packet of the same stream (remote address, port and
+        /// f_streamId) sent with sendLatest() is still queued and not yet
+        /// handed to PJON, it is replaced in place by this one: f_payload
+        /// keeps the queue position of the replaced packet, whose future
+        /// completes with a Result for which isSuperseded() is true.
+        /// So each stream occupies at most one entry of the TX queue.
+        /// Otherwise the same as send().
+        /// @param f_streamId distinguishes several conflated streams to the
+        ///          same remote address and port.
+        std::future<Result> sendLatest(
+                std::vector<uint8_t> && f_payload,
+                uint32_t f_timeout_milliseconds = 1000,
+                bool f_enableRetransmit=true,
+                uint8_t f_streamId = 0
+                );
+
+        /// Calls f_callback once there is space in the TX queue for a packet
+        /// of this connection (see BusConfig::TxQueueConfig), immediately
+        /// from the calling thread if there already is. Allows producers to
+        /// wait for space without blocking a thread.
+        /// The space is not reserved, other senders may take it first.
+        /// f_callback is called from the event-loop thread and should return
+        /// quickly. Destroying the connection or Bus discards it.
+        void onTxCredit(std::function<void()> f_callback);
+
+        /// Sends a typed message (see TypedMessage.hpp), the fields are
+        /// serialized directly into the payload handed to PJON.
+        /// Uses the default timeout and retransmission, otherwise use
+        /// send(Message::encode(...), ...).
+        /// @param f_values one value per field of Message.
+        template<class Message, class... Values>
+        std::future<Result> send(Values && ... f_values);
+
         /// Receives a packet from the remote side of the connection.
         /// Thread safe with respect to other public member functions.
         /// @param f_timeout_milliseconds Time to block and wait for data to
@@ -111,19 +373,102 @@ class Connection
         ///       This is a known limitation and will be addressed in the future.
         Expect< ReceivedPacket > receive(uint32_t f_timeout_milliseconds = 0);
 
+        /// Same as receive(), but copies the payload into f_buffer instead of
+        /// handing out its storage, which is then reused for later packets.
+        /// Allows receiving without allocations, e.g. when reusing one
+        /// buffer per thread.
+        /// @return Expected size and metadata of the packet. Valid if a packet
+        ///         was received, also if it was truncated to fit f_buffer.
+        Expect< ReceivedPacketInfo > receiveInto(MutableBuffer f_buffer, uint32_t f_timeout_milliseconds = 0);
+
+        /// Same as receive(), but expects the packet to be a Message (see
+        /// TypedMessage.hpp).
+        /// @return Expected message. Invalid if no packet was received or if
+        ///         the received packet is not a Message, it is dropped then.
+        ///         Use a MessageDispatcher if different messages are expected.
+        template<class Message>
+        Expect< ReceivedMessage<Message> > receive(uint32_t f_timeout_milliseconds = 0);
+
+        /// Conflating receive ("latest value wins"), e.g. for periodic sensor
+        /// frames read by a slow consumer.
+        /// If enabled, at most one packet per key is queued: a received
+        /// packet with the key of a queued one overwrites it in place (the
+        /// queue position is kept). Overwritten packets are counted in
+        /// ConnectionMetrics::rxPacketsConflated.
+        /// Applies to packets received after the call.
+        /// Thread safe with respect to other public member functions.
+        /// @param f_key optional key of a packet, called from the
+        ///          event-loop thread for every received packet (including
+        ///          empty ones) with the RX queue locked. Must not use the
+        ///          connection and must not throw (an exception terminates
+        ///          the process). Default: remoteAddress (including port),
+        ///          i.e. the newest packet per source.
+        void setRxConflation(bool f_enable, RxConflationKeyFunction f_key = RxConflationKeyFunction());
+
+        /// Returns latency histograms of all TX and RX stages of packets
+        /// sent and received through this connection.
+        /// Thread safe and never blocks sending or receiving.
+        inline LatencyStatistics::Snapshot getLatencyStatistics() const
+        {
+            return m_latency->snapshot();
+        }
+
+        /// Returns traffic and queue counters of this connection.
+        /// Thread safe and never blocks sending or receiving.
+        inline ConnectionMetrics::Snapshot getMetrics() const
+        {
+            return m_metrics->snapshot();
+        }
+
     private:
+        struct QueuedPacket
+        {
+            ReceivedPacket m_packet;
+            std::chrono::steady_clock::time_point m_rxTime;
+            std::chrono::steady_clock::time_point m_queuedTime;
+            // set if queued with RX conflation enabled:
+            std::optional<uint64_t> m_conflationKey;
+        };
+
         Connection(Address f_remoteAddress, Address f_remoteMask, Address f_localAddress, Address f_localMask, Bus<Strategy> & f_pjonHL);
-        void addReceivedPacket(std::vector<uint8_t> && f_packet, Address f_remoteAddress, Address f_targetAddress);
+        void addReceivedPacket(const uint8_t * f_payload, uint16_t f_length, Address f_remoteAddress, Address f_targetAddress, std::chrono::steady_clock::time_point f_rxTime, std::chrono::steady_clock::time_point f_frameStartTime);
+
+        /// Waits for and pops the next received packet.
+        /// @returns false if no packet was received within the timeout.
+        bool popReceivedPacket(QueuedPacket & f_packet, uint32_t f_timeout_milliseconds);
         void setInactive();
+        void dropReceivedPackets();
 
         std::mutex m_rxQueueMutex;
         std::condition_variable m_rxQueueCondition;
-        std::queue<ReceivedPacket> m_rxQueue;
+        std::queue<QueuedPacket> m_rxQueue;
+        // payload storage handed back by receiveInto(), reused for new
+        // packets (guarded by m_rxQueueMutex):
+        std::vector<std::vector<uint8_t>> m_spareRxBuffers;
+        static constexpr size_t c_maxSpareRxBuffers = 8;
+
+        // RX conflation state (guarded by m_rxQueueMutex), queued packets by
+        // key (elements of a deque based queue do not move when pushing or
+        // popping others):
+        bool m_rxConflation = false;
+        RxConflationKeyFunction m_rxConflationKey;
+        std::unordered_map<uint64_t, QueuedPacket *> m_rxConflatedPackets;
+
+        // shared with queued TxRequests, which may outlive this connection:
+        std::shared_ptr<LatencyStatistics> m_latency = std::make_shared<LatencyStatistics>();
+        std::shared_ptr<ConnectionMetrics> m_metrics = std::make_shared<ConnectionMetrics>();
 
         const Address m_remoteAddress;
         const Address m_remoteMask;
         const Address m_localAddress;
         const Address m_localMask;
+
+        // packed form of above addresses used for matching (see
+        // Address::toKey()), addresses are already masked:
+        const uint64_t m_maskedRemoteKey;
+        const uint64_t m_remoteMaskKey;
+        const uint64_t m_maskedLocalKey;
+        const uint64_t m_localMaskKey;
         Bus<Strategy> & m_pjonHL;
         std::mutex m_activityMutex;
         bool m_active = true;
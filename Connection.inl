@@ -20,15 +20,20 @@ Connection<Strategy>::Connection(Address f_remoteAddress, Address f_remoteMask,
     m_remoteMask(f_remoteMask),
     m_localAddress(f_localAddress),
     m_localMask(f_localMask),
+    m_maskedRemoteKey(f_remoteAddress.toKey() & f_remoteMask.toKey()),
+    m_remoteMaskKey(f_remoteMask.toKey()),
+    m_maskedLocalKey(f_localAddress.toKey() & f_localMask.toKey()),
+    m_localMaskKey(f_localMask.toKey()),
     m_pjonHL(f_pjonHL),
     m_active(true)
 {
+    m_spareRxBuffers.reserve(c_maxSpareRxBuffers);
 }
 
 template<class Strategy>
-std::future<Result> Connection<Strategy>::send(const std::vector<uint8_t> && f_payload, uint32_t f_timeout_milliseconds, bool f_enableRetransmit)
+std::future<Result> Connection<Strategy>::send(std::vector<uint8_t> && f_payload, uint32_t f_timeout_milliseconds, bool f_enableRetransmit, CancelToken f_cancelToken)
 {
-    std::lock_guard<std::mutex> guard(m_activityMutex);
+    std::unique_lock<std::mutex> guard(m_activityMutex);
 
     if(not m_active)
     {
@@ -36,17 +41,202 @@ std::future<Result> Connection<Strategy>::send(const std::vector<uint8_t> && f_p
         promise.set_value(Result(std::string("Connection not active (is Bus instance still alive?)")));
         return promise.get_future();
     }
+    if(not m_pjonHL.acquireTxCredit(m_metrics.get()))
+    {
+        std::promise<Result> promise;
+        promise.set_value(Result::createTxQueueFullResult());
+        return promise.get_future();
+    }
     // TODO: I hope m_localAddress means to PJON what I think it means?
-    return m_pjonHL.send(m_localAddress, m_remoteAddress, f_payload, f_timeout_milliseconds, f_enableRetransmit);
+    auto request = m_pjonHL.createTxRequest(m_localAddress, m_remoteAddress, std::move(f_payload), f_timeout_milliseconds, f_enableRetransmit);
+    request.m_cancelToken = f_cancelToken;
+    request.m_connectionLatency = m_latency;
+    request.m_connectionMetrics = m_metrics;
+    auto cancelListener = m_pjonHL.getTxCancelListener(f_cancelToken);
+    auto future = m_pjonHL.enqueueTxRequest(std::move(request));
+    guard.unlock();
+    // added once queued and unlocked, as an already cancelled token
+    // completes the request right away:
+    if(cancelListener)
+    {
+        f_cancelToken.addListener(cancelListener);
+    }
+    return future;
+}
+
+template<class Strategy>
+std::future<Result> Connection<Strategy>::send(ConstBuffer f_payload, uint32_t f_timeout_milliseconds, bool f_enableRetransmit, CancelToken f_cancelToken)
+{
+    return send(f_payload.toVector(), f_timeout_milliseconds, f_enableRetransmit, std::move(f_cancelToken));
+}
+
+template<class Strategy>
+void Connection<Strategy>::send(ConstBuffer f_payload, SendCompletionHandler f_onComplete, uint32_t f_timeout_milliseconds, bool f_enableRetransmit, CancelToken f_cancelToken)
+{
+    send(ConstBufferList{f_payload}, std::move(f_onComplete), f_timeout_milliseconds, f_enableRetransmit, std::move(f_cancelToken));
+}
+
+template<class Strategy>
+std::future<Result> Connection<Strategy>::send(const ConstBufferList & f_segments, uint32_t f_timeout_milliseconds, bool f_enableRetransmit, CancelToken f_cancelToken)
+{
+    std::vector<uint8_t> payload;
+    payload.reserve(f_segments.totalSize());
+    f_segments.gatherInto(payload);
+    return send(std::move(payload), f_timeout_milliseconds, f_enableRetransmit, std::move(f_cancelToken));
+}
+
+template<class Strategy>
+void Connection<Strategy>::send(const ConstBufferList & f_segments, SendCompletionHandler f_onComplete, uint32_t f_timeout_milliseconds, bool f_enableRetransmit, CancelToken f_cancelToken)
+{
+    std::unique_lock<std::mutex> guard(m_activityMutex);
+
+    if(not m_active)
+    {
+        // unlocked, so the handler may use this connection:
+        guard.unlock();
+        f_onComplete(Result(std::string("Connection not active (is Bus instance still alive?)")));
+        return;
+    }
+    if(not m_pjonHL.acquireTxCredit(m_metrics.get()))
+    {
+        guard.unlock();
+        f_onComplete(Result::createTxQueueFullResult());
+        return;
+    }
+    auto request = m_pjonHL.createTxRequest(m_localAddress, m_remoteAddress, std::vector<uint8_t>(), f_timeout_milliseconds, f_enableRetransmit);
+    request.m_payloadSegments = f_segments;
+    request.m_completionHandler = std::move(f_onComplete);
+    request.m_cancelToken = f_cancelToken;
+    request.m_connectionLatency = m_latency;
+    request.m_connectionMetrics = m_metrics;
+    auto cancelListener = m_pjonHL.getTxCancelListener(f_cancelToken);
+    m_pjonHL.enqueueTxRequest(std::move(request));
+    guard.unlock();
+    // see above:
+    if(cancelListener)
+    {
+        f_cancelToken.addListener(cancelListener);
+    }
+}
+
+template<class Strategy>
+std::future<Result> Connection<Strategy>::sendLatest(std::vector<uint8_t> && f_payload, uint32_t f_timeout_milliseconds, bool f_enableRetransmit, uint8_t f_streamId)
+{
+    std::unique_lock<std::mutex> guard(m_activityMutex);
+
+    if(not m_active)
+    {
+        std::promise<Result> promise;
+        promise.set_value(Result(std::string("Connection not active (is Bus instance still alive?)")));
+        return promise.get_future();
+    }
+    auto request = m_pjonHL.createTxRequest(m_localAddress, m_remoteAddress, std::move(f_payload), f_timeout_milliseconds, f_enableRetransmit);
+    request.m_conflationKey = m_remoteAddress.toKey() | (uint64_t(f_streamId) << 56);
+    request.m_connectionLatency = m_latency;
+    request.m_connectionMetrics = m_metrics;
+    auto future = request.m_successPromise.emplace().get_future();
+
+    // replacing takes no additional place in the queue:
+    std::vector<std::function<void()>> creditCallbacks;
+    if(m_pjonHL.conflateTxRequest(request, creditCallbacks))
+    {
+        // unlocked, so the callbacks may use this connection:
+        guard.unlock();
+        for(auto & callback : creditCallbacks)
+        {
+            callback();
+        }
+        return future;
+    }
+    if(not m_pjonHL.acquireTxCredit(m_metrics.get()))
+    {
+        request.m_successPromise->set_value(Result::createTxQueueFullResult());
+        return future;
+    }
+    m_pjonHL.enqueueTxRequest(std::move(request));
+    return future;
+}
+
+template<class Strategy>
+void Connection<Strategy>::onTxCredit(std::function<void()> f_callback)
+{
+    std::unique_lock<std::mutex> guard(m_activityMutex);
+    if(not m_active)
+    {
+        return;
+    }
+    if(not m_pjonHL.addTxCreditWaiter(m_metrics.get(), f_callback))
+    {
+        guard.unlock();
+        f_callback();
+    }
+}
+
+template<class Strategy>
+template<class Message, class... Values>
+std::future<Result> Connection<Strategy>::send(Values && ... f_values)
+{
+    return send(Message::encode(std::forward<Values>(f_values)...));
 }
 
 template<class Strategy>
 Expect< ReceivedPacket > Connection<Strategy>::receive(uint32_t f_timeout_milliseconds)
+{
+    QueuedPacket queuedPacket;
+    if(popReceivedPacket(queuedPacket, f_timeout_milliseconds))
+    {
+        return Expect< ReceivedPacket >{std::move(queuedPacket.m_packet)};
+    }
+
+    return Expect<ReceivedPacket>{};
+}
+
+template<class Strategy>
+Expect< ReceivedPacketInfo > Connection<Strategy>::receiveInto(MutableBuffer f_buffer, uint32_t f_timeout_milliseconds)
+{
+    QueuedPacket queuedPacket;
+    if(not popReceivedPacket(queuedPacket, f_timeout_milliseconds))
+    {
+        return Expect<ReceivedPacketInfo>{};
+    }
+
+    ReceivedPacket & packet = queuedPacket.m_packet;
+    ReceivedPacketInfo info;
+    info.payloadSize = packet.payload.size();
+    info.size = std::min(info.payloadSize, f_buffer.size());
+    info.remoteAddress = packet.remoteAddress;
+    info.targetAddress = packet.targetAddress;
+    info.rxTime = packet.rxTime;
+    info.frameStartTime = packet.frameStartTime;
+    std::copy_n(packet.payload.begin(), info.size, f_buffer.begin());
+
+    std::lock_guard<std::mutex> guardRxQueue(m_rxQueueMutex);
+    if(m_spareRxBuffers.size() < c_maxSpareRxBuffers)
+    {
+        m_spareRxBuffers.push_back(std::move(packet.payload));
+    }
+    return Expect< ReceivedPacketInfo >{std::move(info)};
+}
+
+template<class Strategy>
+template<class Message>
+Expect< ReceivedMessage<Message> > Connection<Strategy>::receive(uint32_t f_timeout_milliseconds)
+{
+    auto packet = receive(f_timeout_milliseconds);
+    if(not packet.isValid() or not Message::isValid(packet.unwrap().payload))
+    {
+        return Expect< ReceivedMessage<Message> >();
+    }
+    return Expect< ReceivedMessage<Message> >(ReceivedMessage<Message>{std::move(packet).unwrap()});
+}
+
+template<class Strategy>
+bool Connection<Strategy>::popReceivedPacket(QueuedPacket & f_packet, uint32_t f_timeout_milliseconds)
 {
     std::unique_lock<std::mutex> guardActivity(m_activityMutex);
     if(not m_active)
     {
-        return Expect< ReceivedPacket >();
+        return false;
     }
 
     std::unique_lock<std::mutex> guardRxQueue(m_rxQueueMutex);
@@ -57,18 +247,34 @@ Expect< ReceivedPacket > Connection<Strategy>::receive(uint32_t f_timeout_millis
             [this]{return m_rxQueue.size()>0;}
             );
 
-    if(dataAvailable)
+    if(not dataAvailable)
     {
-        auto rxPacket = std::move(m_rxQueue.front());
-        m_rxQueue.pop();
-        return Expect< ReceivedPacket >{std::move(rxPacket)};
+        return false;
     }
 
-    return Expect<ReceivedPacket>{};
+    if(m_rxQueue.front().m_conflationKey)
+    {
+        // after setRxConflation() the key may belong to a newer packet:
+        auto queued = m_rxConflatedPackets.find(*m_rxQueue.front().m_conflationKey);
+        if(queued != m_rxConflatedPackets.end() and queued->second == &m_rxQueue.front())
+        {
+            m_rxConflatedPackets.erase(queued);
+        }
+    }
+    f_packet = std::move(m_rxQueue.front());
+    m_rxQueue.pop();
+    m_metrics->rxQueueDepth.decrease();
+    m_pjonHL.m_metrics.rxQueueDepth.decrease();
+    guardRxQueue.unlock();
+
+    auto popTime = std::chrono::steady_clock::now();
+    m_pjonHL.recordLatency(LatencyStatistics::RxQueueWait, popTime - f_packet.m_queuedTime, m_latency.get());
+    m_pjonHL.recordLatency(LatencyStatistics::RxTotal, popTime - f_packet.m_rxTime, m_latency.get());
+    return true;
 }
 
 template<class Strategy>
-void Connection<Strategy>::addReceivedPacket(std::vector<uint8_t> && f_payload, Address f_remoteAddress, Address f_targetAddress)
+void Connection<Strategy>::addReceivedPacket(const uint8_t * f_payload, uint16_t f_length, Address f_remoteAddress, Address f_targetAddress, std::chrono::steady_clock::time_point f_rxTime, std::chrono::steady_clock::time_point f_frameStartTime)
 {
     // NOTE: not locking m_activityMutex here
     //       - to avoid problems with condition variable.
@@ -81,10 +287,75 @@ void Connection<Strategy>::addReceivedPacket(std::vector<uint8_t> && f_payload,
     //       de-register before.
 
     // TODO: handle remote address here
+    // NOTE: Bus is alive, as it is the caller of this function
+    auto queuedTime = std::chrono::steady_clock::now();
+    m_pjonHL.recordLatency(LatencyStatistics::RxDispatch, queuedTime - f_rxTime, m_latency.get());
+    m_metrics->packetsReceived.add();
+    m_metrics->bytesReceived.add(f_length);
+
     std::unique_lock<std::mutex> guardRxQueue(m_rxQueueMutex);
-    m_rxQueue.push(ReceivedPacket(std::move(f_payload), f_remoteAddress, f_targetAddress));
+    std::vector<uint8_t> payload;
+    if(not m_spareRxBuffers.empty())
+    {
+        // reuses capacity, so usually does not allocate:
+        payload = std::move(m_spareRxBuffers.back());
+        m_spareRxBuffers.pop_back();
+    }
+    payload.assign(f_payload, f_payload + f_length);
+    QueuedPacket packet{ReceivedPacket(std::move(payload), f_remoteAddress, f_targetAddress, f_rxTime, f_frameStartTime), f_rxTime, queuedTime, std::nullopt};
+
+    if(m_rxConflation)
+    {
+        uint64_t key = m_rxConflationKey ? m_rxConflationKey(packet.m_packet) : f_remoteAddress.toKey();
+        auto queued = m_rxConflatedPackets.find(key);
+        if(queued != m_rxConflatedPackets.end())
+        {
+            // overwrite in place, the storage of the old payload is reused
+            // for later packets:
+            if(m_spareRxBuffers.size() < c_maxSpareRxBuffers)
+            {
+                m_spareRxBuffers.push_back(std::move(queued->second->m_packet.payload));
+            }
+            packet.m_conflationKey = key;
+            *queued->second = std::move(packet);
+            m_metrics->rxPacketsConflated.add();
+            m_pjonHL.m_metrics.rxPacketsConflated.add();
+            return;
+        }
+        packet.m_conflationKey = key;
+        m_rxQueue.push(std::move(packet));
+        m_rxConflatedPackets[key] = &m_rxQueue.back();
+    }
+    else
+    {
+        m_rxQueue.push(std::move(packet));
+    }
+    m_metrics->rxQueueDepth.increase();
+    m_pjonHL.m_metrics.rxQueueDepth.increase();
     m_rxQueueCondition.notify_all();
 }
+template<class Strategy>
+void Connection<Strategy>::setRxConflation(bool f_enable, RxConflationKeyFunction f_key)
+{
+    std::lock_guard<std::mutex> guardRxQueue(m_rxQueueMutex);
+    m_rxConflation = f_enable;
+    m_rxConflationKey = std::move(f_key);
+    // packets already queued with other keys are no longer overwritten:
+    m_rxConflatedPackets.clear();
+}
+
+template<class Strategy>
+void Connection<Strategy>::dropReceivedPackets()
+{
+    std::lock_guard<std::mutex> guardRxQueue(m_rxQueueMutex);
+    m_rxConflatedPackets.clear();
+    while(not m_rxQueue.empty())
+    {
+        m_rxQueue.pop();
+        m_metrics->rxQueueDepth.decrease();
+        m_pjonHL.m_metrics.rxQueueDepth.decrease();
+    }
+}
 
 template<class Strategy>
 void Connection<Strategy>::setInactive()
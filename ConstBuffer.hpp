@@ -0,0 +1,191 @@
+// Copyright 2021 Rainer Schoenberger
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <initializer_list>
+#include <inttypes.h>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+#if __cplusplus >= 202002L && __has_include(<span>)
+#include <span>
+#endif
+
+namespace PjonHL
+{
+
+/// Non-owning view of a contiguous byte sequence (std::span<const uint8_t>
+/// is not available in C++17).
+/// Implicitly constructible from vectors, arrays and (with C++20) spans, so
+/// it can be passed wherever a payload is expected.
+/// The viewed memory has to outlive the ConstBuffer.
+class ConstBuffer
+{
+    public:
+        constexpr ConstBuffer() = default;
+
+        /// Views f_size bytes starting at f_data.
+        /// (template, so a literal 0 is not taken as a null pointer, which
+        /// would make e.g. send({0, 1}) ambiguous)
+        template<class Byte, class = std::enable_if_t<sizeof(Byte) == 1>>
+        constexpr ConstBuffer(const Byte * f_data, size_t f_size) :
+            m_data(reinterpret_cast<const uint8_t *>(f_data)),
+            m_size(f_size)
+        {
+        }
+
+        inline ConstBuffer(const std::vector<uint8_t> & f_vector) :
+            m_data(f_vector.data()),
+            m_size(f_vector.size())
+        {
+        }
+
+        template<size_t N>
+        constexpr ConstBuffer(const std::array<uint8_t, N> & f_array) :
+            m_data(f_array.data()),
+            m_size(N)
+        {
+        }
+
+        template<size_t N>
+        constexpr ConstBuffer(const uint8_t (&f_array)[N]) :
+            m_data(f_array),
+            m_size(N)
+        {
+        }
+
+#if __cplusplus >= 202002L && __has_include(<span>)
+        constexpr ConstBuffer(std::span<const uint8_t> f_span) :
+            m_data(f_span.data()),
+            m_size(f_span.size())
+        {
+        }
+#endif
+
+        constexpr const uint8_t * data() const
+        {
+            return m_data;
+        }
+
+        constexpr size_t size() const
+        {
+            return m_size;
+        }
+
+        constexpr bool empty() const
+        {
+            return m_size == 0;
+        }
+
+        constexpr const uint8_t * begin() const
+        {
+            return m_data;
+        }
+
+        constexpr const uint8_t * end() const
+        {
+            return m_data + m_size;
+        }
+
+        /// @returns an owning copy of the viewed bytes.
+        inline std::vector<uint8_t> toVector() const
+        {
+            return std::vector<uint8_t>(begin(), end());
+        }
+
+    private:
+        const uint8_t * m_data = nullptr;
+        size_t m_size = 0;
+};
+
+/// Ordered list of payload segments (like an iovec array), e.g. a protocol
+/// header and a pre-serialized body, sent as one packet.
+/// Stores up to Capacity segments in place, so creating it does not allocate.
+class ConstBufferList
+{
+    public:
+        static constexpr size_t Capacity = 8;
+
+        ConstBufferList() = default;
+
+        /// @throws std::length_error if more than Capacity segments are given.
+        inline ConstBufferList(std::initializer_list<ConstBuffer> f_segments)
+        {
+            for(const ConstBuffer & segment : f_segments)
+            {
+                push_back(segment);
+            }
+        }
+
+        /// @throws std::length_error if the list already holds Capacity
+        ///         segments.
+        inline void push_back(ConstBuffer f_segment)
+        {
+            if(m_count == Capacity)
+            {
+                throw std::length_error("ConstBufferList capacity exceeded");
+            }
+            m_segments[m_count++] = f_segment;
+        }
+
+        /// Number of segments.
+        inline size_t size() const
+        {
+            return m_count;
+        }
+
+        /// Sum of all segment sizes.
+        inline size_t totalSize() const
+        {
+            size_t total = 0;
+            for(const ConstBuffer & segment : *this)
+            {
+                total += segment.size();
+            }
+            return total;
+        }
+
+        inline const ConstBuffer & operator[](size_t f_index) const
+        {
+            return m_segments[f_index];
+        }
+
+        inline const ConstBuffer * begin() const
+        {
+            return m_segments.data();
+        }
+
+        inline const ConstBuffer * end() const
+        {
+            return m_segments.data() + m_count;
+        }
+
+        /// Appends all segments in order to f_target.
+        inline void gatherInto(std::vector<uint8_t> & f_target) const
+        {
+            for(const ConstBuffer & segment : *this)
+            {
+                f_target.insert(f_target.end(), segment.begin(), segment.end());
+            }
+        }
+
+    private:
+        std::array<ConstBuffer, Capacity> m_segments;
+        size_t m_count = 0;
+};
+
+}
@@ -15,36 +15,65 @@
 #pragma once
 
 #include <cstdlib>
+#include <optional>
 #include <stdexcept>
+#include <utility>
 
+/// Optionally holds a value of type T.
+/// The value is stored in place and only constructed if valid, i.e. T does
+/// not need to be default constructible. Movable and copyable if T is.
 template<class T>
 class Expect
 {
     public:
         bool isValid() const
         {
-            return m_valid;
+            return m_value.has_value();
         };
 
-        T& unwrap()
+        T& unwrap() &
         {
-            if(not m_valid)
-            {
-                throw(std::runtime_error("Unwrapping non existing value."));
-            }
-            return m_value;
+            throwIfInvalid();
+            return *m_value;
         }
 
-        Expect() :
-            m_valid(false)
-        {};
+        const T& unwrap() const &
+        {
+            throwIfInvalid();
+            return *m_value;
+        }
+
+        /// Moves the value out of a temporary Expect.
+        T unwrap() &&
+        {
+            throwIfInvalid();
+            return std::move(*m_value);
+        }
+
+        Expect() = default;
 
         Expect(T && f_value) :
-            m_valid(true),
+            m_value{std::move(f_value)}
+        {};
+
+        Expect(const T & f_value) :
             m_value{f_value}
         {};
 
+        /// Constructs the value in place from f_args.
+        template<class... Args>
+        explicit Expect(std::in_place_t, Args && ... f_args) :
+            m_value{std::in_place, std::forward<Args>(f_args)...}
+        {};
+
     private:
-        const bool m_valid;
-        T m_value;
+        void throwIfInvalid() const
+        {
+            if(not m_value.has_value())
+            {
+                throw(std::runtime_error("Unwrapping non existing value."));
+            }
+        }
+
+        std::optional<T> m_value;
 };
@@ -0,0 +1,165 @@
+// Copyright 2021 Rainer Schoenberger
+// 
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+// 
+//     http://www.apache.org/licenses/LICENSE-2.0
+// 
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "LatencyHistogram.hpp"
+#include <algorithm>
+#include <cmath>
+
+namespace PjonHL
+{
+
+// -----------------------------------------------------------------------------
+uint32_t LatencyHistogram::bucketIndex(uint64_t f_microseconds)
+{
+    if(f_microseconds < SubBucketCount)
+    {
+        // linear range
+        return static_cast<uint32_t>(f_microseconds);
+    }
+    if(f_microseconds >= (uint64_t(1) << MaxValueBits))
+    {
+        return BucketCount - 1;
+    }
+    // position of highest set bit:
+    uint32_t exponent = 63 - __builtin_clzll(f_microseconds);
+    uint32_t shift = exponent - SubBucketBits;
+    uint32_t subBucket = static_cast<uint32_t>(f_microseconds >> shift) & (SubBucketCount - 1);
+    return (shift + 1) * SubBucketCount + subBucket;
+}
+
+// -----------------------------------------------------------------------------
+uint64_t LatencyHistogram::bucketUpperBound(uint32_t f_bucketIndex)
+{
+    if(f_bucketIndex < SubBucketCount)
+    {
+        return f_bucketIndex;
+    }
+    uint32_t shift = f_bucketIndex / SubBucketCount - 1;
+    uint64_t subBucket = f_bucketIndex % SubBucketCount;
+    uint64_t lowerBound = (SubBucketCount + subBucket) << shift;
+    return lowerBound + (uint64_t(1) << shift) - 1;
+}
+
+// -----------------------------------------------------------------------------
+void LatencyHistogram::record(std::chrono::steady_clock::duration f_duration)
+{
+    auto microseconds = std::chrono::duration_cast<std::chrono::microseconds>(f_duration).count();
+    recordMicroseconds(microseconds > 0 ? static_cast<uint64_t>(microseconds) : 0);
+}
+
+// -----------------------------------------------------------------------------
+void LatencyHistogram::recordMicroseconds(uint64_t f_microseconds)
+{
+    m_buckets[bucketIndex(f_microseconds)].fetch_add(1, std::memory_order_relaxed);
+    m_sum.fetch_add(f_microseconds, std::memory_order_relaxed);
+    uint64_t max = m_max.load(std::memory_order_relaxed);
+    while(f_microseconds > max and not m_max.compare_exchange_weak(max, f_microseconds, std::memory_order_relaxed))
+    {
+    }
+}
+
+// -----------------------------------------------------------------------------
+LatencyHistogram::Snapshot LatencyHistogram::snapshot() const
+{
+    Snapshot snapshot;
+    // NOTE: count is summed up from the buckets, so it is consistent with
+    //       them even if recording happens in parallel.
+    for(uint32_t i = 0; i < BucketCount; i++)
+    {
+        snapshot.buckets[i] = m_buckets[i].load(std::memory_order_relaxed);
+        snapshot.count += snapshot.buckets[i];
+    }
+    snapshot.sumMicroseconds = m_sum.load(std::memory_order_relaxed);
+    snapshot.maxMicroseconds = m_max.load(std::memory_order_relaxed);
+    return snapshot;
+}
+
+// -----------------------------------------------------------------------------
+void LatencyHistogram::reset()
+{
+    for(auto & bucket : m_buckets)
+    {
+        bucket.store(0, std::memory_order_relaxed);
+    }
+    m_sum.store(0, std::memory_order_relaxed);
+    m_max.store(0, std::memory_order_relaxed);
+}
+
+// -----------------------------------------------------------------------------
+uint64_t LatencyHistogram::Snapshot::percentileMicroseconds(double f_quantile) const
+{
+    if(count == 0)
+    {
+        return 0;
+    }
+    f_quantile = std::min(std::max(f_quantile, 0.0), 1.0);
+    uint64_t rank = std::max<uint64_t>(1, static_cast<uint64_t>(std::ceil(f_quantile * count)));
+    uint64_t seen = 0;
+    for(uint32_t i = 0; i < BucketCount; i++)
+    {
+        seen += buckets[i];
+        if(seen >= rank)
+        {
+            return std::min(bucketUpperBound(i), maxMicroseconds);
+        }
+    }
+    return maxMicroseconds;
+}
+
+// -----------------------------------------------------------------------------
+uint64_t LatencyHistogram::Snapshot::meanMicroseconds() const
+{
+    if(count == 0)
+    {
+        return 0;
+    }
+    return sumMicroseconds / count;
+}
+
+// -----------------------------------------------------------------------------
+const char * LatencyStatistics::stageName(Stage f_stage)
+{
+    switch(f_stage)
+    {
+        case TxQueueWait:
+            return "txQueueWait";
+        case TxWire:
+            return "txWire";
+        case TxCompletion:
+            return "txCompletion";
+        case TxTotal:
+            return "txTotal";
+        case RxDispatch:
+            return "rxDispatch";
+        case RxQueueWait:
+            return "rxQueueWait";
+        case RxTotal:
+            return "rxTotal";
+        default:
+            return "unknown";
+    }
+}
+
+// -----------------------------------------------------------------------------
+LatencyStatistics::Snapshot LatencyStatistics::snapshot() const
+{
+    Snapshot snapshot;
+    for(size_t i = 0; i < StageCount; i++)
+    {
+        snapshot[i] = histograms[i].snapshot();
+    }
+    return snapshot;
+}
+
+}
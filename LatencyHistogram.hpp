@@ -0,0 +1,119 @@
+// Copyright 2021 Rainer Schoenberger
+// 
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+// 
+//     http://www.apache.org/licenses/LICENSE-2.0
+// 
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <inttypes.h>
+
+namespace PjonHL
+{
+
+/// Lock free histogram of durations with fixed log-linear buckets (similar to
+/// HDR histograms).
+/// Values are recorded in microseconds. Each power of two is split into
+/// 8 linear sub-buckets, which gives a relative error of at most 12.5%.
+/// Values up to 2^32 microseconds (~71 minutes) are tracked, larger values
+/// are clamped into the last bucket.
+/// record() may be called concurrently from any thread and never blocks.
+class LatencyHistogram
+{
+    public:
+        static constexpr uint32_t SubBucketBits = 3;
+        static constexpr uint32_t SubBucketCount = 1 << SubBucketBits;
+        static constexpr uint32_t MaxValueBits = 32;
+        static constexpr uint32_t BucketCount = (MaxValueBits - SubBucketBits + 1) * SubBucketCount;
+
+        /// Consistent-enough copy of a histogram.
+        struct Snapshot
+        {
+            uint64_t count = 0;
+            uint64_t sumMicroseconds = 0;
+            uint64_t maxMicroseconds = 0;
+            std::array<uint64_t, BucketCount> buckets = {};
+
+            /// @param f_quantile value in range [0,1], e.g. 0.99 for p99
+            /// @returns upper bound of the bucket containing the given
+            ///          quantile (clamped to max value) or 0 if empty.
+            uint64_t percentileMicroseconds(double f_quantile) const;
+
+            inline uint64_t p50() const { return percentileMicroseconds(0.5); }
+            inline uint64_t p99() const { return percentileMicroseconds(0.99); }
+            inline uint64_t p999() const { return percentileMicroseconds(0.999); }
+
+            uint64_t meanMicroseconds() const;
+        };
+
+        void record(std::chrono::steady_clock::duration f_duration);
+        void recordMicroseconds(uint64_t f_microseconds);
+
+        Snapshot snapshot() const;
+
+        void reset();
+
+        static uint32_t bucketIndex(uint64_t f_microseconds);
+
+        /// @returns largest value (inclusive) which maps to given bucket
+        static uint64_t bucketUpperBound(uint32_t f_bucketIndex);
+
+    private:
+        std::array<std::atomic<uint64_t>, BucketCount> m_buckets = {};
+        std::atomic<uint64_t> m_sum{0};
+        std::atomic<uint64_t> m_max{0};
+};
+
+/// Latency histograms for all stages a packet passes in PjonHL.
+/// TX stages (Connection::send() until future is ready):
+///   enqueue -> dispatch -> wire complete -> promise set
+/// RX stages (PJON receive callback until Connection::receive() returns it):
+///   rx callback -> queue push -> consumer pop
+struct LatencyStatistics
+{
+    enum Stage
+    {
+        /// enqueue until first dispatch to PJON
+        TxQueueWait,
+        /// (last) dispatch to PJON until PJON reports success/failure
+        TxWire,
+        /// PJON completion until result is set in future
+        TxCompletion,
+        /// enqueue until result is set in future
+        TxTotal,
+        /// PJON receive callback until packet is pushed to connection queue
+        RxDispatch,
+        /// packet pushed to connection queue until popped by consumer
+        RxQueueWait,
+        /// PJON receive callback until popped by consumer
+        RxTotal,
+        StageCount
+    };
+
+    using Snapshot = std::array<LatencyHistogram::Snapshot, StageCount>;
+
+    static const char * stageName(Stage f_stage);
+
+    inline void record(Stage f_stage, std::chrono::steady_clock::duration f_duration)
+    {
+        histograms[f_stage].record(f_duration);
+    }
+
+    Snapshot snapshot() const;
+
+    std::array<LatencyHistogram, StageCount> histograms;
+};
+
+}
@@ -0,0 +1,134 @@
+// Copyright 2021 Rainer Schoenberger
+// 
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+// 
+//     http://www.apache.org/licenses/LICENSE-2.0
+// 
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <type_traits>
+
+namespace PjonHL
+{
+
+/// Bounded lock free multi-producer/multi-consumer queue (D. Vyukov's
+/// algorithm). All storage is allocated on construction, push() and pop()
+/// never allocate and never block.
+/// @tparam T element type. Needs to be trivially copyable.
+template<class T>
+class BoundedMpmcQueue
+{
+    static_assert(std::is_trivially_copyable<T>::value, "BoundedMpmcQueue requires trivially copyable elements");
+
+    public:
+        /// @param f_capacity number of elements, rounded up to next power of two.
+        explicit BoundedMpmcQueue(size_t f_capacity)
+        {
+            size_t capacity = 2;
+            while(capacity < f_capacity)
+            {
+                capacity *= 2;
+            }
+            m_mask = capacity - 1;
+            m_cells.reset(new Cell[capacity]);
+            for(size_t i = 0; i < capacity; i++)
+            {
+                m_cells[i].m_sequence.store(i, std::memory_order_relaxed);
+            }
+        }
+
+        BoundedMpmcQueue(const BoundedMpmcQueue &) = delete;
+        BoundedMpmcQueue & operator=(const BoundedMpmcQueue &) = delete;
+
+        /// @returns false if queue is full (element is not pushed)
+        bool push(const T & f_value)
+        {
+            size_t position = m_enqueuePosition.load(std::memory_order_relaxed);
+            for(;;)
+            {
+                Cell & cell = m_cells[position & m_mask];
+                size_t sequence = cell.m_sequence.load(std::memory_order_acquire);
+                intptr_t difference = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(position);
+                if(difference == 0)
+                {
+                    if(m_enqueuePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+                    {
+                        cell.m_value = f_value;
+                        cell.m_sequence.store(position + 1, std::memory_order_release);
+                        return true;
+                    }
+                }
+                else if(difference < 0)
+                {
+                    return false;
+                }
+                else
+                {
+                    position = m_enqueuePosition.load(std::memory_order_relaxed);
+                }
+            }
+        }
+
+        /// @returns false if queue is empty (f_value is not modified)
+        bool pop(T & f_value)
+        {
+            size_t position = m_dequeuePosition.load(std::memory_order_relaxed);
+            for(;;)
+            {
+                Cell & cell = m_cells[position & m_mask];
+                size_t sequence = cell.m_sequence.load(std::memory_order_acquire);
+                intptr_t difference = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(position + 1);
+                if(difference == 0)
+                {
+                    if(m_dequeuePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+                    {
+                        f_value = cell.m_value;
+                        cell.m_sequence.store(position + m_mask + 1, std::memory_order_release);
+                        return true;
+                    }
+                }
+                else if(difference < 0)
+                {
+                    return false;
+                }
+                else
+                {
+                    position = m_dequeuePosition.load(std::memory_order_relaxed);
+                }
+            }
+        }
+
+        inline size_t capacity() const
+        {
+            return m_mask + 1;
+        }
+
+    private:
+        struct Cell
+        {
+            std::atomic<size_t> m_sequence;
+            T m_value;
+        };
+
+        std::unique_ptr<Cell[]> m_cells;
+        size_t m_mask;
+
+        // separate cache lines to avoid false sharing between producers and
+        // consumer:
+        alignas(64) std::atomic<size_t> m_enqueuePosition{0};
+        alignas(64) std::atomic<size_t> m_dequeuePosition{0};
+};
+
+}
@@ -0,0 +1,101 @@
+// Copyright 2021 Rainer Schoenberger
+// 
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+// 
+//     http://www.apache.org/licenses/LICENSE-2.0
+// 
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "Logger.hpp"
+#include <charconv>
+
+namespace PjonHL
+{
+
+// -----------------------------------------------------------------------------
+void Logger::logRecord(const LogRecord & f_record)
+{
+    if(isEnabled(f_record.level))
+    {
+        log(f_record.level, f_record.toString());
+    }
+}
+
+// -----------------------------------------------------------------------------
+LogRecord LogRecord::rxPacket(Address f_remote, Address f_target, uint32_t f_packetId, bool f_packetIdValid)
+{
+    LogRecord record;
+    record.timestamp = std::chrono::steady_clock::now();
+    record.level = Logger::Debug;
+    record.event = Event::RxPacket;
+    record.address1 = f_remote;
+    record.address2 = f_target;
+    record.value1 = f_packetId;
+    record.value2 = f_packetIdValid ? 1 : 0;
+    return record;
+}
+
+// -----------------------------------------------------------------------------
+LogRecord LogRecord::txRetransmit(Address f_remote, uint32_t f_attempt, uint32_t f_backoffMicroseconds)
+{
+    LogRecord record;
+    record.timestamp = std::chrono::steady_clock::now();
+    record.level = Logger::Debug;
+    record.event = Event::TxRetransmit;
+    record.address1 = f_remote;
+    record.value1 = f_attempt;
+    record.value2 = f_backoffMicroseconds;
+    return record;
+}
+
+// -----------------------------------------------------------------------------
+void LogRecord::format(std::string & f_output) const
+{
+    auto appendNumber = [&f_output](uint64_t f_value)
+    {
+        char buffer[20];
+        f_output.append(buffer, std::to_chars(buffer, buffer + sizeof(buffer), f_value).ptr);
+    };
+    switch(event)
+    {
+        case Event::RxPacket:
+            f_output += "Rx packet: remote=";
+            address1.appendTo(f_output);
+            f_output += " target=";
+            address2.appendTo(f_output);
+            f_output += " packet id = ";
+            if(value2)
+            {
+                appendNumber(value1);
+            }
+            else
+            {
+                f_output += "[DISABLED_IN_PJON_HL]";
+            }
+            break;
+        case Event::TxRetransmit:
+            f_output += "Tx retransmit scheduled: remote=";
+            address1.appendTo(f_output);
+            f_output += " attempt=";
+            appendNumber(value1);
+            f_output += " backoff_us=";
+            appendNumber(value2);
+            break;
+    }
+}
+
+// -----------------------------------------------------------------------------
+std::string LogRecord::toString() const
+{
+    std::string result;
+    format(result);
+    return result;
+}
+
+}
@@ -0,0 +1,111 @@
+// Copyright 2021 Rainer Schoenberger
+// 
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+// 
+//     http://www.apache.org/licenses/LICENSE-2.0
+// 
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <inttypes.h>
+#include <iostream>
+#include <string>
+
+#include "Address.hpp"
+
+namespace PjonHL
+{
+
+struct LogRecord;
+
+class Logger
+{
+    public:
+        enum LogLevel
+        {
+            Debug,
+            Info,
+            Error
+        };
+
+        virtual ~Logger() = default;
+
+        virtual void log(LogLevel f_level, std::string f_message) = 0;
+
+        /// Logs a structured record emitted by the hot path (e.g. on every
+        /// received packet).
+        /// Default implementation formats the record and forwards it to
+        /// log(). Loggers may override this to avoid formatting (and
+        /// allocating) in the calling thread.
+        /// NOTE: Callers check isEnabled() before creating a record.
+        virtual void logRecord(const LogRecord & f_record);
+
+        /// @returns true if messages of the given level are processed.
+        ///          Cheap enough to be called before formatting any message.
+        inline bool isEnabled(LogLevel f_level) const
+        {
+            return f_level >= m_level.load(std::memory_order_relaxed);
+        }
+
+        /// Sets the minimum level of processed messages.
+        /// Default is Debug (i.e. everything is logged).
+        inline void setLevel(LogLevel f_level)
+        {
+            m_level.store(f_level, std::memory_order_relaxed);
+        }
+
+    private:
+        std::atomic<LogLevel> m_level{Debug};
+};
+
+/// Compact binary representation of a log event. Trivially copyable, so it
+/// can be created and passed around without any allocation. Converting to
+/// text is deferred until format() is called.
+struct LogRecord
+{
+    enum class Event : uint8_t
+    {
+        /// address1 = remote, address2 = target, value1 = packet id,
+        /// value2 = 1 if packet id is valid
+        RxPacket,
+        /// address1 = remote, value1 = attempt, value2 = backoff in us
+        TxRetransmit
+    };
+
+    static LogRecord rxPacket(Address f_remote, Address f_target, uint32_t f_packetId, bool f_packetIdValid);
+    static LogRecord txRetransmit(Address f_remote, uint32_t f_attempt, uint32_t f_backoffMicroseconds);
+
+    /// Appends human readable message (without level/timestamp) to given string.
+    void format(std::string & f_output) const;
+
+    std::string toString() const;
+
+    std::chrono::steady_clock::time_point timestamp;
+    Logger::LogLevel level = Logger::Debug;
+    Event event = Event::RxPacket;
+    Address address1;
+    Address address2;
+    uint32_t value1 = 0;
+    uint32_t value2 = 0;
+};
+
+class DefaultLogger : public Logger
+{
+    public:
+
+        virtual inline void log(LogLevel f_level, std::string f_message) override
+        {
+            std::cout << "PjonHl: " << f_message << std::endl;
+        }
+};
+
+}
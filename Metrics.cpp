@@ -0,0 +1,85 @@
+// Copyright 2021 Rainer Schoenberger
+// 
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+// 
+//     http://www.apache.org/licenses/LICENSE-2.0
+// 
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "Metrics.hpp"
+#include <cstddef>
+
+namespace PjonHL
+{
+
+// -----------------------------------------------------------------------------
+void Gauge::increase(uint64_t f_value)
+{
+    uint64_t current = m_current.fetch_add(f_value, std::memory_order_relaxed) + f_value;
+    uint64_t peak = m_peak.load(std::memory_order_relaxed);
+    while(current > peak and not m_peak.compare_exchange_weak(peak, current, std::memory_order_relaxed))
+    {
+    }
+}
+
+// -----------------------------------------------------------------------------
+void Gauge::decrease(uint64_t f_value)
+{
+    m_current.fetch_sub(f_value, std::memory_order_relaxed);
+}
+
+// -----------------------------------------------------------------------------
+BusMetrics::Snapshot BusMetrics::snapshot() const
+{
+    Snapshot snapshot;
+    snapshot.packetsSent = packetsSent.get();
+    snapshot.bytesSent = bytesSent.get();
+    snapshot.sendFailures = sendFailures.get();
+    snapshot.sendsCancelled = sendsCancelled.get();
+    snapshot.sendsSuperseded = sendsSuperseded.get();
+    snapshot.dispatchFailures = dispatchFailures.get();
+    snapshot.retransmissions = retransmissions.get();
+    snapshot.packetsReceived = packetsReceived.get();
+    snapshot.bytesReceived = bytesReceived.get();
+    snapshot.packetsUnmatched = packetsUnmatched.get();
+    snapshot.packetsPortDispatched = packetsPortDispatched.get();
+    snapshot.rxPacketsConflated = rxPacketsConflated.get();
+    for(size_t i = 0; i < errors.size(); i++)
+    {
+        snapshot.errors[i] = errors[i].get();
+    }
+    snapshot.txQueueDepth = txQueueDepth.snapshot();
+    snapshot.rxQueueDepth = rxQueueDepth.snapshot();
+    snapshot.txQueueRejects = txQueueRejects.get();
+    snapshot.txQueueWaits = txQueueWaits.get();
+    snapshot.eventLoopIterations = eventLoopIterations.get();
+    snapshot.idleSleeps = idleSleeps.get();
+    snapshot.receiveCalls = receiveCalls.get();
+    return snapshot;
+}
+
+// -----------------------------------------------------------------------------
+ConnectionMetrics::Snapshot ConnectionMetrics::snapshot() const
+{
+    Snapshot snapshot;
+    snapshot.packetsSent = packetsSent.get();
+    snapshot.bytesSent = bytesSent.get();
+    snapshot.sendFailures = sendFailures.get();
+    snapshot.sendsCancelled = sendsCancelled.get();
+    snapshot.sendsSuperseded = sendsSuperseded.get();
+    snapshot.packetsReceived = packetsReceived.get();
+    snapshot.bytesReceived = bytesReceived.get();
+    snapshot.rxPacketsConflated = rxPacketsConflated.get();
+    snapshot.txQueueDepth = txQueueDepth.snapshot();
+    snapshot.rxQueueDepth = rxQueueDepth.snapshot();
+    snapshot.txQueueRejects = txQueueRejects.get();
+    return snapshot;
+}
+
+}
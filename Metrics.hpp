@@ -0,0 +1,180 @@
+// Copyright 2021 Rainer Schoenberger
+// 
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+// 
+//     http://www.apache.org/licenses/LICENSE-2.0
+// 
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <inttypes.h>
+
+namespace PjonHL
+{
+
+/// Monotonic event counter. Lock free, may be incremented from any thread.
+class Counter
+{
+    public:
+        inline void add(uint64_t f_value = 1)
+        {
+            m_value.fetch_add(f_value, std::memory_order_relaxed);
+        }
+
+        inline uint64_t get() const
+        {
+            return m_value.load(std::memory_order_relaxed);
+        }
+
+    private:
+        std::atomic<uint64_t> m_value{0};
+};
+
+/// Current value with peak tracking (e.g. queue depth). Lock free.
+class Gauge
+{
+    public:
+        struct Snapshot
+        {
+            uint64_t current = 0;
+            uint64_t peak = 0;
+        };
+
+        void increase(uint64_t f_value = 1);
+        void decrease(uint64_t f_value = 1);
+
+        inline Snapshot snapshot() const
+        {
+            return Snapshot{m_current.load(std::memory_order_relaxed), m_peak.load(std::memory_order_relaxed)};
+        }
+
+    private:
+        std::atomic<uint64_t> m_current{0};
+        std::atomic<uint64_t> m_peak{0};
+};
+
+/// Counters of a Bus. Updated by the Bus from its event-loop thread and from
+/// threads using its connections. Never blocks.
+struct BusMetrics
+{
+    struct Snapshot
+    {
+        /// Packets/bytes successfully sent (as reported by PJON)
+        uint64_t packetsSent = 0;
+        uint64_t bytesSent = 0;
+        /// Packets which finally failed to be sent (after all retransmissions)
+        uint64_t sendFailures = 0;
+        /// Packets withdrawn through their CancelToken before being sent
+        uint64_t sendsCancelled = 0;
+        /// Packets replaced by a newer packet of their stream before being
+        /// sent (see Connection::sendLatest())
+        uint64_t sendsSuperseded = 0;
+        /// Packets PJON did not accept for sending (e.g. too big)
+        uint64_t dispatchFailures = 0;
+        /// Number of PjonHL level retransmissions scheduled
+        uint64_t retransmissions = 0;
+
+        /// Packets/bytes received from PJON
+        uint64_t packetsReceived = 0;
+        uint64_t bytesReceived = 0;
+        /// Received packets which did not match any connection
+        uint64_t packetsUnmatched = 0;
+        /// Received packets passed to a handler of Bus::setPortHandler()
+        uint64_t packetsPortDispatched = 0;
+        /// Queued packets overwritten by newer ones (see
+        /// Connection::setRxConflation())
+        uint64_t rxPacketsConflated = 0;
+
+        /// Calls of PJON error callback indexed by error code (e.g.
+        /// PJON_CONNECTION_LOST or PJON_PACKETS_BUFFER_FULL).
+        std::array<uint64_t, 256> errors = {};
+
+        /// Packets waiting to be (or currently being) sent. The peak is the
+        /// high watermark to compare against BusConfig::TxQueueConfig.
+        Gauge::Snapshot txQueueDepth;
+        /// Received packets waiting in connections to be received by user
+        Gauge::Snapshot rxQueueDepth;
+
+        /// Packets not queued, as the TX queue was full (see
+        /// BusConfig::TxQueueConfig)
+        uint64_t txQueueRejects = 0;
+        /// Sends which had to wait for space in the TX queue
+        uint64_t txQueueWaits = 0;
+
+        uint64_t eventLoopIterations = 0;
+        uint64_t idleSleeps = 0;
+        uint64_t receiveCalls = 0;
+
+        inline double receiveCallsPerIteration() const
+        {
+            return eventLoopIterations == 0 ? 0.0 : double(receiveCalls) / double(eventLoopIterations);
+        }
+    };
+
+    Snapshot snapshot() const;
+
+    Counter packetsSent;
+    Counter bytesSent;
+    Counter sendFailures;
+    Counter sendsCancelled;
+    Counter sendsSuperseded;
+    Counter dispatchFailures;
+    Counter retransmissions;
+    Counter packetsReceived;
+    Counter bytesReceived;
+    Counter packetsUnmatched;
+    Counter packetsPortDispatched;
+    Counter rxPacketsConflated;
+    std::array<Counter, 256> errors;
+    Gauge txQueueDepth;
+    Gauge rxQueueDepth;
+    Counter txQueueRejects;
+    Counter txQueueWaits;
+    Counter eventLoopIterations;
+    Counter idleSleeps;
+    Counter receiveCalls;
+};
+
+/// Counters of a single Connection. Never blocks.
+struct ConnectionMetrics
+{
+    struct Snapshot
+    {
+        uint64_t packetsSent = 0;
+        uint64_t bytesSent = 0;
+        uint64_t sendFailures = 0;
+        uint64_t sendsCancelled = 0;
+        uint64_t sendsSuperseded = 0;
+        uint64_t packetsReceived = 0;
+        uint64_t bytesReceived = 0;
+        uint64_t rxPacketsConflated = 0;
+        Gauge::Snapshot txQueueDepth;
+        Gauge::Snapshot rxQueueDepth;
+        uint64_t txQueueRejects = 0;
+    };
+
+    Snapshot snapshot() const;
+
+    Counter packetsSent;
+    Counter bytesSent;
+    Counter sendFailures;
+    Counter sendsCancelled;
+    Counter sendsSuperseded;
+    Counter packetsReceived;
+    Counter bytesReceived;
+    Counter rxPacketsConflated;
+    Gauge txQueueDepth;
+    Gauge rxQueueDepth;
+    Counter txQueueRejects;
+};
+
+}
@@ -0,0 +1,210 @@
+// Copyright 2021 Rainer Schoenberger
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "Address.hpp"
+#include "Connection.hpp"
+#include "PjonHlBus.hpp"
+
+namespace PjonHL
+{
+
+/// Options of a MulticastGroup.
+struct MulticastConfig
+{
+    /// Set if the members are all devices of their bus segment (all members
+    /// have the same bus id and port). A packet is then sent as one
+    /// PJON_BROADCAST frame instead of one frame per member.
+    /// PJON does not acknowledge broadcasts, so members have to answer it,
+    /// see isAcknowledgement.
+    bool membersCoverBus = false;
+
+    /// Time to wait for the acknowledgements of a broadcast.
+    uint32_t ackTimeoutMilliseconds = 500;
+
+    /// Decides if a packet received from a member after a broadcast
+    /// acknowledges it. If not set, any packet from a member does.
+    /// Called from the thread waiting for acknowledgements.
+    std::function<bool(const ReceivedPacket &)> isAcknowledgement;
+
+    /// Members not acknowledging a broadcast in time are sent the packet
+    /// individually (with their transmission result in MulticastResult).
+    bool unicastFallback = true;
+};
+
+/// Result of MulticastGroup::send().
+struct MulticastResult
+{
+    struct Member
+    {
+        Address address;
+        Result result;
+    };
+
+    /// One entry per group member, in the order of the members.
+    std::vector<Member> members;
+
+    /// true if the packet was sent as one broadcast frame.
+    bool broadcast = false;
+
+    inline size_t getSuccessCount() const
+    {
+        size_t count = 0;
+        for(const Member & member : members)
+        {
+            count += member.result.isGood() ? 1 : 0;
+        }
+        return count;
+    }
+
+    /// true if the packet reached all members.
+    inline bool isGood() const
+    {
+        return getSuccessCount() == members.size();
+    }
+};
+
+/// Set of remote addresses a packet can be sent to with one call.
+/// Compared to one Connection::send() per member, the payload is stored once
+/// and all transmissions are queued at once with a single result.
+/// Must not outlive the Bus, sends must complete before the Bus is destroyed
+/// (destroying the group waits for running broadcasts).
+template<class Strategy>
+class MulticastGroup
+{
+    public:
+        MulticastGroup(
+                Bus<Strategy> & f_bus,
+                std::vector<Address> f_members,
+                MulticastConfig f_config = MulticastConfig{}
+                );
+
+        /// Blocks until running broadcasts (see send()) are done, so they
+        /// do not use the Bus afterwards.
+        ~MulticastGroup();
+
+        /// Sends f_payload to all members.
+        /// Thread safe. With OverflowPolicy::Block of the bus, waits for tx
+        /// queue space as Connection::send() does.
+        /// @param f_timeout_milliseconds, f_enableRetransmit apply to each
+        ///          member, see Connection::send(). Not used for broadcasts,
+        ///          which are not retransmitted.
+        /// @returns future of the per-member results. Does not block when
+        ///          destroyed. A broadcast (see isBroadcastCollapsed()) is
+        ///          run by a thread of the group and takes up to
+        ///          ackTimeoutMilliseconds plus the unicast fallback.
+        std::future<MulticastResult> send(
+                std::vector<uint8_t> && f_payload,
+                uint32_t f_timeout_milliseconds = 1000,
+                bool f_enableRetransmit = true
+                );
+
+        inline const std::vector<Address> & getMembers() const
+        {
+            return m_setup->members;
+        }
+
+        /// @returns true if send() sends one broadcast frame, see
+        ///          MulticastConfig::membersCoverBus.
+        inline bool isBroadcastCollapsed() const
+        {
+            return m_setup->broadcastCollapsed;
+        }
+
+    private:
+        // immutable, shared with running broadcasts:
+        struct Setup
+        {
+            std::vector<Address> members;
+            MulticastConfig config;
+            bool broadcastCollapsed;
+            // member index by device (busId and id, see deviceKey()):
+            std::unordered_map<uint64_t, size_t> memberIndex;
+        };
+
+        // state of one send(), shared by the transmissions to the members:
+        struct Transmission
+        {
+            std::vector<uint8_t> payload;
+            MulticastResult result;
+            // only accessed with the tx queue of the bus locked:
+            size_t pending = 0;
+            std::promise<MulticastResult> promise;
+        };
+
+        /// Queues one transmission per member in f_memberIndices.
+        static std::future<MulticastResult> sendUnicast(
+                Bus<Strategy> & f_bus,
+                const Setup & f_setup,
+                std::shared_ptr<Transmission> f_transmission,
+                const std::vector<size_t> & f_memberIndices,
+                uint32_t f_timeout_milliseconds,
+                bool f_enableRetransmit
+                );
+
+        /// Queues one transmission per member in f_memberIndices, each
+        /// already holding a tx queue credit.
+        static void enqueueMembers(
+                Bus<Strategy> & f_bus,
+                const Setup & f_setup,
+                const std::shared_ptr<Transmission> & f_transmission,
+                const std::vector<size_t> & f_memberIndices,
+                uint32_t f_timeout_milliseconds,
+                bool f_enableRetransmit
+                );
+
+        /// Sets the result of a member and the promise once all are known.
+        /// Only to be called with the tx queue of the bus locked.
+        static void completeMember(Transmission & f_transmission, size_t f_index, Result && f_result);
+
+        /// Broadcasts f_payload and collects the acknowledgements.
+        /// Blocks until done.
+        static MulticastResult sendBroadcast(
+                Bus<Strategy> & f_bus,
+                std::shared_ptr<const Setup> f_setup,
+                std::vector<uint8_t> && f_payload,
+                uint32_t f_timeout_milliseconds,
+                bool f_enableRetransmit
+                );
+
+        static std::shared_ptr<Transmission> createTransmission(const Setup & f_setup, std::vector<uint8_t> && f_payload);
+
+        /// Address without port, members are identified by device.
+        static inline uint64_t deviceKey(const Address & f_address)
+        {
+            return f_address.toKey() & ~uint64_t(0xffff);
+        }
+
+        Bus<Strategy> & m_bus;
+        std::shared_ptr<const Setup> m_setup;
+
+        // threads of running broadcasts, joined when destroyed (finished
+        // ones are removed on the next send()):
+        std::mutex m_broadcastsMutex;
+        std::vector<std::future<void>> m_broadcasts;
+};
+
+}
+
+#include "MulticastGroup.inl"
@@ -0,0 +1,276 @@
+// Copyright 2021 Rainer Schoenberger
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+namespace PjonHL
+{
+template<class Strategy>
+MulticastGroup<Strategy>::MulticastGroup(Bus<Strategy> & f_bus, std::vector<Address> f_members, MulticastConfig f_config) :
+    m_bus(f_bus)
+{
+    auto setup = std::make_shared<Setup>();
+    setup->members = std::move(f_members);
+    setup->config = std::move(f_config);
+
+    // a broadcast reaches all members only if they share bus and port:
+    setup->broadcastCollapsed = setup->config.membersCoverBus and not setup->members.empty();
+    for(size_t i = 0; i < setup->members.size(); i++)
+    {
+        const Address & member = setup->members[i];
+        setup->memberIndex[deviceKey(member)] = i;
+        if(member.busId != setup->members[0].busId or member.port != setup->members[0].port)
+        {
+            setup->broadcastCollapsed = false;
+        }
+    }
+    m_setup = std::move(setup);
+}
+
+template<class Strategy>
+MulticastGroup<Strategy>::~MulticastGroup()
+{
+    std::lock_guard<std::mutex> guard(m_broadcastsMutex);
+    for(auto & broadcast : m_broadcasts)
+    {
+        broadcast.wait();
+    }
+}
+
+template<class Strategy>
+std::future<MulticastResult> MulticastGroup<Strategy>::send(std::vector<uint8_t> && f_payload, uint32_t f_timeout_milliseconds, bool f_enableRetransmit)
+{
+    if(m_setup->broadcastCollapsed)
+    {
+        // the future of std::async() would block the caller when destroyed,
+        // so the group keeps it and the caller gets the one of a promise:
+        auto promise = std::make_shared<std::promise<MulticastResult>>();
+        auto future = promise->get_future();
+        std::lock_guard<std::mutex> guard(m_broadcastsMutex);
+        m_broadcasts.erase(
+                std::remove_if(
+                    m_broadcasts.begin(),
+                    m_broadcasts.end(),
+                    [](const std::future<void> & f_broadcast){ return f_broadcast.wait_for(std::chrono::seconds(0)) == std::future_status::ready; }
+                    ),
+                m_broadcasts.end()
+                );
+        m_broadcasts.push_back(std::async(
+                std::launch::async,
+                [promise, &bus = m_bus, setup = m_setup, payload = std::move(f_payload), f_timeout_milliseconds, f_enableRetransmit]() mutable
+                {
+                    try
+                    {
+                        promise->set_value(sendBroadcast(bus, std::move(setup), std::move(payload), f_timeout_milliseconds, f_enableRetransmit));
+                    }
+                    catch(...)
+                    {
+                        promise->set_exception(std::current_exception());
+                    }
+                }
+                ));
+        return future;
+    }
+
+    std::vector<size_t> memberIndices(m_setup->members.size());
+    for(size_t i = 0; i < memberIndices.size(); i++)
+    {
+        memberIndices[i] = i;
+    }
+    return sendUnicast(m_bus, *m_setup, createTransmission(*m_setup, std::move(f_payload)), memberIndices, f_timeout_milliseconds, f_enableRetransmit);
+}
+
+template<class Strategy>
+std::shared_ptr<typename MulticastGroup<Strategy>::Transmission> MulticastGroup<Strategy>::createTransmission(const Setup & f_setup, std::vector<uint8_t> && f_payload)
+{
+    auto transmission = std::make_shared<Transmission>();
+    transmission->payload = std::move(f_payload);
+    transmission->result.members.reserve(f_setup.members.size());
+    for(const Address & member : f_setup.members)
+    {
+        transmission->result.members.push_back(MulticastResult::Member{member, Result(false)});
+    }
+    return transmission;
+}
+
+template<class Strategy>
+std::future<MulticastResult> MulticastGroup<Strategy>::sendUnicast(
+        Bus<Strategy> & f_bus,
+        const Setup & f_setup,
+        std::shared_ptr<Transmission> f_transmission,
+        const std::vector<size_t> & f_memberIndices,
+        uint32_t f_timeout_milliseconds,
+        bool f_enableRetransmit)
+{
+    auto future = f_transmission->promise.get_future();
+    if(f_memberIndices.empty())
+    {
+        f_transmission->promise.set_value(std::move(f_transmission->result));
+        return future;
+    }
+
+    {
+        // set first, so no completion can set the promise before all
+        // members are queued:
+        std::lock_guard<std::recursive_mutex> guard(f_bus.m_txQueueMutex);
+        f_transmission->pending = f_memberIndices.size();
+    }
+
+    // members are queued at once as far as the tx queue has space, so their
+    // transmissions are not interleaved with other packets. Credits are
+    // taken before locking the queue, as the event-loop needs it to free
+    // space. Once full, the members taken so far are queued and the next
+    // credit is waited for according to the overflow policy:
+    std::vector<size_t> batch;
+    batch.reserve(f_memberIndices.size());
+    for(size_t index : f_memberIndices)
+    {
+        if(not f_bus.tryAcquireTxCredit(nullptr))
+        {
+            enqueueMembers(f_bus, f_setup, f_transmission, batch, f_timeout_milliseconds, f_enableRetransmit);
+            batch.clear();
+            if(not f_bus.acquireTxCredit(nullptr))
+            {
+                std::lock_guard<std::recursive_mutex> guard(f_bus.m_txQueueMutex);
+                completeMember(*f_transmission, index, Result::createTxQueueFullResult());
+                continue;
+            }
+        }
+        batch.push_back(index);
+    }
+    enqueueMembers(f_bus, f_setup, f_transmission, batch, f_timeout_milliseconds, f_enableRetransmit);
+    return future;
+}
+
+template<class Strategy>
+void MulticastGroup<Strategy>::enqueueMembers(
+        Bus<Strategy> & f_bus,
+        const Setup & f_setup,
+        const std::shared_ptr<Transmission> & f_transmission,
+        const std::vector<size_t> & f_memberIndices,
+        uint32_t f_timeout_milliseconds,
+        bool f_enableRetransmit)
+{
+    std::lock_guard<std::recursive_mutex> guard(f_bus.m_txQueueMutex);
+    for(size_t index : f_memberIndices)
+    {
+        const Address & member = f_setup.members[index];
+        Address localAddress = f_bus.m_localAddress;
+        localAddress.port = member.port;
+
+        auto request = f_bus.createTxRequest(localAddress, member, std::vector<uint8_t>(), f_timeout_milliseconds, f_enableRetransmit);
+        // all requests share the payload of the transmission:
+        request.m_payloadSegments = {f_transmission->payload};
+        request.m_completionHandler = [f_transmission, index](Result f_result)
+            {
+                completeMember(*f_transmission, index, std::move(f_result));
+            };
+        f_bus.enqueueTxRequest(std::move(request));
+    }
+}
+
+template<class Strategy>
+void MulticastGroup<Strategy>::completeMember(Transmission & f_transmission, size_t f_index, Result && f_result)
+{
+    f_transmission.result.members[f_index].result = std::move(f_result);
+    f_transmission.pending--;
+    if(f_transmission.pending == 0)
+    {
+        f_transmission.promise.set_value(std::move(f_transmission.result));
+    }
+}
+
+template<class Strategy>
+MulticastResult MulticastGroup<Strategy>::sendBroadcast(
+        Bus<Strategy> & f_bus,
+        std::shared_ptr<const Setup> f_setup,
+        std::vector<uint8_t> && f_payload,
+        uint32_t f_timeout_milliseconds,
+        bool f_enableRetransmit)
+{
+    auto transmission = createTransmission(*f_setup, std::move(f_payload));
+
+    Address broadcastAddress = f_setup->members[0];
+    broadcastAddress.id = PJON_BROADCAST;
+    Address localAddress = f_bus.m_localAddress;
+    localAddress.port = broadcastAddress.port;
+
+    // listen before sending, so no acknowledgement is missed. Accepts any
+    // device of the bus, members are looked up below:
+    Address remoteMask = Address::createAllOneAddress();
+    remoteMask.id = 0;
+    remoteMask.port = 0;
+    Address localMask = Address::createAllOneAddress();
+    localMask.port = 0;
+    auto ackConnection = f_bus.createDetachedConnection(broadcastAddress, f_bus.m_localAddress, remoteMask, localMask);
+
+    Result broadcastResult = f_bus.send(localAddress, broadcastAddress, transmission->payload, f_timeout_milliseconds, false).get();
+
+    std::vector<bool> acknowledged(f_setup->members.size(), false);
+    size_t acknowledgedCount = 0;
+    if(broadcastResult.isGood())
+    {
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(f_setup->config.ackTimeoutMilliseconds);
+        while(acknowledgedCount < acknowledged.size())
+        {
+            auto now = std::chrono::steady_clock::now();
+            if(now >= deadline)
+            {
+                break;
+            }
+            auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - now).count() + 1;
+            auto packet = ackConnection->receive(static_cast<uint32_t>(remaining));
+            if(not packet.isValid())
+            {
+                continue;
+            }
+            auto member = f_setup->memberIndex.find(deviceKey(packet.unwrap().remoteAddress));
+            if(member == f_setup->memberIndex.end() or acknowledged[member->second])
+            {
+                continue;
+            }
+            if(f_setup->config.isAcknowledgement and not f_setup->config.isAcknowledgement(packet.unwrap()))
+            {
+                continue;
+            }
+            acknowledged[member->second] = true;
+            acknowledgedCount++;
+            transmission->result.members[member->second].result = broadcastResult;
+        }
+    }
+    ackConnection.reset();
+
+    std::vector<size_t> missing;
+    for(size_t i = 0; i < acknowledged.size(); i++)
+    {
+        if(not acknowledged[i])
+        {
+            missing.push_back(i);
+        }
+    }
+
+    if(f_setup->config.unicastFallback)
+    {
+        auto fallback = sendUnicast(f_bus, *f_setup, transmission, missing, f_timeout_milliseconds, f_enableRetransmit).get();
+        fallback.broadcast = true;
+        return fallback;
+    }
+
+    Result failure = broadcastResult.isGood() ? Result("No acknowledgement of broadcast") : broadcastResult;
+    for(size_t index : missing)
+    {
+        transmission->result.members[index].result = failure;
+    }
+    transmission->result.broadcast = true;
+    return std::move(transmission->result);
+}
+}
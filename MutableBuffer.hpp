@@ -0,0 +1,104 @@
+// Copyright 2021 Rainer Schoenberger
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <inttypes.h>
+#include <type_traits>
+#include <vector>
+#if __cplusplus >= 202002L && __has_include(<span>)
+#include <span>
+#endif
+
+namespace PjonHL
+{
+
+/// Non-owning view of writable, contiguous bytes, counterpart of
+/// ConstBuffer (std::span<uint8_t> is not available in C++17).
+/// The viewed memory has to outlive the MutableBuffer.
+class MutableBuffer
+{
+    public:
+        constexpr MutableBuffer() = default;
+
+        /// Views f_size bytes starting at f_data.
+        template<class Byte, class = std::enable_if_t<sizeof(Byte) == 1 and not std::is_const<Byte>::value>>
+        constexpr MutableBuffer(Byte * f_data, size_t f_size) :
+            m_data(reinterpret_cast<uint8_t *>(f_data)),
+            m_size(f_size)
+        {
+        }
+
+        /// Views the current size (not capacity) of f_vector.
+        inline MutableBuffer(std::vector<uint8_t> & f_vector) :
+            m_data(f_vector.data()),
+            m_size(f_vector.size())
+        {
+        }
+
+        template<size_t N>
+        constexpr MutableBuffer(std::array<uint8_t, N> & f_array) :
+            m_data(f_array.data()),
+            m_size(N)
+        {
+        }
+
+        template<size_t N>
+        constexpr MutableBuffer(uint8_t (&f_array)[N]) :
+            m_data(f_array),
+            m_size(N)
+        {
+        }
+
+#if __cplusplus >= 202002L && __has_include(<span>)
+        constexpr MutableBuffer(std::span<uint8_t> f_span) :
+            m_data(f_span.data()),
+            m_size(f_span.size())
+        {
+        }
+#endif
+
+        constexpr uint8_t * data() const
+        {
+            return m_data;
+        }
+
+        constexpr size_t size() const
+        {
+            return m_size;
+        }
+
+        constexpr bool empty() const
+        {
+            return m_size == 0;
+        }
+
+        constexpr uint8_t * begin() const
+        {
+            return m_data;
+        }
+
+        constexpr uint8_t * end() const
+        {
+            return m_data + m_size;
+        }
+
+    private:
+        uint8_t * m_data = nullptr;
+        size_t m_size = 0;
+};
+
+}
@@ -15,23 +15,40 @@
 #pragma once
 
 #include <chrono>
+#include <condition_variable>
 #include <inttypes.h>
 #include <memory>
 #include <mutex>
+#include <shared_mutex>
+#include <optional>
 #include <string>
 #include <thread>
 #include <future>
 #include <vector>
 #include <queue>
+#include <unordered_map>
 #include <list>
 #include <iostream>
 #include <functional>
 #include <cstdlib>
+#include <type_traits>
+#include <algorithm>
+#include <utility>
+#include <iterator>
 
+#include "CancelToken.hpp"
 #include "Expect.hpp"
 #include "Address.hpp"
 #include "Connection.hpp"
 #include "BusConfig.hpp"
+#include "Logger.hpp"
+#include "RetransmitPolicy.hpp"
+#include "LatencyHistogram.hpp"
+#include "Metrics.hpp"
+#include "AddressMatchTable.hpp"
+#include "PortDispatcher.hpp"
+#include "TrafficCapture.hpp"
+#include "ThreadSetup.hpp"
 
 #include "PJONDefines.h"
 
@@ -51,27 +68,41 @@ std::string PjonErrorToString(uint8_t f_errorCode, uint8_t f_data);
 template<class Strategy>
 class Connection;
 
-class Logger
+template<class Strategy>
+class MulticastGroup;
+
+/// Optional extension of the PJON strategy interface:
+/// Strategies which know when the first byte of the last received frame
+/// arrived (e.g. buffering serial strategies) may provide
+///   std::chrono::steady_clock::time_point getLastFrameStartTime();
+/// which Bus uses as ReceivedPacket::frameStartTime.
+template<class Strategy, class = void>
+struct HasFrameStartTime : std::false_type
 {
-    public:
-        enum LogLevel
-        {
-            Debug,
-            Info,
-            Error
-        };
-
-        virtual void log(LogLevel f_level, std::string f_message) = 0;
 };
 
-class DefaultLogger : public Logger
+template<class Strategy>
+struct HasFrameStartTime<Strategy, std::void_t<decltype(std::declval<Strategy &>().getLastFrameStartTime())>> : std::true_type
 {
-    public:
+};
 
-        virtual inline void log(LogLevel f_level, std::string f_message) override
-        {
-            std::cout << "PjonHl: " << f_message << std::endl;
-        }
+/// Options of Bus::pause().
+struct PauseOptions
+{
+    enum class QueuedRx
+    {
+        /// Packets already queued in connections can still be received.
+        Hold,
+        /// Packets already queued in connections are dropped.
+        Drop
+    };
+
+    /// Wait until the packet currently in transmission (handed to PJON) got
+    /// ACKed or failed before pausing. Otherwise PJON continues transmitting
+    /// it after resume(). Queued packets are never started while pausing.
+    bool finishInFlightTx = false;
+
+    QueuedRx queuedRx = QueuedRx::Hold;
 };
 
 template<class Strategy>
@@ -135,16 +166,39 @@ class Bus
                 Address f_localMask = Address::createAllOneAddress()
                 );
 
+        /// Registers f_handler for all packets sent to the local address of
+        /// this bus (passed in the constructor) with port f_port, e.g. one
+        /// port per service of a device.
+        /// Such packets are routed through a table indexed by port in
+        /// constant time, however many ports are registered, and are not
+        /// passed to connections. Other packets (other ports, other local
+        /// addresses, broadcasts) are matched against the connections.
+        /// An empty f_handler removes the handler of f_port.
+        /// Thread safe. f_handler is called from the event-loop thread and
+        /// must not create or destroy connections or set port handlers.
+        void setPortHandler(uint16_t f_port, PortDispatcher::Handler f_handler);
+
         /// Stops processing PJON traffic on this Bus.
         /// This can be used to prevent any trafic on the bus.
         /// NOTE: This might cause packet loss.
         /// E.g. - Sensitive devices, which need silence on the bus to prevent noise.
         ///      - Bus shared with other protocols
-        void pause();
+        /// The event-loop thread is parked (not stopped), so pausing and
+        /// resuming is cheap and can be done frequently.
+        /// Blocks until the event-loop is parked, i.e. the bus is silent.
+        /// Called from the event-loop thread (e.g. from a completion handler,
+        /// port handler or onTxCredit() callback), it only requests the pause
+        /// and returns without waiting, the event-loop then parks once the
+        /// handler returns.
+        /// Frames arriving while paused are buffered by the strategy (if it
+        /// does) and processed after resume().
+        void pause(PauseOptions f_options = PauseOptions{});
 
         /// Resumes processing PJON traffic on this Bus.
         void resume();
 
+        bool isPaused() const;
+
         /// Sends a packet without a connection. Should not be used in normal
         /// operation.
         /// Prefer using connections for sending/receiving instead of this
@@ -152,9 +206,10 @@ class Bus
         std::future<Result> send(
                 Address f_localAddress,
                 Address f_remoteAddress,
-                const std::vector<uint8_t> & f_payload,
+                std::vector<uint8_t> f_payload,
                 uint32_t f_timeout_milliseconds,
-                bool f_enableRetransmit = true
+                bool f_enableRetransmit = true,
+                CancelToken f_cancelToken = CancelToken()
                 );
 
         inline Logger & getLogger()
@@ -162,19 +217,162 @@ class Bus
             return *m_logger;
         }
 
+        /// Returns latency histograms of all TX and RX stages, aggregated over
+        /// all connections of this bus.
+        /// Thread safe and never blocks the event-loop.
+        inline LatencyStatistics::Snapshot getLatencyStatistics() const
+        {
+            return m_latency.snapshot();
+        }
+
+        /// Returns traffic, error, queue and event-loop counters of this bus.
+        /// Thread safe and never blocks the event-loop.
+        inline BusMetrics::Snapshot getMetrics() const
+        {
+            return m_metrics.snapshot();
+        }
+
+        /// Starts recording every dispatched (including retransmissions) and
+        /// received packet into the given capture. Replaces a previously set
+        /// capture, nullptr stops capturing.
+        /// Thread safe. The bus keeps a reference to the capture until it is
+        /// replaced and the current packet is recorded.
+        inline void setTrafficCapture(std::shared_ptr<TrafficCapture> f_capture)
+        {
+            std::atomic_store(&m_capture, std::move(f_capture));
+        }
+
     private:
         struct TxRequest
         {
-            std::promise<Result> m_successPromise;
+            // if set, called instead of fulfilling m_successPromise (which
+            // is then not created, as that allocates):
+            SendCompletionHandler m_completionHandler;
+            std::optional<std::promise<Result>> m_successPromise;
+            // owned payload, empty if the caller owns the payload:
             std::vector<uint8_t> m_payload;
+            // what is actually sent, views m_payload or the caller's
+            // buffer(s) (a moved vector keeps its buffer, so moving the
+            // request is ok):
+            ConstBufferList m_payloadSegments;
+            CancelToken m_cancelToken;
+            // set once withdrawn through m_cancelToken: already completed,
+            // only left in the queue until it reaches the head:
+            bool m_cancelled = false;
+            // set for requests of Connection::sendLatest(), identifies their
+            // stream (remote address key, stream id in the upper byte):
+            std::optional<uint64_t> m_conflationKey;
             Address m_localAddress;
             Address m_remoteAddress;
             uint32_t m_timeoutMilliseconds;
             bool m_retransmitEnabled;
             size_t m_pjonPacketBufferIndex;
             bool m_dispatched = false;
+
+            // retransmission state:
+            uint8_t m_attempts = 0;
+            uint8_t m_maxAttempts = 1;
+            std::chrono::steady_clock::time_point m_deadline;
+            std::chrono::steady_clock::time_point m_notBefore;
+            std::chrono::steady_clock::time_point m_dispatchTime;
+
+            // latency tracking:
+            std::chrono::steady_clock::time_point m_enqueueTime;
+            std::chrono::steady_clock::time_point m_firstDispatchTime;
+            std::shared_ptr<LatencyStatistics> m_connectionLatency;
+            std::shared_ptr<ConnectionMetrics> m_connectionMetrics;
         };
 
+        TxRequest createTxRequest(
+                Address f_localAddress,
+                Address f_remoteAddress,
+                std::vector<uint8_t> && f_payload,
+                uint32_t f_timeout_milliseconds,
+                bool f_enableRetransmit
+                );
+
+        /// Takes a place in the tx queue (see BusConfig::TxQueueConfig), to
+        /// be done before enqueueTxRequest().
+        /// Waits for space according to the overflow policy, so the caller
+        /// must not hold m_txQueueMutex.
+        /// @param f_connectionMetrics of the sending connection, nullptr if
+        ///          sent without connection.
+        /// @returns false if the queue is full.
+        bool acquireTxCredit(ConnectionMetrics * f_connectionMetrics);
+
+        /// As acquireTxCredit(), but never waits and does not count a
+        /// rejection (the caller decides what to do if the queue is full).
+        bool tryAcquireTxCredit(ConnectionMetrics * f_connectionMetrics);
+
+        /// Only to be called with m_txCreditMutex locked and if
+        /// hasTxCredit().
+        void takeTxCredit(ConnectionMetrics * f_connectionMetrics);
+
+        /// Gives back the place of a completed request.
+        /// @returns callbacks of onTxCredit() which can be called now.
+        std::vector<std::function<void()>> releaseTxCredit(ConnectionMetrics * f_connectionMetrics);
+
+        /// Only to be called with m_txCreditMutex locked.
+        bool hasTxCredit(const ConnectionMetrics * f_connectionMetrics) const;
+
+        /// Removes the waiters of onTxCredit() which now have space.
+        /// Only to be called with m_txCreditMutex locked.
+        /// @returns their callbacks.
+        std::vector<std::function<void()>> takeReadyTxCreditWaiters();
+
+        /// Registers a callback of Connection::onTxCredit().
+        /// @returns false (and does not register it) if there already is
+        ///          space for the connection.
+        bool addTxCreditWaiter(const ConnectionMetrics * f_connectionMetrics, std::function<void()> f_callback);
+
+        /// @returns future of the result, invalid if the request has a
+        ///          completion handler or already has a promise.
+        std::future<Result> enqueueTxRequest(TxRequest && f_request);
+
+        /// Replaces the queued, not yet dispatched request of the stream of
+        /// f_request (see Connection::sendLatest()) by f_request.
+        /// f_request has to have a promise, no completion handler.
+        /// If the queued request is of another connection, its credit is
+        /// moved to the connection of f_request.
+        /// @param f_creditCallbacks receives callbacks of onTxCredit() of the
+        ///          connection giving up its credit, to be called without
+        ///          any lock held.
+        /// @returns false if there is no such request or the connection of
+        ///          f_request has no space, f_request is then unchanged and
+        ///          has to be enqueued.
+        bool conflateTxRequest(TxRequest & f_request, std::vector<std::function<void()>> & f_creditCallbacks);
+
+        /// Removes f_request from m_conflatableTxRequests, as it can no
+        /// longer be replaced.
+        /// Only to be called with m_txQueueMutex locked.
+        void forgetConflatableTxRequest(TxRequest & f_request);
+
+        /// Records the completion of f_request in the statistics, removes it
+        /// from the indices, gives back its place in the queue and stamps
+        /// f_result with its timing.
+        /// Only to be called with m_txQueueMutex locked.
+        /// @returns callbacks of onTxCredit() which can be called once
+        ///          f_request is completed.
+        std::vector<std::function<void()>> finishTxRequest(TxRequest & f_request, Result & f_result, std::chrono::steady_clock::time_point f_completionTime);
+
+        /// Sets the result of the request at the front of the tx queue (or
+        /// calls its completion handler) and pops it.
+        /// Only to be called with m_txQueueMutex locked.
+        /// @param f_completionTime time PJON reported success/failure
+        void completeFrontTxRequest(Result && f_result, std::chrono::steady_clock::time_point f_completionTime);
+
+        /// Completes the queued, not dispatched requests of the cancelled
+        /// token f_tokenId and leaves them as tombstones in the queue.
+        /// @returns completion handlers and onTxCredit() callbacks, to be
+        ///          called without any lock held.
+        std::vector<std::function<void()>> cancelTxRequests(const void * f_tokenId);
+
+        /// @returns listener to be added to f_cancelToken once a request of
+        ///          it is queued, nullptr if it can not be cancelled.
+        std::shared_ptr<CancelToken::Listener> getTxCancelListener(const CancelToken & f_cancelToken) const;
+
+        void recordLatency(LatencyStatistics::Stage f_stage, std::chrono::steady_clock::duration f_duration, LatencyStatistics * f_connectionLatency);
+
         void pjonErrorHandler(uint8_t code, uint16_t data, void *custom_pointer);
 
         void pjonReceiveFunction(
@@ -185,10 +383,69 @@ class Bus
 
         void pjonEventLoop();
 
+        /// Blocks the event-loop thread while paused.
+        void parkEventLoop();
+
+        /// Drops the packets queued in all connections.
+        void dropQueuedRx();
+
+        /// @returns true if the front request of the tx queue was handed to
+        ///          PJON and is not yet completed.
+        bool isTxInFlight();
+
+        /// Rebuilds m_connectionTable from m_connections.
+        /// Only to be called with m_connections_mutex locked.
+        void rebuildConnectionTable();
+
         void dispatchTxRequest(TxRequest & f_request);
 
+        /// Decides if a failed request shall be retransmitted and if so
+        /// schedules it for re-dispatch.
+        /// @returns true if retransmission was scheduled, false if request
+        ///          failed for good.
+        bool scheduleRetransmit(TxRequest & f_request, uint8_t f_errorCode);
+
         std::recursive_mutex m_txQueueMutex;
         std::queue< TxRequest > m_txQueue;
+        // not yet dispatched requests of Connection::sendLatest() by
+        // conflation key (guarded by m_txQueueMutex, elements of a deque
+        // based queue do not move when pushing or popping others):
+        std::unordered_map<uint64_t, TxRequest *> m_conflatableTxRequests;
+        // queued requests which can be cancelled, by id of their token
+        // (guarded by m_txQueueMutex):
+        std::unordered_multimap<const void *, TxRequest *> m_cancellableTxRequests;
+
+        /// Forwards CancelToken::cancel() to the bus. Tokens only keep a weak
+        /// reference, the bus is detached when destroyed.
+        class TxCancelListener final : public CancelToken::Listener
+        {
+            public:
+                explicit TxCancelListener(Bus & f_bus) : m_bus(&f_bus) {}
+
+                void onCancel(const void * f_tokenId) override;
+
+                void detach();
+
+            private:
+                // shared while cancelling, so completion handlers may
+                // cancel other tokens:
+                std::shared_mutex m_busMutex;
+                Bus * m_bus;
+        };
+        const std::shared_ptr<TxCancelListener> m_txCancelListener = std::make_shared<TxCancelListener>(*this);
+
+        struct TxCreditWaiter
+        {
+            const ConnectionMetrics * m_connectionMetrics;
+            std::function<void()> m_callback;
+        };
+
+        const BusConfig::TxQueueConfig m_txQueueConfig;
+        // guards changes of the txQueueDepth gauges, so checking and taking
+        // a place in the queue is atomic:
+        std::mutex m_txCreditMutex;
+        std::condition_variable m_txCreditCondition;
+        std::vector<TxCreditWaiter> m_txCreditWaiters;
 
         Address m_localAddress;
         PJON<Strategy> m_pjon;
@@ -196,13 +453,52 @@ class Bus
         std::mutex m_connections_mutex;
         std::list<Connection<Strategy>*> m_connections;
 
+        // handlers by local port, looked up before the connections (guarded
+        // by m_connections_mutex):
+        PortDispatcher m_portDispatcher;
+
+        // address filters of m_connections (same order), used to find
+        // connections interested in a received packet:
+        AddressMatchTable m_connectionTable;
+        std::vector<Connection<Strategy>*> m_connectionTableEntries;
+        // only accessed from event-loop thread, reused to avoid allocations:
+        std::vector<uint32_t> m_rxMatches;
+        // only accessed from event-loop thread, payloads of multiple
+        // segments are gathered here before handing them to PJON:
+        std::vector<uint8_t> m_txGatherBuffer;
+
+        const BusConfig::ThreadConfig m_threadConfig;
         std::thread m_eventLoopThread;
 
         std::atomic<bool> m_eventLoopRunning = true;
 
+        // pause gate of the event-loop:
+        mutable std::mutex m_pauseMutex;
+        std::condition_variable m_pauseCondition;
+        std::atomic<bool> m_pauseRequested{false};
+        std::atomic<bool> m_pauseFinishInFlightTx{false};
+        // only accessed with m_pauseMutex locked:
+        bool m_eventLoopParked = false;
+        // set by pause() from the event-loop thread, which can not drop
+        // itself (handlers may hold m_connections_mutex), only accessed with
+        // m_pauseMutex locked:
+        bool m_pauseDropQueuedRx = false;
+
         std::atomic<std::chrono::steady_clock::time_point> m_lastRxTxActivity{std::chrono::steady_clock::now()};
 
+        // only accessed from event-loop thread:
+        RetransmitPolicy m_retransmitPolicy;
+
+        LatencyStatistics m_latency;
+        BusMetrics m_metrics;
+
+        // only accessed via std::atomic_load/store:
+        std::shared_ptr<TrafficCapture> m_capture;
+
         std::unique_ptr<Logger> m_logger;
+
+        friend Connection<Strategy>;
+        friend MulticastGroup<Strategy>;
 };
 }
 
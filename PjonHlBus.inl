@@ -56,10 +56,34 @@ Bus<Strategy>::~Bus()
     }
     }
 
-    if(m_eventLoopRunning)
     {
+        std::lock_guard<std::mutex> guard(m_pauseMutex);
         m_eventLoopRunning = false;
-        m_eventLoopThread.join();
+        m_pauseCondition.notify_all();
+    }
+    m_eventLoopThread.join();
+
+    // tokens cancelled from now on do not reach the bus:
+    m_txCancelListener->detach();
+
+    {
+        std::lock_guard<std::mutex> guard(m_txCreditMutex);
+        m_txCreditWaiters.clear();
+    }
+
+    // fail what is left, so every completion handler is called exactly once
+    // (and futures do not end with a broken promise):
+    {
+        std::lock_guard<std::recursive_mutex> guard(m_txQueueMutex);
+        while(not m_txQueue.empty())
+        {
+            if(m_txQueue.front().m_cancelled)
+            {
+                m_txQueue.pop();
+                continue;
+            }
+            completeFrontTxRequest(Result("Bus destroyed before packet was sent"), std::chrono::steady_clock::now());
+        }
     }
 
     getErrorFunction() = std::function<void ( uint8_t code, uint16_t data, void *custom_pointer) >();
@@ -72,7 +96,10 @@ Bus<Strategy>::Bus(
         BusConfig f_config,
         std::unique_ptr<Logger> f_logger
         ) :
+    m_txQueueConfig(f_config.txQueue),
     m_pjon(f_localAddress.busId.data(), f_localAddress.id),
+    m_threadConfig(f_config.eventLoopThread),
+    m_retransmitPolicy(f_config.retransmit),
     m_logger(std::move(f_logger))
 {
     m_localAddress = f_localAddress;
@@ -123,23 +150,93 @@ Bus<Strategy>::Bus(
         };
     m_pjon.set_receiver(&globalReceiverFunction);
 
+    m_txGatherBuffer.reserve(PJON_PACKET_MAX_LENGTH);
+
     // start up pjon and our event loop thread:
     m_pjon.begin();
-    m_eventLoopThread = std::thread([this]{pjonEventLoop();});
+    m_eventLoopThread = std::thread([this]
+        {
+            setUpCurrentThread(m_threadConfig, *m_logger);
+            pjonEventLoop();
+        });
 }
 
 template<class Strategy>
-void Bus<Strategy>::pause()
+void Bus<Strategy>::pause(PauseOptions f_options)
 {
-    m_eventLoopRunning = false;
-    m_eventLoopThread.join();
+    std::unique_lock<std::mutex> lock(m_pauseMutex);
+    m_pauseFinishInFlightTx = f_options.finishInFlightTx;
+    m_pauseRequested = true;
+    // the event-loop would wait for itself, it parks once the calling
+    // handler returns:
+    if(std::this_thread::get_id() == m_eventLoopThread.get_id())
+    {
+        m_pauseDropQueuedRx = f_options.queuedRx == PauseOptions::QueuedRx::Drop;
+        return;
+    }
+    // resume() called by other thread meanwhile also ends waiting:
+    m_pauseCondition.wait(lock, [this]{ return m_eventLoopParked or not m_pauseRequested; });
+    lock.unlock();
+
+    if(f_options.queuedRx == PauseOptions::QueuedRx::Drop)
+    {
+        dropQueuedRx();
+    }
 }
 
 template<class Strategy>
 void Bus<Strategy>::resume()
 {
-    m_eventLoopRunning = true;
-    m_eventLoopThread = std::thread([this]{pjonEventLoop();});
+    std::lock_guard<std::mutex> guard(m_pauseMutex);
+    m_pauseRequested = false;
+    m_pauseDropQueuedRx = false;
+    m_pauseCondition.notify_all();
+}
+
+template<class Strategy>
+void Bus<Strategy>::dropQueuedRx()
+{
+    std::lock_guard<std::mutex> guard(m_connections_mutex);
+    for(Connection<Strategy>* connection: m_connections)
+    {
+        connection->dropReceivedPackets();
+    }
+}
+
+template<class Strategy>
+bool Bus<Strategy>::isPaused() const
+{
+    std::lock_guard<std::mutex> guard(m_pauseMutex);
+    return m_pauseRequested and m_eventLoopParked;
+}
+
+template<class Strategy>
+void Bus<Strategy>::parkEventLoop()
+{
+    std::unique_lock<std::mutex> lock(m_pauseMutex);
+    if(m_pauseDropQueuedRx)
+    {
+        // before parking, so the bus only counts as paused once dropped:
+        m_pauseDropQueuedRx = false;
+        lock.unlock();
+        dropQueuedRx();
+        lock.lock();
+    }
+    m_eventLoopParked = true;
+    m_pauseCondition.notify_all();
+    m_pauseCondition.wait(lock, [this]{ return not m_pauseRequested or not m_eventLoopRunning; });
+    m_eventLoopParked = false;
+    lock.unlock();
+
+    // traffic is likely right after resuming, do not idle sleep:
+    m_lastRxTxActivity = std::chrono::steady_clock::now();
+}
+
+template<class Strategy>
+bool Bus<Strategy>::isTxInFlight()
+{
+    std::lock_guard<std::recursive_mutex> guard(m_txQueueMutex);
+    return m_txQueue.size() > 0 and m_txQueue.front().m_dispatched;
 }
 
 template<class Strategy>
@@ -160,16 +257,59 @@ typename Bus<Strategy>::ConnectionHandle Bus<Strategy>::createDetachedConnection
                         // (i.e. Bus is still alive)
                         std::lock_guard<std::mutex> guard(m_connections_mutex);
                         m_connections.remove(f_connection);
+                        rebuildConnectionTable();
+
+                        {
+                            std::lock_guard<std::mutex> creditGuard(m_txCreditMutex);
+                            auto metrics = f_connection->m_metrics.get();
+                            m_txCreditWaiters.erase(
+                                    std::remove_if(
+                                        m_txCreditWaiters.begin(),
+                                        m_txCreditWaiters.end(),
+                                        [metrics](const TxCreditWaiter & f_waiter){ return f_waiter.m_connectionMetrics == metrics; }
+                                        ),
+                                    m_txCreditWaiters.end()
+                                    );
+                        }
+
+                        // packets never received by user are no longer queued:
+                        std::lock_guard<std::mutex> rxQueueGuard(f_connection->m_rxQueueMutex);
+                        m_metrics.rxQueueDepth.decrease(f_connection->m_rxQueue.size());
                     }
                 }
                 delete f_connection;
             }
             );
     m_connections.push_back(connection.get());
+    rebuildConnectionTable();
 
     return connection;
 }
 
+template<class Strategy>
+void Bus<Strategy>::setPortHandler(uint16_t f_port, PortDispatcher::Handler f_handler)
+{
+    std::lock_guard<std::mutex> guard(m_connections_mutex);
+    m_portDispatcher.set(f_port, std::move(f_handler));
+}
+
+template<class Strategy>
+void Bus<Strategy>::rebuildConnectionTable()
+{
+    m_connectionTable.clear();
+    m_connectionTableEntries.clear();
+    for(Connection<Strategy>* connection : m_connections)
+    {
+        m_connectionTable.addKeys(
+                connection->m_maskedRemoteKey,
+                connection->m_remoteMaskKey,
+                connection->m_maskedLocalKey,
+                connection->m_localMaskKey
+                );
+        m_connectionTableEntries.push_back(connection);
+    }
+}
+
 template<class Strategy>
 typename Bus<Strategy>::ConnectionHandle Bus<Strategy>::createConnection(Address f_remoteAddress, Address f_remoteMask)
 {
@@ -181,33 +321,446 @@ typename Bus<Strategy>::ConnectionHandle Bus<Strategy>::createConnection(Address
 }
 
 template<class Strategy>
-std::future<Result> Bus<Strategy>::send(Address f_localAddress, Address f_remoteAddress, const std::vector<uint8_t> & f_payload, uint32_t f_timeout_milliseconds, bool f_enableRetransmit)
+std::future<Result> Bus<Strategy>::send(Address f_localAddress, Address f_remoteAddress, std::vector<uint8_t> f_payload, uint32_t f_timeout_milliseconds, bool f_enableRetransmit, CancelToken f_cancelToken)
+{
+    if(not acquireTxCredit(nullptr))
+    {
+        std::promise<Result> promise;
+        promise.set_value(Result::createTxQueueFullResult());
+        return promise.get_future();
+    }
+    auto request = createTxRequest(f_localAddress, f_remoteAddress, std::move(f_payload), f_timeout_milliseconds, f_enableRetransmit);
+    request.m_cancelToken = f_cancelToken;
+    auto future = enqueueTxRequest(std::move(request));
+    if(auto cancelListener = getTxCancelListener(f_cancelToken))
+    {
+        f_cancelToken.addListener(cancelListener);
+    }
+    return future;
+}
+
+template<class Strategy>
+typename Bus<Strategy>::TxRequest Bus<Strategy>::createTxRequest(Address f_localAddress, Address f_remoteAddress, std::vector<uint8_t> && f_payload, uint32_t f_timeout_milliseconds, bool f_enableRetransmit)
 {
     TxRequest request;
-    request.m_payload = f_payload;
+    request.m_payload = std::move(f_payload);
+    request.m_payloadSegments = {request.m_payload};
     request.m_localAddress = f_localAddress;
     request.m_remoteAddress = f_remoteAddress;
     request.m_timeoutMilliseconds = f_timeout_milliseconds;
     request.m_retransmitEnabled = f_enableRetransmit;
+    request.m_enqueueTime = std::chrono::steady_clock::now();
+    request.m_deadline = request.m_enqueueTime + std::chrono::milliseconds(f_timeout_milliseconds);
+    return request;
+}
+
+template<class Strategy>
+bool Bus<Strategy>::acquireTxCredit(ConnectionMetrics * f_connectionMetrics)
+{
+    std::unique_lock<std::mutex> lock(m_txCreditMutex);
+    if(not hasTxCredit(f_connectionMetrics))
+    {
+        // the event-loop thread would wait for itself:
+        if(
+            m_txQueueConfig.overflowPolicy == BusConfig::TxQueueConfig::OverflowPolicy::Block and
+            std::this_thread::get_id() != m_eventLoopThread.get_id()
+          )
+        {
+            m_metrics.txQueueWaits.add();
+            m_txCreditCondition.wait_for(
+                    lock,
+                    std::chrono::milliseconds(m_txQueueConfig.blockTimeoutMilliseconds),
+                    [this, f_connectionMetrics]{ return hasTxCredit(f_connectionMetrics); }
+                    );
+        }
+        if(not hasTxCredit(f_connectionMetrics))
+        {
+            m_metrics.txQueueRejects.add();
+            if(f_connectionMetrics != nullptr)
+            {
+                f_connectionMetrics->txQueueRejects.add();
+            }
+            return false;
+        }
+    }
+
+    takeTxCredit(f_connectionMetrics);
+    return true;
+}
+
+template<class Strategy>
+bool Bus<Strategy>::tryAcquireTxCredit(ConnectionMetrics * f_connectionMetrics)
+{
+    std::lock_guard<std::mutex> guard(m_txCreditMutex);
+    if(not hasTxCredit(f_connectionMetrics))
+    {
+        return false;
+    }
+    takeTxCredit(f_connectionMetrics);
+    return true;
+}
+
+template<class Strategy>
+void Bus<Strategy>::takeTxCredit(ConnectionMetrics * f_connectionMetrics)
+{
+    m_metrics.txQueueDepth.increase();
+    if(f_connectionMetrics != nullptr)
+    {
+        f_connectionMetrics->txQueueDepth.increase();
+    }
+}
+
+template<class Strategy>
+std::vector<std::function<void()>> Bus<Strategy>::releaseTxCredit(ConnectionMetrics * f_connectionMetrics)
+{
+    std::lock_guard<std::mutex> guard(m_txCreditMutex);
+    m_metrics.txQueueDepth.decrease();
+    if(f_connectionMetrics != nullptr)
+    {
+        f_connectionMetrics->txQueueDepth.decrease();
+    }
+    m_txCreditCondition.notify_all();
+    return takeReadyTxCreditWaiters();
+}
+
+template<class Strategy>
+std::vector<std::function<void()>> Bus<Strategy>::takeReadyTxCreditWaiters()
+{
+    std::vector<std::function<void()>> callbacks;
+    for(auto waiter = m_txCreditWaiters.begin(); waiter != m_txCreditWaiters.end();)
+    {
+        if(hasTxCredit(waiter->m_connectionMetrics))
+        {
+            callbacks.push_back(std::move(waiter->m_callback));
+            waiter = m_txCreditWaiters.erase(waiter);
+        }
+        else
+        {
+            waiter++;
+        }
+    }
+    return callbacks;
+}
+
+template<class Strategy>
+bool Bus<Strategy>::hasTxCredit(const ConnectionMetrics * f_connectionMetrics) const
+{
+    if(m_txQueueConfig.maxPackets != 0 and m_metrics.txQueueDepth.snapshot().current >= m_txQueueConfig.maxPackets)
+    {
+        return false;
+    }
+    if(
+        f_connectionMetrics != nullptr and
+        m_txQueueConfig.maxPacketsPerConnection != 0 and
+        f_connectionMetrics->txQueueDepth.snapshot().current >= m_txQueueConfig.maxPacketsPerConnection
+      )
+    {
+        return false;
+    }
+    return true;
+}
+
+template<class Strategy>
+bool Bus<Strategy>::addTxCreditWaiter(const ConnectionMetrics * f_connectionMetrics, std::function<void()> f_callback)
+{
+    std::lock_guard<std::mutex> guard(m_txCreditMutex);
+    if(hasTxCredit(f_connectionMetrics))
+    {
+        return false;
+    }
+    m_txCreditWaiters.push_back(TxCreditWaiter{f_connectionMetrics, std::move(f_callback)});
+    return true;
+}
 
-    auto future = request.m_successPromise.get_future();
+template<class Strategy>
+std::future<Result> Bus<Strategy>::enqueueTxRequest(TxRequest && f_request)
+{
+    std::future<Result> future;
+    if(not f_request.m_completionHandler and not f_request.m_successPromise)
+    {
+        future = f_request.m_successPromise.emplace().get_future();
+    }
     std::lock_guard<std::recursive_mutex> guard(m_txQueueMutex);
-    m_txQueue.push(std::move(request));
+    m_txQueue.push(std::move(f_request));
+    if(m_txQueue.back().m_conflationKey)
+    {
+        m_conflatableTxRequests[*m_txQueue.back().m_conflationKey] = &m_txQueue.back();
+    }
+    if(m_txQueue.back().m_cancelToken.getId() != nullptr)
+    {
+        m_cancellableTxRequests.emplace(m_txQueue.back().m_cancelToken.getId(), &m_txQueue.back());
+    }
 
     return future;
 }
 
+template<class Strategy>
+bool Bus<Strategy>::conflateTxRequest(TxRequest & f_request, std::vector<std::function<void()>> & f_creditCallbacks)
+{
+    std::lock_guard<std::recursive_mutex> guard(m_txQueueMutex);
+    auto queued = m_conflatableTxRequests.find(*f_request.m_conflationKey);
+    if(queued == m_conflatableTxRequests.end())
+    {
+        return false;
+    }
+    TxRequest & request = *queued->second;
+
+    // takes over the place in the queue (another connection to the same
+    // remote also takes over its credit, the total does not change):
+    ConnectionMetrics * previousMetrics = request.m_connectionMetrics.get();
+    ConnectionMetrics * metrics = f_request.m_connectionMetrics.get();
+    if(previousMetrics != metrics)
+    {
+        std::lock_guard<std::mutex> creditGuard(m_txCreditMutex);
+        if(
+            metrics != nullptr and
+            m_txQueueConfig.maxPacketsPerConnection != 0 and
+            metrics->txQueueDepth.snapshot().current >= m_txQueueConfig.maxPacketsPerConnection
+          )
+        {
+            return false;
+        }
+        if(metrics != nullptr)
+        {
+            metrics->txQueueDepth.increase();
+        }
+        if(previousMetrics != nullptr)
+        {
+            previousMetrics->txQueueDepth.decrease();
+        }
+        m_txCreditCondition.notify_all();
+        f_creditCallbacks = takeReadyTxCreditWaiters();
+    }
+
+    m_metrics.sendsSuperseded.add();
+    if(request.m_connectionMetrics)
+    {
+        request.m_connectionMetrics->sendsSuperseded.add();
+    }
+    Result superseded = Result::createSupersededResult();
+    superseded.m_enqueueTime = request.m_enqueueTime;
+    request.m_successPromise->set_value(std::move(superseded));
+    request = std::move(f_request);
+    return true;
+}
+
+template<class Strategy>
+void Bus<Strategy>::forgetConflatableTxRequest(TxRequest & f_request)
+{
+    if(not f_request.m_conflationKey)
+    {
+        return;
+    }
+    auto queued = m_conflatableTxRequests.find(*f_request.m_conflationKey);
+    // a concurrent sendLatest() may have enqueued a second request of the
+    // stream, which is then the one to replace:
+    if(queued != m_conflatableTxRequests.end() and queued->second == &f_request)
+    {
+        m_conflatableTxRequests.erase(queued);
+    }
+    f_request.m_conflationKey.reset();
+}
+
+template<class Strategy>
+std::vector<std::function<void()>> Bus<Strategy>::finishTxRequest(TxRequest & f_request, Result & f_result, std::chrono::steady_clock::time_point f_completionTime)
+{
+    forgetConflatableTxRequest(f_request);
+    if(f_request.m_cancelToken.getId() != nullptr)
+    {
+        auto cancellable = m_cancellableTxRequests.equal_range(f_request.m_cancelToken.getId());
+        for(auto entry = cancellable.first; entry != cancellable.second; entry++)
+        {
+            if(entry->second == &f_request)
+            {
+                m_cancellableTxRequests.erase(entry);
+                break;
+            }
+        }
+    }
+
+    // NOTE: latencies are recorded before setting the promise, so statistics
+    //       are up to date as soon as the user sees the result.
+    LatencyStatistics * connectionLatency = f_request.m_connectionLatency.get();
+    if(f_request.m_attempts > 0)
+    {
+        recordLatency(LatencyStatistics::TxQueueWait, f_request.m_firstDispatchTime - f_request.m_enqueueTime, connectionLatency);
+        recordLatency(LatencyStatistics::TxWire, f_completionTime - f_request.m_dispatchTime, connectionLatency);
+    }
+    auto promiseSetTime = std::chrono::steady_clock::now();
+    recordLatency(LatencyStatistics::TxCompletion, promiseSetTime - f_completionTime, connectionLatency);
+    recordLatency(LatencyStatistics::TxTotal, promiseSetTime - f_request.m_enqueueTime, connectionLatency);
+
+    ConnectionMetrics * connectionMetrics = f_request.m_connectionMetrics.get();
+    if(f_result.isGood())
+    {
+        m_metrics.packetsSent.add();
+        m_metrics.bytesSent.add(f_request.m_payloadSegments.totalSize());
+        if(connectionMetrics != nullptr)
+        {
+            connectionMetrics->packetsSent.add();
+            connectionMetrics->bytesSent.add(f_request.m_payloadSegments.totalSize());
+        }
+    }
+    else if(f_result.isCancelled())
+    {
+        m_metrics.sendsCancelled.add();
+        if(connectionMetrics != nullptr)
+        {
+            connectionMetrics->sendsCancelled.add();
+        }
+    }
+    else
+    {
+        m_metrics.sendFailures.add();
+        if(connectionMetrics != nullptr)
+        {
+            connectionMetrics->sendFailures.add();
+        }
+    }
+    auto creditCallbacks = releaseTxCredit(connectionMetrics);
+
+    f_result.m_enqueueTime = f_request.m_enqueueTime;
+    if(f_request.m_attempts > 0)
+    {
+        f_result.m_dispatchTime = f_request.m_firstDispatchTime;
+        f_result.m_lastDispatchTime = f_request.m_dispatchTime;
+    }
+    f_result.m_completionTime = f_completionTime;
+    return creditCallbacks;
+}
+
+template<class Strategy>
+void Bus<Strategy>::completeFrontTxRequest(Result && f_result, std::chrono::steady_clock::time_point f_completionTime)
+{
+    TxRequest & request = m_txQueue.front();
+    auto creditCallbacks = finishTxRequest(request, f_result, f_completionTime);
+
+    if(request.m_completionHandler)
+    {
+        // popped first, so the handler may already send the next packet:
+        auto completionHandler = std::move(request.m_completionHandler);
+        m_txQueue.pop();
+        completionHandler(std::move(f_result));
+    }
+    else
+    {
+        request.m_successPromise->set_value(std::move(f_result));
+        m_txQueue.pop();
+    }
+
+    for(auto & callback : creditCallbacks)
+    {
+        callback();
+    }
+}
+
+template<class Strategy>
+std::vector<std::function<void()>> Bus<Strategy>::cancelTxRequests(const void * f_tokenId)
+{
+    std::vector<std::function<void()>> deferredCalls;
+    std::lock_guard<std::recursive_mutex> guard(m_txQueueMutex);
+
+    // collected first, as finishing a request removes it from the index:
+    std::vector<TxRequest *> requests;
+    auto cancellable = m_cancellableTxRequests.equal_range(f_tokenId);
+    for(auto entry = cancellable.first; entry != cancellable.second; entry++)
+    {
+        // packets on the wire are completed by the event loop (or dropped
+        // there if they are to be retransmitted):
+        if(not entry->second->m_dispatched)
+        {
+            requests.push_back(entry->second);
+        }
+    }
+
+    auto completionTime = std::chrono::steady_clock::now();
+    for(TxRequest * request : requests)
+    {
+        Result result = Result::createCancelledResult();
+        auto creditCallbacks = finishTxRequest(*request, result, completionTime);
+        if(request->m_completionHandler)
+        {
+            deferredCalls.push_back(
+                    [completionHandler = std::move(request->m_completionHandler), result = std::move(result)]() mutable
+                    {
+                        completionHandler(std::move(result));
+                    }
+                    );
+        }
+        else
+        {
+            request->m_successPromise->set_value(std::move(result));
+        }
+        std::move(creditCallbacks.begin(), creditCallbacks.end(), std::back_inserter(deferredCalls));
+
+        // the tombstone is popped by the event loop, nothing of it is used
+        // anymore:
+        request->m_cancelled = true;
+        request->m_payload = std::vector<uint8_t>();
+        request->m_payloadSegments = ConstBufferList();
+    }
+    return deferredCalls;
+}
+
+template<class Strategy>
+std::shared_ptr<CancelToken::Listener> Bus<Strategy>::getTxCancelListener(const CancelToken & f_cancelToken) const
+{
+    if(f_cancelToken.getId() == nullptr)
+    {
+        return nullptr;
+    }
+    return m_txCancelListener;
+}
+
+template<class Strategy>
+void Bus<Strategy>::TxCancelListener::onCancel(const void * f_tokenId)
+{
+    std::vector<std::function<void()>> deferredCalls;
+    {
+        std::shared_lock<std::shared_mutex> guard(m_busMutex);
+        if(m_bus == nullptr)
+        {
+            return;
+        }
+        deferredCalls = m_bus->cancelTxRequests(f_tokenId);
+    }
+    for(auto & call : deferredCalls)
+    {
+        call();
+    }
+}
+
+template<class Strategy>
+void Bus<Strategy>::TxCancelListener::detach()
+{
+    std::unique_lock<std::shared_mutex> guard(m_busMutex);
+    m_bus = nullptr;
+}
+
+template<class Strategy>
+void Bus<Strategy>::recordLatency(LatencyStatistics::Stage f_stage, std::chrono::steady_clock::duration f_duration, LatencyStatistics * f_connectionLatency)
+{
+    m_latency.record(f_stage, f_duration);
+    if(f_connectionLatency != nullptr)
+    {
+        f_connectionLatency->record(f_stage, f_duration);
+    }
+}
+
 template<class Strategy>
 void Bus<Strategy>::pjonErrorHandler(uint8_t code, uint16_t data, void *custom_pointer)
 {
+    m_metrics.errors[code].add();
     {
         std::lock_guard<std::recursive_mutex> guard(m_txQueueMutex);
         if(m_txQueue.size()>0 and (m_txQueue.front().m_dispatched == true))
         {
             if(m_txQueue.front().m_pjonPacketBufferIndex == data)
             {
-                m_txQueue.front().m_successPromise.set_value(Result(PjonErrorToString(code, data)));
-                m_txQueue.pop();
+                if(not scheduleRetransmit(m_txQueue.front(), code))
+                {
+                    completeFrontTxRequest(Result(PjonErrorToString(code, data)), std::chrono::steady_clock::now());
+                }
             }
         }
     }
@@ -220,6 +773,10 @@ void Bus<Strategy>::pjonReceiveFunction(
         const PJON_Packet_Info &packet_info
         )
 {
+    auto rxTime = std::chrono::steady_clock::now();
+    m_metrics.packetsReceived.add();
+    m_metrics.bytesReceived.add(length);
+
     Address remoteAddr;
     remoteAddr.id = packet_info.tx.id;
 #if(PJON_INCLUDE_PORT)
@@ -244,25 +801,65 @@ void Bus<Strategy>::pjonReceiveFunction(
     targetAddr.busId[2] = packet_info.rx.bus_id[2];
     targetAddr.busId[3] = packet_info.rx.bus_id[3];
 
+    if(m_logger->isEnabled(Logger::Debug))
+    {
+#if(PJON_INCLUDE_PACKET_ID)
+        m_logger->logRecord(LogRecord::rxPacket(remoteAddr, targetAddr, packet_info.id, true));
+#else
+        m_logger->logRecord(LogRecord::rxPacket(remoteAddr, targetAddr, 0, false));
+#endif
+    }
+
+    if(auto capture = std::atomic_load(&m_capture))
+    {
 #if(PJON_INCLUDE_PACKET_ID)
-    m_logger->log(Logger::Debug, "Rx packet: remote=" + remoteAddr.toString() + " target=" + targetAddr.toString() + " packet id = " +  std::to_string(packet_info.id));
-#else 
-    m_logger->log(Logger::Debug, "Rx packet: remote=" + remoteAddr.toString() + " target=" + targetAddr.toString() + " packet id = [DISABLED_IN_PJON_HL]");
+        uint16_t packetId = packet_info.id;
+#else
+        uint16_t packetId = 0;
 #endif
+        capture->record(TrafficCapture::Direction::Rx, remoteAddr, targetAddr, packetId, payload, length, rxTime);
+    }
+
+    auto frameStartTime = rxTime;
+    if constexpr(HasFrameStartTime<Strategy>::value)
+    {
+        frameStartTime = std::min(m_pjon.strategy.getLastFrameStartTime(), rxTime);
+    }
 
     std::lock_guard<std::mutex> connections_guard(m_connections_mutex);
-    for(auto connection : m_connections)
+
+    // services registered by port are found without matching connections:
+    const PortDispatcher::Handler * portHandler = nullptr;
+    if(not m_portDispatcher.empty() and (targetAddr.toKey() | 0xffff) == (m_localAddress.toKey() | 0xffff))
     {
-        // if more than one connection is interested in a packet, the packet
-        // gets placed in the rx queue of both connections.
-        if(
-            connection->m_remoteAddress.matches(remoteAddr, connection->m_remoteMask)
-            and
-            connection->m_localAddress.matches(targetAddr, connection->m_localMask)
-          )
-        {
-            connection->addReceivedPacket(std::vector<uint8_t>(payload, payload + length), remoteAddr, targetAddr);
-        }
+        portHandler = m_portDispatcher.find(targetAddr.port);
+    }
+    if(portHandler != nullptr)
+    {
+        ReceivedPacketInfo info;
+        info.size = length;
+        info.payloadSize = length;
+        info.remoteAddress = remoteAddr;
+        info.targetAddress = targetAddr;
+        info.rxTime = rxTime;
+        info.frameStartTime = frameStartTime;
+        m_metrics.packetsPortDispatched.add();
+        (*portHandler)(ConstBuffer(payload, length), info);
+
+        m_lastRxTxActivity = std::chrono::steady_clock::now();
+        return;
+    }
+
+    m_connectionTable.match(remoteAddr, targetAddr, m_rxMatches);
+    // if more than one connection is interested in a packet, the packet
+    // gets placed in the rx queue of both connections.
+    for(uint32_t index : m_rxMatches)
+    {
+        m_connectionTableEntries[index]->addReceivedPacket(payload, length, remoteAddr, targetAddr, rxTime, frameStartTime);
+    }
+    if(m_rxMatches.empty())
+    {
+        m_metrics.packetsUnmatched.add();
     }
 
     m_lastRxTxActivity = std::chrono::steady_clock::now();
@@ -273,10 +870,39 @@ void Bus<Strategy>::pjonEventLoop()
 {
     while(m_eventLoopRunning)
     {
+        if(m_pauseRequested and not (m_pauseFinishInFlightTx and isTxInFlight()))
+        {
+            parkEventLoop();
+            continue;
+        }
+
+        m_metrics.eventLoopIterations.add();
+
         // first do tx queue dispatch if required:
         {
             std::lock_guard<std::recursive_mutex> guard(m_txQueueMutex);
-            if((m_txQueue.size()>0) and (m_txQueue.front().m_dispatched == false))
+            // withdrawn requests are already completed, requests cancelled
+            // while on the wire are dropped once waiting for a
+            // retransmission:
+            while(
+                (m_txQueue.size()>0) and
+                (m_txQueue.front().m_dispatched == false) and
+                m_txQueue.front().m_cancelToken.isCancelled()
+              )
+            {
+                if(m_txQueue.front().m_cancelled)
+                {
+                    m_txQueue.pop();
+                    continue;
+                }
+                completeFrontTxRequest(Result::createCancelledResult(), std::chrono::steady_clock::now());
+            }
+            if(
+                (not m_pauseRequested) and
+                (m_txQueue.size()>0) and
+                (m_txQueue.front().m_dispatched == false) and
+                (m_txQueue.front().m_notBefore <= std::chrono::steady_clock::now())
+              )
             {
                 // have a new packet to transmit and all previous packets are sent
                 // or failed
@@ -286,11 +912,11 @@ void Bus<Strategy>::pjonEventLoop()
                 dispatchTxRequest(m_txQueue.front());
                 if(not m_txQueue.front().m_dispatched)
                 {
+                    m_metrics.dispatchFailures.add();
                     // dispatch failed (most likely packet size too big)
                     // -> communicate to user and drop packet:
                     // TODO: more concrete error message?
-                    m_txQueue.front().m_successPromise.set_value(Result("Dispatching failed, Most likely packet size too big."));
-                    m_txQueue.pop();
+                    completeFrontTxRequest(Result("Dispatching failed, Most likely packet size too big."), std::chrono::steady_clock::now());
                 }
 
                 // NOTE: For now we only support one packet being in transit
@@ -332,10 +958,13 @@ void Bus<Strategy>::pjonEventLoop()
                     // we now know we have success, as if we would have failure, 
                     // error callback would have been called and the packet would
                     // already be popped with promise set to false
-                    m_txQueue.front().m_successPromise.set_value(Result());
-
+                    auto completionTime = std::chrono::steady_clock::now();
+                    m_retransmitPolicy.reportSuccess(
+                            m_txQueue.front().m_remoteAddress,
+                            completionTime - m_txQueue.front().m_dispatchTime
+                            );
                     // packet can be popped from queue:
-                    m_txQueue.pop();
+                    completeFrontTxRequest(Result(), completionTime);
                 }
             }
         }
@@ -350,6 +979,7 @@ void Bus<Strategy>::pjonEventLoop()
             // more than 100 bytes required to receive
             m_pjon.receive();
         }
+        m_metrics.receiveCalls.add(100);
 
         // FIXME: this causes "busy-waiting" loop, and causes high CPU load.
         //        as a simple workaround we introduce a delay here to free up
@@ -368,6 +998,7 @@ void Bus<Strategy>::pjonEventLoop()
         //        specific to used strategy :-(
         if(std::chrono::steady_clock::now() - m_lastRxTxActivity.load() > std::chrono::milliseconds(200))
         {
+            m_metrics.idleSleeps.add();
             std::this_thread::sleep_for(std::chrono::milliseconds(2));
         }
     }
@@ -391,10 +1022,52 @@ void Bus<Strategy>::dispatchTxRequest(TxRequest & f_request)
     info.port = f_request.m_remoteAddress.port;
 #endif
 
+    if(f_request.m_attempts == 0)
+    {
+        forgetConflatableTxRequest(f_request);
+        f_request.m_maxAttempts = f_request.m_retransmitEnabled ? m_retransmitPolicy.getMaxAttempts(f_request.m_remoteAddress) : 1;
+    }
+    f_request.m_attempts++;
+    f_request.m_dispatchTime = std::chrono::steady_clock::now();
+    if(f_request.m_attempts == 1)
+    {
+        f_request.m_firstDispatchTime = f_request.m_dispatchTime;
+    }
+
+    ConstBuffer payload;
+    if(f_request.m_payloadSegments.size() == 1)
+    {
+        payload = f_request.m_payloadSegments[0];
+    }
+    else
+    {
+        m_txGatherBuffer.clear();
+        f_request.m_payloadSegments.gatherInto(m_txGatherBuffer);
+        payload = m_txGatherBuffer;
+    }
+
+    if(auto capture = std::atomic_load(&m_capture))
+    {
+#if(PJON_INCLUDE_PACKET_ID)
+        uint16_t packetId = info.id;
+#else
+        uint16_t packetId = 0;
+#endif
+        capture->record(
+                TrafficCapture::Direction::Tx,
+                f_request.m_localAddress,
+                f_request.m_remoteAddress,
+                packetId,
+                payload.data(),
+                payload.size(),
+                f_request.m_dispatchTime
+                );
+    }
+
     uint16_t bufferIndex = m_pjon.send(
             info,
-            f_request.m_payload.data(),
-            f_request.m_payload.size()
+            payload.data(),
+            payload.size()
             );
 
     m_lastRxTxActivity = std::chrono::steady_clock::now();
@@ -411,4 +1084,38 @@ void Bus<Strategy>::dispatchTxRequest(TxRequest & f_request)
     }
 }
 
+template<class Strategy>
+bool Bus<Strategy>::scheduleRetransmit(TxRequest & f_request, uint8_t f_errorCode)
+{
+    m_retransmitPolicy.reportFailure(f_request.m_remoteAddress);
+
+    if(f_errorCode == PJON_CONTENT_TOO_LONG)
+    {
+        // will never succeed, no need to retry
+        return false;
+    }
+    if(f_request.m_attempts >= f_request.m_maxAttempts)
+    {
+        return false;
+    }
+
+    auto now = std::chrono::steady_clock::now();
+    auto backoff = m_retransmitPolicy.getBackoff(f_request.m_remoteAddress, f_request.m_attempts);
+    if(now + backoff > f_request.m_deadline)
+    {
+        // retransmission would exceed timeout given by user
+        return false;
+    }
+
+    if(m_logger->isEnabled(Logger::Debug))
+    {
+        m_logger->logRecord(LogRecord::txRetransmit(f_request.m_remoteAddress, f_request.m_attempts + 1, backoff.count()));
+    }
+
+    m_metrics.retransmissions.add();
+    f_request.m_dispatched = false;
+    f_request.m_notBefore = now + backoff;
+    return true;
+}
+
 }
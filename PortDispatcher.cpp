@@ -0,0 +1,57 @@
+// Copyright 2021 Rainer Schoenberger
+// 
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+// 
+//     http://www.apache.org/licenses/LICENSE-2.0
+// 
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "PortDispatcher.hpp"
+
+namespace PjonHL
+{
+
+// -----------------------------------------------------------------------------
+void PortDispatcher::set(uint16_t f_port, Handler f_handler)
+{
+    std::unique_ptr<Page> & page = m_pages[f_port >> 8];
+    if(not page)
+    {
+        if(not f_handler)
+        {
+            return;
+        }
+        page = std::make_unique<Page>();
+    }
+
+    Handler & entry = (*page)[f_port & 0xff];
+    if(entry and not f_handler)
+    {
+        m_size--;
+    }
+    else if(not entry and f_handler)
+    {
+        m_size++;
+    }
+    entry = std::move(f_handler);
+}
+
+// -----------------------------------------------------------------------------
+const PortDispatcher::Handler * PortDispatcher::find(uint16_t f_port) const
+{
+    const std::unique_ptr<Page> & page = m_pages[f_port >> 8];
+    if(not page)
+    {
+        return nullptr;
+    }
+    const Handler & entry = (*page)[f_port & 0xff];
+    return entry ? &entry : nullptr;
+}
+
+}
@@ -0,0 +1,68 @@
+// Copyright 2021 Rainer Schoenberger
+// 
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+// 
+//     http://www.apache.org/licenses/LICENSE-2.0
+// 
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <array>
+#include <functional>
+#include <inttypes.h>
+#include <memory>
+
+#include "ConstBuffer.hpp"
+
+namespace PjonHL
+{
+
+struct ReceivedPacketInfo;
+
+/// Handlers of received packets by local port, for devices structured as one
+/// port per service (see Bus::setPortHandler()).
+/// Handlers are stored in a two level table directly indexed by the port, so
+/// finding one takes constant time however many ports are registered. The
+/// second level is allocated per 256 ports, only once a handler is set for
+/// one of them.
+class PortDispatcher
+{
+    public:
+        /// Called with the payload (only valid during the call) and the
+        /// metadata of a received packet.
+        using Handler = std::function<void(ConstBuffer f_payload, const ReceivedPacketInfo & f_info)>;
+
+        /// Sets the handler of f_port, replacing a previous one. An empty
+        /// f_handler removes it.
+        void set(uint16_t f_port, Handler f_handler);
+
+        /// @returns the handler of f_port, nullptr if none is set.
+        const Handler * find(uint16_t f_port) const;
+
+        /// Number of ports with a handler.
+        inline size_t size() const
+        {
+            return m_size;
+        }
+
+        inline bool empty() const
+        {
+            return m_size == 0;
+        }
+
+    private:
+        using Page = std::array<Handler, 256>;
+
+        // indexed by the upper byte of the port, pages by the lower byte:
+        std::array<std::unique_ptr<Page>, 256> m_pages;
+        size_t m_size = 0;
+};
+
+}
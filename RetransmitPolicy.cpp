@@ -0,0 +1,138 @@
+// Copyright 2021 Rainer Schoenberger
+// 
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+// 
+//     http://www.apache.org/licenses/LICENSE-2.0
+// 
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "RetransmitPolicy.hpp"
+#include <algorithm>
+#include <cstdlib>
+
+namespace PjonHL
+{
+
+// -----------------------------------------------------------------------------
+RetransmitPolicy::RetransmitPolicy(BusConfig::RetransmitConfig f_config) :
+    m_config(f_config),
+    m_random(static_cast<std::minstd_rand::result_type>(Clock::now().time_since_epoch().count()))
+{
+}
+
+// -----------------------------------------------------------------------------
+void RetransmitPolicy::reportSuccess(const Address & f_remote, Clock::duration f_roundTripTime)
+{
+    RemoteState & state = m_remotes[remoteKey(f_remote)];
+    int64_t sample = std::chrono::duration_cast<std::chrono::microseconds>(f_roundTripTime).count();
+
+    // RFC 6298 (alpha = 1/8, beta = 1/4):
+    if(not state.hasRttSample)
+    {
+        state.smoothedRttMicroseconds = sample;
+        state.rttVarianceMicroseconds = sample / 2;
+        state.hasRttSample = true;
+    }
+    else
+    {
+        int64_t deviation = std::abs(state.smoothedRttMicroseconds - sample);
+        state.rttVarianceMicroseconds += (deviation - state.rttVarianceMicroseconds) / 4;
+        state.smoothedRttMicroseconds += (sample - state.smoothedRttMicroseconds) / 8;
+    }
+
+    // remote is alive again:
+    state.recentFailures = 0;
+}
+
+// -----------------------------------------------------------------------------
+void RetransmitPolicy::reportFailure(const Address & f_remote, Clock::time_point f_now)
+{
+    RemoteState & state = m_remotes[remoteKey(f_remote)];
+    if(f_now - state.lastFailure > std::chrono::milliseconds(m_config.failureMemoryMilliseconds))
+    {
+        // last failure is long ago, start counting again:
+        state.recentFailures = 0;
+    }
+    if(state.recentFailures < 0xff)
+    {
+        state.recentFailures++;
+    }
+    state.lastFailure = f_now;
+}
+
+// -----------------------------------------------------------------------------
+uint8_t RetransmitPolicy::getMaxAttempts(const Address & f_remote, Clock::time_point f_now) const
+{
+    uint8_t maxAttempts = std::max<uint8_t>(m_config.maxAttempts, 1);
+    const RemoteState * state = findRemote(f_remote);
+    if(state == nullptr or
+       f_now - state->lastFailure > std::chrono::milliseconds(m_config.failureMemoryMilliseconds))
+    {
+        return maxAttempts;
+    }
+    if(state->recentFailures >= maxAttempts)
+    {
+        return 1;
+    }
+    return maxAttempts - state->recentFailures;
+}
+
+// -----------------------------------------------------------------------------
+std::chrono::microseconds RetransmitPolicy::getRetransmitTimeout(const Address & f_remote) const
+{
+    const int64_t minRto = int64_t(m_config.minRtoMilliseconds) * 1000;
+    const int64_t maxRto = int64_t(m_config.maxRtoMilliseconds) * 1000;
+
+    int64_t rto = int64_t(m_config.initialRtoMilliseconds) * 1000;
+    const RemoteState * state = findRemote(f_remote);
+    if(state != nullptr and state->hasRttSample)
+    {
+        rto = state->smoothedRttMicroseconds + 4 * state->rttVarianceMicroseconds;
+    }
+    return std::chrono::microseconds(std::min(std::max(rto, minRto), std::max(maxRto, minRto)));
+}
+
+// -----------------------------------------------------------------------------
+std::chrono::microseconds RetransmitPolicy::getBackoff(const Address & f_remote, uint8_t f_failedAttempts)
+{
+    const int64_t maxRto = int64_t(m_config.maxRtoMilliseconds) * 1000;
+    int64_t backoff = getRetransmitTimeout(f_remote).count();
+
+    for(uint8_t i = 1; i < f_failedAttempts and backoff < maxRto; i++)
+    {
+        backoff *= 2;
+    }
+    backoff = std::min(backoff, std::max(maxRto, int64_t(1)));
+
+    // "equal jitter": keep lower half, randomize upper half. This prevents
+    // several participants from retrying in lockstep.
+    int64_t half = backoff / 2;
+    std::uniform_int_distribution<int64_t> jitter(0, backoff - half);
+    return std::chrono::microseconds(half + jitter(m_random));
+}
+
+// -----------------------------------------------------------------------------
+uint64_t RetransmitPolicy::remoteKey(const Address & f_remote)
+{
+    // statistics are per device, port is not relevant:
+    return f_remote.toKey() >> 16;
+}
+
+// -----------------------------------------------------------------------------
+const RetransmitPolicy::RemoteState * RetransmitPolicy::findRemote(const Address & f_remote) const
+{
+    auto it = m_remotes.find(remoteKey(f_remote));
+    if(it == m_remotes.end())
+    {
+        return nullptr;
+    }
+    return &it->second;
+}
+
+}
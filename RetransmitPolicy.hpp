@@ -0,0 +1,80 @@
+// Copyright 2021 Rainer Schoenberger
+// 
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+// 
+//     http://www.apache.org/licenses/LICENSE-2.0
+// 
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <chrono>
+#include <inttypes.h>
+#include <random>
+#include <unordered_map>
+
+#include "Address.hpp"
+#include "BusConfig.hpp"
+
+namespace PjonHL
+{
+
+/// Keeps per-remote transmission statistics and decides if and when a failed
+/// packet is retransmitted.
+/// See BusConfig::RetransmitConfig for a description of the algorithm.
+/// NOTE: Not thread safe. Bus only uses it from within its event-loop thread.
+class RetransmitPolicy
+{
+    public:
+        using Clock = std::chrono::steady_clock;
+
+        explicit RetransmitPolicy(BusConfig::RetransmitConfig f_config = BusConfig::RetransmitConfig{});
+
+        /// Feeds a successful transmission into the statistics of a remote.
+        /// @param f_remote address the packet was sent to
+        /// @param f_roundTripTime time from dispatching the packet to PJON
+        ///         until PJON reported completion.
+        void reportSuccess(const Address & f_remote, Clock::duration f_roundTripTime);
+
+        /// Feeds a failed transmission attempt into the statistics of a remote.
+        void reportFailure(const Address & f_remote, Clock::time_point f_now = Clock::now());
+
+        /// @returns the number of attempts (including the first one) a new
+        ///          packet to the given remote should get.
+        uint8_t getMaxAttempts(const Address & f_remote, Clock::time_point f_now = Clock::now()) const;
+
+        /// @returns the current retransmit timeout for the given remote.
+        std::chrono::microseconds getRetransmitTimeout(const Address & f_remote) const;
+
+        /// Computes the time to wait before the next attempt.
+        /// @param f_remote address the packet is sent to
+        /// @param f_failedAttempts number of attempts which already failed (>=1)
+        /// @returns RTO * 2^(f_failedAttempts-1) (capped at max RTO) with
+        ///          random jitter applied to the upper half.
+        std::chrono::microseconds getBackoff(const Address & f_remote, uint8_t f_failedAttempts);
+
+    private:
+        struct RemoteState
+        {
+            bool hasRttSample = false;
+            int64_t smoothedRttMicroseconds = 0;
+            int64_t rttVarianceMicroseconds = 0;
+            uint8_t recentFailures = 0;
+            Clock::time_point lastFailure;
+        };
+
+        static uint64_t remoteKey(const Address & f_remote);
+        const RemoteState * findRemote(const Address & f_remote) const;
+
+        BusConfig::RetransmitConfig m_config;
+        std::unordered_map<uint64_t, RemoteState> m_remotes;
+        std::minstd_rand m_random;
+};
+
+}
@@ -0,0 +1,164 @@
+// Copyright 2021 Rainer Schoenberger
+// 
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+// 
+//     http://www.apache.org/licenses/LICENSE-2.0
+// 
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "ThreadSetup.hpp"
+
+#include <cerrno>
+#include <cstring>
+
+#include <alloca.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+
+namespace PjonHL
+{
+
+namespace
+{
+std::string errorString(int f_error)
+{
+    std::string message = std::strerror(f_error);
+    if(f_error == EPERM)
+    {
+        message += " (requires root or CAP_SYS_NICE/CAP_IPC_LOCK, see also ulimit -r/-l)";
+    }
+    return message;
+}
+
+bool setScheduling(const BusConfig::ThreadConfig & f_config, Logger & f_logger)
+{
+    int policy;
+    switch(f_config.schedulingPolicy)
+    {
+        case BusConfig::ThreadConfig::SchedulingPolicy::Fifo:
+            policy = SCHED_FIFO;
+            break;
+        case BusConfig::ThreadConfig::SchedulingPolicy::RoundRobin:
+            policy = SCHED_RR;
+            break;
+        case BusConfig::ThreadConfig::SchedulingPolicy::Default:
+        default:
+            return true;
+    }
+    sched_param parameter{};
+    parameter.sched_priority = f_config.priority;
+    int result = pthread_setschedparam(pthread_self(), policy, &parameter);
+    if(result != 0)
+    {
+        f_logger.log(
+                Logger::Error,
+                "Could not set real-time scheduling (priority " + std::to_string(f_config.priority) + ") of event-loop thread: " + errorString(result)
+                );
+        return false;
+    }
+    return true;
+}
+
+bool setAffinity(const BusConfig::ThreadConfig & f_config, Logger & f_logger)
+{
+    if(f_config.cpuAffinity.empty())
+    {
+        return true;
+    }
+#if defined(__linux__)
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    for(int cpu : f_config.cpuAffinity)
+    {
+        if(cpu < 0 or cpu >= CPU_SETSIZE)
+        {
+            f_logger.log(Logger::Error, "Invalid CPU " + std::to_string(cpu) + " in affinity of event-loop thread.");
+            return false;
+        }
+        CPU_SET(cpu, &cpus);
+    }
+    int result = pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+    if(result != 0)
+    {
+        f_logger.log(Logger::Error, "Could not set CPU affinity of event-loop thread: " + errorString(result));
+        return false;
+    }
+    return true;
+#else
+    f_logger.log(Logger::Error, "CPU affinity of event-loop thread is not supported on this platform.");
+    return false;
+#endif
+}
+
+bool lockMemory(const BusConfig::ThreadConfig & f_config, Logger & f_logger)
+{
+    if(not f_config.lockMemory)
+    {
+        return true;
+    }
+    if(mlockall(MCL_CURRENT | MCL_FUTURE) != 0)
+    {
+        f_logger.log(Logger::Error, "Could not lock memory (mlockall): " + errorString(errno));
+        return false;
+    }
+    return true;
+}
+
+void prefaultStack(size_t f_bytes)
+{
+    if(f_bytes == 0)
+    {
+        return;
+    }
+    // touch one byte per page of a stack allocation, which is released again
+    // when returning, but stays mapped:
+    volatile uint8_t * stack = static_cast<volatile uint8_t*>(alloca(f_bytes));
+    for(size_t i = 0; i < f_bytes; i += 4096)
+    {
+        stack[i] = 0;
+    }
+    stack[f_bytes - 1] = 0;
+}
+
+bool setName(const BusConfig::ThreadConfig & f_config, Logger & f_logger)
+{
+    if(f_config.name.empty())
+    {
+        return true;
+    }
+#if defined(__linux__)
+    // Linux limits names to 16 bytes including terminating zero:
+    std::string name = f_config.name.substr(0, 15);
+    int result = pthread_setname_np(pthread_self(), name.c_str());
+    if(result != 0)
+    {
+        f_logger.log(Logger::Error, "Could not set name of event-loop thread: " + errorString(result));
+        return false;
+    }
+#elif defined(__APPLE__)
+    pthread_setname_np(f_config.name.c_str());
+#endif
+    return true;
+}
+}
+
+// -----------------------------------------------------------------------------
+bool setUpCurrentThread(const BusConfig::ThreadConfig & f_config, Logger & f_logger)
+{
+    bool success = setName(f_config, f_logger);
+    success = setAffinity(f_config, f_logger) and success;
+    success = lockMemory(f_config, f_logger) and success;
+    prefaultStack(f_config.prefaultStackBytes);
+    // last, so the setup above does not run with real-time priority:
+    success = setScheduling(f_config, f_logger) and success;
+    return success;
+}
+
+}
@@ -0,0 +1,31 @@
+// Copyright 2021 Rainer Schoenberger
+// 
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+// 
+//     http://www.apache.org/licenses/LICENSE-2.0
+// 
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include "BusConfig.hpp"
+#include "Logger.hpp"
+
+namespace PjonHL
+{
+
+/// Applies f_config (scheduling policy, CPU affinity, memory locking, stack
+/// prefaulting and name) to the calling thread. Used by Bus for its
+/// event-loop thread.
+/// Every setting is tried independently, failures are logged as errors to
+/// f_logger.
+/// @returns true if all settings were applied successfully.
+bool setUpCurrentThread(const BusConfig::ThreadConfig & f_config, Logger & f_logger);
+
+}
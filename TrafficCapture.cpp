@@ -0,0 +1,196 @@
+// Copyright 2021 Rainer Schoenberger
+// 
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+// 
+//     http://www.apache.org/licenses/LICENSE-2.0
+// 
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "TrafficCapture.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+namespace PjonHL
+{
+
+constexpr char TrafficCapture::Magic[8];
+
+// -----------------------------------------------------------------------------
+TrafficCapture::TrafficCapture(const std::string & f_path, uint32_t f_slotCount, uint32_t f_slotSize) :
+    m_slotSize(f_slotSize),
+    m_slotCount(f_slotCount)
+{
+    if(f_slotCount == 0 or f_slotSize <= sizeof(RecordHeader) or f_slotSize % 8 != 0)
+    {
+        throw std::runtime_error("Invalid capture slot configuration.");
+    }
+    m_mappingSize = sizeof(FileHeader) + static_cast<size_t>(f_slotCount) * f_slotSize;
+
+    m_fd = open(f_path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if(m_fd < 0)
+    {
+        throw std::runtime_error("Could not open capture file " + f_path + ": " + std::strerror(errno));
+    }
+    if(ftruncate(m_fd, m_mappingSize) != 0)
+    {
+        std::string error = std::strerror(errno);
+        close(m_fd);
+        throw std::runtime_error("Could not allocate capture file " + f_path + ": " + error);
+    }
+    void * mapping = mmap(nullptr, m_mappingSize, PROT_READ | PROT_WRITE, MAP_SHARED, m_fd, 0);
+    if(mapping == MAP_FAILED)
+    {
+        std::string error = std::strerror(errno);
+        close(m_fd);
+        throw std::runtime_error("Could not map capture file " + f_path + ": " + error);
+    }
+    m_mapping = static_cast<uint8_t*>(mapping);
+
+    // touch all pages now, so recording does not page fault later:
+    std::memset(m_mapping, 0, m_mappingSize);
+
+    m_header = reinterpret_cast<FileHeader*>(m_mapping);
+    std::memcpy(m_header->magic, Magic, sizeof(Magic));
+    m_header->version = Version;
+    m_header->headerSize = sizeof(FileHeader);
+    m_header->slotSize = f_slotSize;
+    m_header->slotCount = f_slotCount;
+    m_header->recordCount = 0;
+    m_startTime = std::chrono::steady_clock::now();
+    m_header->startUnixNanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::system_clock::now().time_since_epoch()
+            ).count();
+}
+
+// -----------------------------------------------------------------------------
+TrafficCapture::~TrafficCapture()
+{
+    msync(m_mapping, m_mappingSize, MS_SYNC);
+    munmap(m_mapping, m_mappingSize);
+    close(m_fd);
+}
+
+// -----------------------------------------------------------------------------
+void TrafficCapture::record(
+        Direction f_direction,
+        const Address & f_source,
+        const Address & f_destination,
+        uint16_t f_packetId,
+        const uint8_t * f_payload,
+        uint16_t f_length,
+        std::chrono::steady_clock::time_point f_time
+        ) noexcept
+{
+    uint8_t * slot = m_mapping + sizeof(FileHeader) + (m_recordCount % m_slotCount) * m_slotSize;
+    RecordHeader * record = reinterpret_cast<RecordHeader*>(slot);
+
+    // invalidate slot while writing (see class documentation):
+    record->sequence = 0;
+    std::atomic_thread_fence(std::memory_order_release);
+
+    record->timestampNanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(f_time - m_startTime).count();
+    record->direction = static_cast<uint8_t>(f_direction);
+    record->sourceId = f_source.id;
+    record->destinationId = f_destination.id;
+    std::copy(f_source.busId.begin(), f_source.busId.end(), record->sourceBusId);
+    std::copy(f_destination.busId.begin(), f_destination.busId.end(), record->destinationBusId);
+    record->port = f_destination.port;
+    record->packetId = f_packetId;
+    record->payloadLength = f_length;
+    record->capturedLength = static_cast<uint16_t>(std::min<size_t>(f_length, m_slotSize - sizeof(RecordHeader)));
+    std::memcpy(slot + sizeof(RecordHeader), f_payload, record->capturedLength);
+
+    std::atomic_thread_fence(std::memory_order_release);
+    m_recordCount++;
+    record->sequence = m_recordCount;
+    m_header->recordCount = m_recordCount;
+}
+
+// -----------------------------------------------------------------------------
+uint64_t TrafficCapture::getRecordCount() const
+{
+    return m_recordCount;
+}
+
+// -----------------------------------------------------------------------------
+void TrafficCapture::flush()
+{
+    msync(m_mapping, m_mappingSize, MS_ASYNC);
+}
+
+// -----------------------------------------------------------------------------
+std::vector<TrafficCapture::Record> TrafficCapture::readFile(const std::string & f_path, FileHeader * f_header)
+{
+    std::ifstream file(f_path, std::ios::binary);
+    if(not file)
+    {
+        throw std::runtime_error("Could not open capture file " + f_path);
+    }
+    std::vector<uint8_t> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+    FileHeader header;
+    if(data.size() < sizeof(header))
+    {
+        throw std::runtime_error("Not a capture file: " + f_path);
+    }
+    std::memcpy(&header, data.data(), sizeof(header));
+    if(
+        std::memcmp(header.magic, Magic, sizeof(Magic)) != 0
+        or header.version != Version
+        or header.headerSize != sizeof(FileHeader)
+        or header.slotSize <= sizeof(RecordHeader)
+        or data.size() < header.headerSize + static_cast<size_t>(header.slotCount) * header.slotSize
+      )
+    {
+        throw std::runtime_error("Not a capture file or unsupported version: " + f_path);
+    }
+    if(f_header)
+    {
+        *f_header = header;
+    }
+
+    std::vector<Record> records;
+    uint64_t first = header.recordCount > header.slotCount ? header.recordCount - header.slotCount : 0;
+    for(uint64_t index = first; index < header.recordCount; index++)
+    {
+        const uint8_t * slot = data.data() + header.headerSize + (index % header.slotCount) * header.slotSize;
+        RecordHeader recordHeader;
+        std::memcpy(&recordHeader, slot, sizeof(recordHeader));
+        if(recordHeader.sequence != index + 1 or recordHeader.capturedLength > header.slotSize - sizeof(RecordHeader))
+        {
+            continue;
+        }
+
+        Record record;
+        record.direction = static_cast<Direction>(recordHeader.direction);
+        record.unixNanoseconds = header.startUnixNanoseconds + static_cast<int64_t>(recordHeader.timestampNanoseconds);
+        record.source.id = recordHeader.sourceId;
+        std::copy(recordHeader.sourceBusId, recordHeader.sourceBusId + 4, record.source.busId.begin());
+        record.destination.id = recordHeader.destinationId;
+        std::copy(recordHeader.destinationBusId, recordHeader.destinationBusId + 4, record.destination.busId.begin());
+        record.source.port = recordHeader.port;
+        record.destination.port = recordHeader.port;
+        record.packetId = recordHeader.packetId;
+        record.payloadLength = recordHeader.payloadLength;
+        record.payload.assign(slot + sizeof(RecordHeader), slot + sizeof(RecordHeader) + recordHeader.capturedLength);
+        records.push_back(std::move(record));
+    }
+    return records;
+}
+
+}
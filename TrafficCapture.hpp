@@ -0,0 +1,156 @@
+// Copyright 2021 Rainer Schoenberger
+// 
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+// 
+//     http://www.apache.org/licenses/LICENSE-2.0
+// 
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <chrono>
+#include <inttypes.h>
+#include <string>
+#include <vector>
+
+#include "Address.hpp"
+
+namespace PjonHL
+{
+
+/// Records packets into a preallocated, memory-mapped ring file.
+/// Recording a packet only copies it into the mapping: no allocation, no
+/// syscall. The file can be converted offline (see tools/pjonhlCapture.cpp).
+///
+/// File layout (all integers in host byte order, little endian on all
+/// supported platforms):
+///
+///   FileHeader (64 bytes)
+///   slotCount * slot of slotSize bytes, each:
+///     RecordHeader (40 bytes)
+///     payload (capturedLength bytes, rest of slot unused)
+///
+/// Record n (counting from 0) is stored in slot n % slotCount, i.e. once the
+/// ring is full the oldest records are overwritten. FileHeader::recordCount
+/// holds the number of records written so far. A slot contains a valid record
+/// only if RecordHeader::sequence equals its record number + 1 (0 = never
+/// written, other values = torn write, e.g. if the process crashed).
+///
+/// Not thread safe: record() must only be called by one thread at a time
+/// (Bus calls it from its event-loop thread only).
+class TrafficCapture
+{
+    public:
+        static constexpr char Magic[8] = {'P', 'J', 'H', 'L', 'C', 'A', 'P', '\0'};
+        static constexpr uint32_t Version = 1;
+
+        enum class Direction : uint8_t
+        {
+            Tx = 0,
+            Rx = 1
+        };
+
+        struct FileHeader
+        {
+            char magic[8];
+            uint32_t version;
+            uint32_t headerSize;
+            uint32_t slotSize;
+            uint32_t slotCount;
+            uint64_t recordCount;
+            /// Wall clock time at which capturing started, in nanoseconds
+            /// since unix epoch. Record timestamps are relative to this.
+            int64_t startUnixNanoseconds;
+            uint8_t reserved[24];
+        };
+
+        struct RecordHeader
+        {
+            uint64_t sequence;
+            uint64_t timestampNanoseconds;
+            uint8_t direction;
+            uint8_t sourceId;
+            uint8_t destinationId;
+            uint8_t reserved0;
+            uint8_t sourceBusId[4];
+            uint8_t destinationBusId[4];
+            uint16_t port;
+            uint16_t packetId;
+            /// Length of the packet payload.
+            uint16_t payloadLength;
+            /// Bytes of the payload stored in this slot (payload is truncated
+            /// if it does not fit into the slot).
+            uint16_t capturedLength;
+            uint32_t reserved1;
+        };
+
+        /// Creates (or truncates) the capture file and maps it to memory.
+        /// The whole file is allocated and touched upfront.
+        /// @param f_slotSize size of each record slot including RecordHeader,
+        ///        has to be a multiple of 8.
+        /// @throws std::runtime_error if the file can not be created.
+        TrafficCapture(const std::string & f_path, uint32_t f_slotCount = 65536, uint32_t f_slotSize = 128);
+
+        /// Syncs and unmaps the file.
+        ~TrafficCapture();
+
+        TrafficCapture(const TrafficCapture &) = delete;
+        TrafficCapture & operator=(const TrafficCapture &) = delete;
+
+        /// Records a packet. f_destination.port is stored as port.
+        void record(
+                Direction f_direction,
+                const Address & f_source,
+                const Address & f_destination,
+                uint16_t f_packetId,
+                const uint8_t * f_payload,
+                uint16_t f_length,
+                std::chrono::steady_clock::time_point f_time = std::chrono::steady_clock::now()
+                ) noexcept;
+
+        uint64_t getRecordCount() const;
+
+        /// Asynchronously writes recorded data back to the file (a syscall,
+        /// not done by record()). Unmapping does this as well.
+        void flush();
+
+        /// A record as read back from a capture file.
+        struct Record
+        {
+            Direction direction;
+            /// Nanoseconds since unix epoch.
+            int64_t unixNanoseconds;
+            Address source;
+            Address destination;
+            uint16_t packetId;
+            uint16_t payloadLength;
+            /// Captured (possibly truncated) payload.
+            std::vector<uint8_t> payload;
+        };
+
+        /// Reads all valid records of a capture file, oldest first.
+        /// Works on files of running captures as well.
+        /// @throws std::runtime_error if the file is not a valid capture file.
+        static std::vector<Record> readFile(const std::string & f_path, FileHeader * f_header = nullptr);
+
+    private:
+        uint8_t * m_mapping = nullptr;
+        size_t m_mappingSize = 0;
+        int m_fd = -1;
+        FileHeader * m_header = nullptr;
+        uint32_t m_slotSize;
+        uint32_t m_slotCount;
+        uint64_t m_recordCount = 0;
+        std::chrono::steady_clock::time_point m_startTime;
+};
+
+static_assert(sizeof(TrafficCapture::FileHeader) == 64, "capture file layout changed");
+static_assert(sizeof(TrafficCapture::RecordHeader) == 40, "capture file layout changed");
+
+}
@@ -0,0 +1,356 @@
+// Copyright 2021 Rainer Schoenberger
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <functional>
+#include <inttypes.h>
+#include <stdexcept>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "ConstBuffer.hpp"
+#include "Expect.hpp"
+#include "MutableBuffer.hpp"
+
+namespace PjonHL
+{
+
+enum class Endian : uint8_t
+{
+    Little,
+    Big
+};
+
+/// Field of N raw bytes (e.g. a name or an address), read as a ConstBuffer
+/// viewing the payload.
+template<size_t N>
+struct Bytes
+{
+};
+
+namespace detail
+{
+template<size_t N> struct UnsignedOfSize;
+template<> struct UnsignedOfSize<1> { using Type = uint8_t; };
+template<> struct UnsignedOfSize<2> { using Type = uint16_t; };
+template<> struct UnsignedOfSize<4> { using Type = uint32_t; };
+template<> struct UnsignedOfSize<8> { using Type = uint64_t; };
+
+/// Size and value type of a message field. Scalar fields (integers, enums,
+/// floating point) are stored with the byte order of their message.
+template<class Field>
+struct FieldTraits
+{
+    static_assert(
+            std::is_integral<Field>::value or std::is_enum<Field>::value or std::is_floating_point<Field>::value,
+            "message fields are scalars or Bytes<N>"
+            );
+    static constexpr size_t size = sizeof(Field);
+    using ValueType = Field;
+};
+
+template<size_t N>
+struct FieldTraits<Bytes<N>>
+{
+    static constexpr size_t size = N;
+    using ValueType = ConstBuffer;
+};
+}
+
+/// Compile-time layout of a message: a one byte type tag followed by the
+/// given fields without padding.
+/// Example:
+///   using Identification = MessageSchema<0x20, Endian::Little,
+///           uint8_t,     // device id
+///           Bytes<4>,    // bus id
+///           Bytes<24>>;  // device name
+/// Fields are accessed by index, e.g. MessageView<Identification>::get<0>().
+template<uint8_t Tag, Endian Order, class... Fields>
+struct MessageSchema
+{
+    static constexpr uint8_t tag = Tag;
+    static constexpr Endian byteOrder = Order;
+    static constexpr size_t fieldCount = sizeof...(Fields);
+
+    /// Offset of each field in the payload, last entry is the payload size.
+    static constexpr std::array<size_t, sizeof...(Fields) + 1> offsets = []
+        {
+            constexpr std::array<size_t, sizeof...(Fields)> sizes{detail::FieldTraits<Fields>::size...};
+            std::array<size_t, sizeof...(Fields) + 1> result{};
+            result[0] = 1;
+            for(size_t i = 0; i < sizes.size(); i++)
+            {
+                result[i + 1] = result[i] + sizes[i];
+            }
+            return result;
+        }();
+
+    /// Payload size of every message of this type.
+    static constexpr size_t size = offsets[sizeof...(Fields)];
+
+    template<size_t I>
+    using Field = std::tuple_element_t<I, std::tuple<Fields...>>;
+
+    template<size_t I>
+    using ValueType = typename detail::FieldTraits<Field<I>>::ValueType;
+
+    /// @returns true if f_payload has the size and tag of this message.
+    static constexpr bool isValid(ConstBuffer f_payload)
+    {
+        return f_payload.size() == size and f_payload.data()[0] == tag;
+    }
+
+    /// Serializes a message into f_target.
+    /// @returns number of bytes written (size).
+    /// @throws std::length_error if f_target is too small or a Bytes<N>
+    ///         value is longer than N (shorter ones are zero padded).
+    static size_t encodeInto(MutableBuffer f_target, const typename detail::FieldTraits<Fields>::ValueType & ... f_values)
+    {
+        if(f_target.size() < size)
+        {
+            throw std::length_error("buffer too small for message");
+        }
+        f_target.data()[0] = tag;
+        encodeFields(f_target.data(), std::index_sequence_for<Fields...>{}, f_values...);
+        return size;
+    }
+
+    /// Serializes a message into a new payload (the only allocation when
+    /// sending it, as the payload is moved into the bus).
+    static std::vector<uint8_t> encode(const typename detail::FieldTraits<Fields>::ValueType & ... f_values)
+    {
+        std::vector<uint8_t> payload(size);
+        encodeInto(payload, f_values...);
+        return payload;
+    }
+
+    /// Reads field I of a validated payload.
+    template<size_t I>
+    static ValueType<I> read(const uint8_t * f_payload)
+    {
+        const uint8_t * source = f_payload + offsets[I];
+        if constexpr (std::is_same<ValueType<I>, ConstBuffer>::value)
+        {
+            return ConstBuffer(source, detail::FieldTraits<Field<I>>::size);
+        }
+        else
+        {
+            return readScalar<ValueType<I>>(source);
+        }
+    }
+
+    private:
+        template<size_t... I, class... Values>
+        static void encodeFields(uint8_t * f_payload, std::index_sequence<I...>, const Values & ... f_values)
+        {
+            (writeField<I>(f_payload + offsets[I], f_values), ...);
+            (void)f_payload; // unused for messages without fields
+        }
+
+        template<size_t I>
+        static void writeField(uint8_t * f_target, const ValueType<I> & f_value)
+        {
+            if constexpr (std::is_same<ValueType<I>, ConstBuffer>::value)
+            {
+                constexpr size_t fieldSize = detail::FieldTraits<Field<I>>::size;
+                if(f_value.size() > fieldSize)
+                {
+                    throw std::length_error("value too long for Bytes field");
+                }
+                std::copy(f_value.begin(), f_value.end(), f_target);
+                std::fill(f_target + f_value.size(), f_target + fieldSize, 0);
+            }
+            else
+            {
+                writeScalar(f_target, f_value);
+            }
+        }
+
+        template<class T>
+        static void writeScalar(uint8_t * f_target, T f_value)
+        {
+            typename detail::UnsignedOfSize<sizeof(T)>::Type bits;
+            std::memcpy(&bits, &f_value, sizeof(T));
+            for(size_t i = 0; i < sizeof(T); i++)
+            {
+                size_t index = Order == Endian::Little ? i : sizeof(T) - 1 - i;
+                f_target[index] = static_cast<uint8_t>(bits >> (8 * i));
+            }
+        }
+
+        template<class T>
+        static T readScalar(const uint8_t * f_source)
+        {
+            using Bits = typename detail::UnsignedOfSize<sizeof(T)>::Type;
+            Bits bits = 0;
+            for(size_t i = 0; i < sizeof(T); i++)
+            {
+                size_t index = Order == Endian::Little ? i : sizeof(T) - 1 - i;
+                bits |= static_cast<Bits>(static_cast<Bits>(f_source[index]) << (8 * i));
+            }
+            if constexpr (std::is_same<T, bool>::value)
+            {
+                return bits != 0;
+            }
+            else
+            {
+                T value;
+                std::memcpy(&value, &bits, sizeof(T));
+                return value;
+            }
+        }
+};
+
+/// Read-only view of a validated message payload. Does not copy, the
+/// payload has to outlive the view.
+template<class Message>
+class MessageView
+{
+    public:
+        /// @returns an invalid Expect if f_payload is not a Message (size or
+        ///          tag do not match).
+        static inline Expect<MessageView> validate(ConstBuffer f_payload)
+        {
+            if(not Message::isValid(f_payload))
+            {
+                return Expect<MessageView>();
+            }
+            return Expect<MessageView>(MessageView(f_payload));
+        }
+
+        /// Decodes field I (scalars), respectively views it (Bytes<N>).
+        template<size_t I>
+        inline typename Message::template ValueType<I> get() const
+        {
+            return Message::template read<I>(m_payload.data());
+        }
+
+        /// The whole payload including the tag.
+        inline ConstBuffer bytes() const
+        {
+            return m_payload;
+        }
+
+    private:
+        explicit inline MessageView(ConstBuffer f_payload) :
+            m_payload(f_payload)
+        {
+        }
+
+        ConstBuffer m_payload;
+};
+
+/// Calls the handler registered for the type of a received payload.
+/// The handler is looked up by tag in a table built at compile time, so
+/// dispatch costs the same for any number of message types.
+template<class... Messages>
+class MessageDispatcher
+{
+    public:
+        template<class Message>
+        using Handler = std::function<void(const MessageView<Message> &)>;
+
+        /// Sets the handler of Message, replacing a previous one.
+        template<class Message>
+        inline void on(Handler<Message> f_handler)
+        {
+            std::get<indexOf<Message>()>(m_handlers) = std::move(f_handler);
+        }
+
+        /// Validates f_payload and passes it to the handler of its type.
+        /// @returns false if the payload is of unknown type, invalid or no
+        ///          handler is set for its type.
+        inline bool dispatch(ConstBuffer f_payload) const
+        {
+            if(f_payload.empty())
+            {
+                return false;
+            }
+            Entry entry = c_jumpTable[f_payload.data()[0]];
+            return entry != nullptr and entry(*this, f_payload);
+        }
+
+    private:
+        using Entry = bool (*)(const MessageDispatcher &, ConstBuffer);
+
+        template<class Message>
+        static constexpr size_t indexOf()
+        {
+            constexpr bool matches[] = {std::is_same<Message, Messages>::value..., false};
+            for(size_t i = 0; i < sizeof...(Messages); i++)
+            {
+                if(matches[i])
+                {
+                    return i;
+                }
+            }
+            return sizeof...(Messages);
+        }
+
+        static constexpr bool tagsUnique()
+        {
+            constexpr uint8_t tags[] = {Messages::tag..., 0};
+            for(size_t i = 0; i < sizeof...(Messages); i++)
+            {
+                for(size_t j = i + 1; j < sizeof...(Messages); j++)
+                {
+                    if(tags[i] == tags[j])
+                    {
+                        return false;
+                    }
+                }
+            }
+            return true;
+        }
+
+        template<size_t I>
+        static bool invoke(const MessageDispatcher & f_dispatcher, ConstBuffer f_payload)
+        {
+            using Message = std::tuple_element_t<I, std::tuple<Messages...>>;
+            const auto & handler = std::get<I>(f_dispatcher.m_handlers);
+            auto view = MessageView<Message>::validate(f_payload);
+            if(not handler or not view.isValid())
+            {
+                return false;
+            }
+            handler(view.unwrap());
+            return true;
+        }
+
+        template<size_t... I>
+        static constexpr std::array<Entry, 256> makeJumpTable(std::index_sequence<I...>)
+        {
+            static_assert(tagsUnique(), "message tags have to be unique");
+            std::array<Entry, 256> table{};
+            ((table[Messages::tag] = &invoke<I>), ...);
+            return table;
+        }
+
+        // indexed by tag, nullptr for unknown tags:
+        static const std::array<Entry, 256> c_jumpTable;
+
+        std::tuple<Handler<Messages>...> m_handlers;
+};
+
+template<class... Messages>
+const std::array<typename MessageDispatcher<Messages...>::Entry, 256> MessageDispatcher<Messages...>::c_jumpTable =
+    MessageDispatcher<Messages...>::makeJumpTable(std::index_sequence_for<Messages...>{});
+
+}
@@ -0,0 +1,547 @@
+// Copyright 2021 Rainer Schoenberger
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Microbenchmarks of PjonHL running against the mocked PJON backend (see
+// test/PjonMock.hpp), i.e. numbers reflect PjonHL overhead only, no wire time.
+//
+// Usage: PjonHLBench [--filter <substring>] [--scale <factor>] [--output <file>]
+// Results are written as JSON (to stdout by default), one entry per benchmark:
+//   name, iterations, seconds, ns_per_op, ops_per_second
+// and additional benchmark specific values (e.g. latency percentiles).
+
+#define PJON_INCLUDE_PACKET_ID 1
+#include "PjonHlBus.hpp"
+#include "AddressMatchTable.hpp"
+#include "LatencyHistogram.hpp"
+#include "PjonMock.hpp"
+
+#include <array>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace
+{
+
+using Clock = std::chrono::steady_clock;
+
+struct BenchmarkResult
+{
+    std::string name;
+    uint64_t iterations = 0;
+    double seconds = 0;
+    std::vector<std::pair<std::string, double>> values;
+};
+
+struct Options
+{
+    std::string filter;
+    double scale = 1.0;
+    std::string output;
+};
+
+Options g_options;
+std::vector<BenchmarkResult> g_results;
+
+// prevents the compiler from optimizing away benchmarked computations
+volatile uint64_t g_sink = 0;
+
+/// Only logs errors (to stderr), keeps stdout clean for JSON output.
+class ErrorLogger : public PjonHL::Logger
+{
+    public:
+        ErrorLogger()
+        {
+            setLevel(Error);
+        }
+
+        virtual void log(LogLevel f_level, std::string f_message) override
+        {
+            std::cerr << "PjonHl: " << f_message << std::endl;
+        }
+};
+
+std::unique_ptr<PjonHL::Bus<Strategy>> createBus(PjonHL::Address f_localAddress)
+{
+    shadow().reset();
+    shadow().setDefaultSendResult(true);
+    return std::make_unique<PjonHL::Bus<Strategy>>(f_localAddress, Strategy{}, PjonHL::BusConfig{}, std::make_unique<ErrorLogger>());
+}
+
+bool isSelected(const std::string & f_name)
+{
+    return g_options.filter.empty() or f_name.find(g_options.filter) != std::string::npos;
+}
+
+uint64_t scaled(uint64_t f_iterations)
+{
+    uint64_t result = static_cast<uint64_t>(f_iterations * g_options.scale);
+    return result > 0 ? result : 1;
+}
+
+void report(BenchmarkResult && f_result)
+{
+    std::cerr << f_result.name << ": " << (f_result.seconds * 1e9 / f_result.iterations) << " ns/op" << std::endl;
+    g_results.push_back(std::move(f_result));
+}
+
+void addPercentiles(BenchmarkResult & f_result, const PjonHL::LatencyHistogram::Snapshot & f_snapshot)
+{
+    f_result.values.emplace_back("p50_us", f_snapshot.p50());
+    f_result.values.emplace_back("p99_us", f_snapshot.p99());
+    f_result.values.emplace_back("p999_us", f_snapshot.p999());
+    f_result.values.emplace_back("mean_us", f_snapshot.meanMicroseconds());
+}
+
+/// Waits until f_condition returns true. Returns false on timeout.
+template<typename Condition>
+bool waitFor(Condition f_condition, std::chrono::seconds f_timeout = std::chrono::seconds(60))
+{
+    auto deadline = Clock::now() + f_timeout;
+    while(not f_condition())
+    {
+        if(Clock::now() > deadline)
+        {
+            std::cerr << "Benchmark timed out" << std::endl;
+            return false;
+        }
+        std::this_thread::yield();
+    }
+    return true;
+}
+
+double secondsSince(Clock::time_point f_start)
+{
+    return std::chrono::duration<double>(Clock::now() - f_start).count();
+}
+
+PJON_Packet_Info createPacketInfo(PjonHL::Address f_remote, PjonHL::Address f_target)
+{
+    PJON_Packet_Info info;
+    info.tx.id = f_remote.id;
+    info.rx.id = f_target.id;
+    for(size_t i = 0; i < 4; i++)
+    {
+        info.tx.bus_id[i] = f_remote.busId[i];
+        info.rx.bus_id[i] = f_target.busId[i];
+    }
+    return info;
+}
+
+// -----------------------------------------------------------------------------
+void benchSendThroughput(size_t f_producers)
+{
+    std::string name = "send_throughput/producers_" + std::to_string(f_producers);
+    if(not isSelected(name))
+    {
+        return;
+    }
+    const uint64_t packetsPerProducer = scaled(20000) / f_producers;
+
+    auto bus = createBus(PjonHL::Address{36});
+    std::vector<PjonHL::Bus<Strategy>::ConnectionHandle> connections;
+    for(size_t i = 0; i < f_producers; i++)
+    {
+        connections.push_back(bus->createConnection(PjonHL::Address{static_cast<int>(42 + i)}));
+    }
+
+    auto start = Clock::now();
+    std::vector<std::thread> producers;
+    // one sum per producer, g_sink is not thread safe:
+    std::vector<uint64_t> goodCounts(f_producers, 0);
+    for(size_t i = 0; i < f_producers; i++)
+    {
+        producers.emplace_back([&connection = connections[i], &goodCount = goodCounts[i], packetsPerProducer]
+                {
+                    std::vector<std::future<PjonHL::Result>> futures;
+                    futures.reserve(packetsPerProducer);
+                    for(uint64_t n = 0; n < packetsPerProducer; n++)
+                    {
+                        futures.push_back(connection->send(std::vector<uint8_t>(8, 0xab), 60000, false));
+                    }
+                    // summed locally, so producers do not share a cache line:
+                    uint64_t good = 0;
+                    for(auto & future : futures)
+                    {
+                        good += future.get().isGood();
+                    }
+                    goodCount = good;
+                });
+    }
+    for(auto & producer : producers)
+    {
+        producer.join();
+    }
+    for(uint64_t goodCount : goodCounts)
+    {
+        g_sink += goodCount;
+    }
+
+    BenchmarkResult result;
+    result.name = name;
+    result.seconds = secondsSince(start);
+    result.iterations = packetsPerProducer * f_producers;
+    report(std::move(result));
+}
+
+// -----------------------------------------------------------------------------
+/// Dispatches packets to one of f_connections connections.
+/// If f_wildcard is set, connections are filtering on remote busId only
+/// (masked remote id, any local address), otherwise on exact remote Address.
+void benchRxDispatch(size_t f_connections, bool f_wildcard)
+{
+    std::string name = "rx_dispatch/connections_" + std::to_string(f_connections) + (f_wildcard ? "/wildcard" : "/exact");
+    if(not isSelected(name))
+    {
+        return;
+    }
+    const uint64_t packets = scaled(20000);
+
+    PjonHL::Address local{36};
+    auto bus = createBus(local);
+    std::vector<PjonHL::Bus<Strategy>::ConnectionHandle> connections;
+    for(size_t i = 0; i < f_connections; i++)
+    {
+        if(f_wildcard)
+        {
+            PjonHL::Address remote{42};
+            remote.busId[2] = static_cast<uint8_t>(i >> 8);
+            remote.busId[3] = static_cast<uint8_t>(i);
+            connections.push_back(bus->createDetachedConnection(remote, PjonHL::Address{}, PjonHL::Address("255.255.255.255/0:0"), PjonHL::Address{0}));
+        }
+        else
+        {
+            connections.push_back(bus->createConnection(PjonHL::Address{static_cast<int>(i)}));
+        }
+    }
+    // only connection 0 matches:
+    PjonHL::Address remote = f_wildcard ? PjonHL::Address{42} : PjonHL::Address{0};
+
+    std::vector<uint8_t> payload(16, 0xab);
+    PJON_Packet_Info info = createPacketInfo(remote, local);
+    bus->pause();
+    for(uint64_t i = 0; i < packets; i++)
+    {
+        shadow().enqueuePacketForRx(payload.data(), payload.size(), info);
+    }
+    auto start = Clock::now();
+    bus->resume();
+    waitFor([&]{ return connections[0]->getMetrics().packetsReceived >= packets; });
+
+    BenchmarkResult result;
+    result.name = name;
+    result.seconds = secondsSince(start);
+    result.iterations = packets;
+    report(std::move(result));
+}
+
+// -----------------------------------------------------------------------------
+/// Dispatches packets which match all f_connections connections.
+void benchFanOut(size_t f_connections, size_t f_payloadSize)
+{
+    std::string name = "fanout/connections_" + std::to_string(f_connections) + "/payload_" + std::to_string(f_payloadSize);
+    if(not isSelected(name))
+    {
+        return;
+    }
+    const uint64_t packets = scaled(100000) / f_connections;
+
+    PjonHL::Address local{36};
+    auto bus = createBus(local);
+    std::vector<PjonHL::Bus<Strategy>::ConnectionHandle> connections;
+    for(size_t i = 0; i < f_connections; i++)
+    {
+        connections.push_back(bus->createConnection(PjonHL::Address{42}));
+    }
+
+    std::vector<uint8_t> payload(f_payloadSize, 0xab);
+    PJON_Packet_Info info = createPacketInfo(PjonHL::Address{42}, local);
+    bus->pause();
+    for(uint64_t i = 0; i < packets; i++)
+    {
+        shadow().enqueuePacketForRx(payload.data(), payload.size(), info);
+    }
+    auto start = Clock::now();
+    bus->resume();
+    waitFor([&]{ return connections.back()->getMetrics().packetsReceived >= packets; });
+
+    BenchmarkResult result;
+    result.name = name;
+    result.seconds = secondsSince(start);
+    result.iterations = packets;
+    result.values.emplace_back("ns_per_copy", result.seconds * 1e9 / (packets * f_connections));
+    report(std::move(result));
+}
+
+// -----------------------------------------------------------------------------
+template<typename Function>
+void benchLoop(const std::string & f_name, uint64_t f_iterations, Function f_function)
+{
+    if(not isSelected(f_name))
+    {
+        return;
+    }
+    const uint64_t iterations = scaled(f_iterations);
+    auto start = Clock::now();
+    for(uint64_t i = 0; i < iterations; i++)
+    {
+        f_function(i);
+    }
+    BenchmarkResult result;
+    result.name = f_name;
+    result.seconds = secondsSince(start);
+    result.iterations = iterations;
+    report(std::move(result));
+}
+
+// -----------------------------------------------------------------------------
+void benchAddress()
+{
+    const char * strings[] = {"42", "42:1337", "0.0.0.0/42", "192.168.100.200/255:65535"};
+    benchLoop("address/parse", 1000000, [&strings](uint64_t i)
+            {
+                g_sink += PjonHL::Address::parse(strings[i % 4]).address.id;
+            });
+    benchLoop("address/construct_from_string", 1000000, [&strings](uint64_t i)
+            {
+                g_sink += PjonHL::Address(strings[i % 4]).id;
+            });
+
+    PjonHL::Address addresses[] = {PjonHL::Address{42}, PjonHL::Address("1.2.3.4/42:1337"), PjonHL::Address("1.2.3.5/43:1337"), PjonHL::Address{}};
+    PjonHL::Address mask("255.255.255.255/255:0");
+    benchLoop("address/matches", 10000000, [&addresses, &mask](uint64_t i)
+            {
+                g_sink += addresses[i % 4].matches(addresses[(i >> 2) % 4], mask);
+            });
+
+    char buffer[PjonHL::Address::MaxStringLength];
+    benchLoop("address/to_chars", 1000000, [&addresses, &buffer](uint64_t i)
+            {
+                g_sink += addresses[i % 4].toChars(buffer, buffer + sizeof(buffer)) - buffer;
+            });
+    benchLoop("address/to_string", 1000000, [&addresses](uint64_t i)
+            {
+                g_sink += addresses[i % 4].toString().size();
+            });
+
+    for(size_t size : {16, 256})
+    {
+        PjonHL::AddressMatchTable table;
+        for(size_t i = 0; i < size; i++)
+        {
+            PjonHL::Address remote{42};
+            remote.busId[3] = static_cast<uint8_t>(i);
+            table.add(remote, PjonHL::Address("255.255.255.255/0:0"), PjonHL::Address{36}, PjonHL::Address::createAllOneAddress());
+        }
+        std::vector<uint32_t> matches;
+        benchLoop("address/match_table_" + std::to_string(size), 1000000, [&](uint64_t i)
+                {
+                    table.match(addresses[i % 4], PjonHL::Address{36}, matches);
+                    g_sink += matches.size();
+                });
+        benchLoop("address/match_table_scalar_" + std::to_string(size), 1000000, [&](uint64_t i)
+                {
+                    table.matchScalar(addresses[i % 4], PjonHL::Address{36}, matches);
+                    g_sink += matches.size();
+                });
+    }
+}
+
+// -----------------------------------------------------------------------------
+void benchSendLatency()
+{
+    const std::string name = "latency/send_to_future";
+    if(not isSelected(name))
+    {
+        return;
+    }
+    const uint64_t packets = scaled(5000);
+    auto bus = createBus(PjonHL::Address{36});
+    auto connection = bus->createConnection(PjonHL::Address{42});
+
+    PjonHL::LatencyHistogram histogram;
+    auto start = Clock::now();
+    for(uint64_t i = 0; i < packets; i++)
+    {
+        auto sendStart = Clock::now();
+        g_sink += connection->send(std::vector<uint8_t>(8, 0xab), 60000, false).get().isGood();
+        histogram.record(Clock::now() - sendStart);
+    }
+
+    BenchmarkResult result;
+    result.name = name;
+    result.seconds = secondsSince(start);
+    result.iterations = packets;
+    addPercentiles(result, histogram.snapshot());
+    report(std::move(result));
+}
+
+// -----------------------------------------------------------------------------
+void benchReceiveLatency(bool f_receiveInto)
+{
+    const std::string name = f_receiveInto ? "latency/rx_to_receive_into" : "latency/rx_to_receive";
+    if(not isSelected(name))
+    {
+        return;
+    }
+    const uint64_t packets = scaled(5000);
+    PjonHL::Address local{36};
+    auto bus = createBus(local);
+    auto connection = bus->createConnection(PjonHL::Address{42});
+
+    std::vector<uint8_t> payload(16, 0xab);
+    PJON_Packet_Info info = createPacketInfo(PjonHL::Address{42}, local);
+    std::array<uint8_t, 64> buffer;
+    PjonHL::LatencyHistogram histogram;
+    auto start = Clock::now();
+    for(uint64_t i = 0; i < packets; i++)
+    {
+        auto rxStart = Clock::now();
+        shadow().enqueuePacketForRx(payload.data(), payload.size(), info);
+        if(f_receiveInto)
+        {
+            g_sink += connection->receiveInto(buffer, 60000).isValid();
+        }
+        else
+        {
+            g_sink += connection->receive(60000).isValid();
+        }
+        histogram.record(Clock::now() - rxStart);
+    }
+
+    BenchmarkResult result;
+    result.name = name;
+    result.seconds = secondsSince(start);
+    result.iterations = packets;
+    addPercentiles(result, histogram.snapshot());
+    report(std::move(result));
+}
+
+// -----------------------------------------------------------------------------
+void benchPauseResume()
+{
+    const std::string name = "latency/pause_resume_send";
+    if(not isSelected(name))
+    {
+        return;
+    }
+    const uint64_t cycles = scaled(5000);
+    auto bus = createBus(PjonHL::Address{36});
+    auto connection = bus->createConnection(PjonHL::Address{42});
+
+    // one cycle: silence the bus, resume it and get a packet through:
+    PjonHL::LatencyHistogram histogram;
+    auto start = Clock::now();
+    for(uint64_t i = 0; i < cycles; i++)
+    {
+        auto cycleStart = Clock::now();
+        bus->pause();
+        bus->resume();
+        g_sink += connection->send(std::vector<uint8_t>(8, 0xab), 60000, false).get().isGood();
+        histogram.record(Clock::now() - cycleStart);
+    }
+
+    BenchmarkResult result;
+    result.name = name;
+    result.seconds = secondsSince(start);
+    result.iterations = cycles;
+    addPercentiles(result, histogram.snapshot());
+    report(std::move(result));
+}
+
+// -----------------------------------------------------------------------------
+void writeJson(std::ostream & f_output)
+{
+    f_output << std::setprecision(10);
+    f_output << "{\n  \"benchmarks\": [";
+    for(size_t i = 0; i < g_results.size(); i++)
+    {
+        const BenchmarkResult & result = g_results[i];
+        double nsPerOp = result.seconds * 1e9 / result.iterations;
+        f_output << (i == 0 ? "\n" : ",\n");
+        f_output << "    {\"name\": \"" << result.name << "\""
+                 << ", \"iterations\": " << result.iterations
+                 << ", \"seconds\": " << result.seconds
+                 << ", \"ns_per_op\": " << nsPerOp
+                 << ", \"ops_per_second\": " << (result.seconds > 0 ? result.iterations / result.seconds : 0);
+        for(const auto & value : result.values)
+        {
+            f_output << ", \"" << value.first << "\": " << value.second;
+        }
+        f_output << "}";
+    }
+    f_output << "\n  ]\n}\n";
+}
+
+}
+
+int main(int argc, char ** argv)
+{
+    for(int i = 1; i < argc; i++)
+    {
+        std::string argument = argv[i];
+        if(argument == "--filter" and i + 1 < argc)
+        {
+            g_options.filter = argv[++i];
+        }
+        else if(argument == "--scale" and i + 1 < argc)
+        {
+            g_options.scale = std::stod(argv[++i]);
+        }
+        else if(argument == "--output" and i + 1 < argc)
+        {
+            g_options.output = argv[++i];
+        }
+        else
+        {
+            std::cerr << "Usage: " << argv[0] << " [--filter <substring>] [--scale <factor>] [--output <file>]" << std::endl;
+            return 1;
+        }
+    }
+
+    benchSendThroughput(1);
+    benchSendThroughput(4);
+    for(size_t connections : {1, 16, 64, 256})
+    {
+        benchRxDispatch(connections, false);
+        benchRxDispatch(connections, true);
+    }
+    for(size_t connections : {1, 8, 32})
+    {
+        benchFanOut(connections, 16);
+        benchFanOut(connections, 256);
+    }
+    benchAddress();
+    benchSendLatency();
+    benchReceiveLatency(false);
+    benchReceiveLatency(true);
+    benchPauseResume();
+
+    if(g_options.output.empty())
+    {
+        writeJson(std::cout);
+    }
+    else
+    {
+        std::ofstream output(g_options.output);
+        writeJson(output);
+    }
+    return 0;
+}
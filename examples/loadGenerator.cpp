@@ -0,0 +1,528 @@
+// Load generator / soak test for PjonHL.
+//
+// Drives a Bus at a configurable packet rate over a number of connections and
+// reports throughput, errors (by Result message) and latency percentiles
+// (send completion and request/response round trip) for every report
+// interval and for the whole run.
+//
+// Media:
+//   --medium virtual  (default) in-process VirtualMedium wire with emulated
+//                     remote nodes, needs no hardware.
+//   --medium udp      PJON LocalUDP. Start a second instance with --respond on
+//                     the same host (loopback) or network as counterpart, one
+//                     per remote id, e.g.:
+//                       loadGenerator --medium udp --respond --local-id 10
+//                       loadGenerator --medium udp --request-response
+//
+// Exit code is 0 if all packets were sent successfully, 2 otherwise.
+//
+// Run with --help for all options.
+
+// Include only LocalUDP
+#define PJON_INCLUDE_LUDP true
+
+#include <PJON.h>
+#include "strategies/LocalUDP/LocalUDP.h"
+#include "PjonHlBus.hpp"
+#include "LatencyHistogram.hpp"
+#include "strategies/VirtualMedium.hpp"
+#include "strategies/VirtualRemoteNode.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace
+{
+
+using Clock = std::chrono::steady_clock;
+
+struct Options
+{
+    std::string medium = "virtual";
+    bool respond = false;
+    double rate = 100;
+    uint32_t connections = 1;
+    std::string payload = "fixed:16";
+    bool requestResponse = false;
+    double durationSeconds = 10;
+    double reportIntervalSeconds = 1;
+    uint32_t timeoutMilliseconds = 1000;
+    bool retransmit = true;
+    uint8_t localId = 1;
+    uint8_t remoteBaseId = 10;
+    uint16_t udpPort = 7100;
+    PjonHL::VirtualWire::Config wire;
+};
+
+void printUsage(const char * f_name)
+{
+    std::cout <<
+        "Usage: " << f_name << " [options]\n"
+        "  --medium virtual|udp     medium to use (default virtual)\n"
+        "  --respond                (udp) act as counterpart: ACK and echo everything\n"
+        "  --rate <packets/s>       target packet rate over all connections (default 100)\n"
+        "  --connections <n>        number of connections/remotes (default 1)\n"
+        "  --payload <dist>         payload size distribution (default fixed:16)\n"
+        "                             fixed:<n> | uniform:<min>-<max> | choice:<n>,<n>,...\n"
+        "  --request-response       expect an echo for each packet and measure round trip\n"
+        "  --duration <s>           test duration in seconds (default 10)\n"
+        "  --interval <s>           report interval in seconds (default 1)\n"
+        "  --timeout <ms>           send timeout (default 1000)\n"
+        "  --no-retransmit          disable PjonHL retransmissions\n"
+        "  --local-id <id>          local device id (default 1)\n"
+        "  --remote-id <id>         device id of first remote, others follow (default 10)\n"
+        "  --udp-port <port>        (udp) LocalUDP port (default 7100)\n"
+        "  --baud <bits/s>          (virtual) baud rate, 0 = unlimited (default 115200)\n"
+        "  --loss <p>               (virtual) frame loss probability\n"
+        "  --bit-errors <p>         (virtual) bit error rate\n"
+        "  --propagation-delay <us> (virtual) propagation delay\n";
+}
+
+bool parseOptions(int argc, char ** argv, Options & f_options)
+{
+    for(int i = 1; i < argc; i++)
+    {
+        std::string argument = argv[i];
+        auto value = [&]() -> std::string
+            {
+                if(i + 1 >= argc)
+                {
+                    throw std::invalid_argument("missing value for " + argument);
+                }
+                return argv[++i];
+            };
+        // checked before narrowing, so out of range values do not wrap:
+        auto number = [&](unsigned long f_min, unsigned long f_max) -> unsigned long
+            {
+                std::string text = value();
+                unsigned long parsed = std::stoul(text);
+                // stoul() also accepts (and wraps) negative numbers:
+                if(text.find('-') != std::string::npos or parsed < f_min or parsed > f_max)
+                {
+                    throw std::out_of_range(
+                            "value of " + argument + " out of range (" +
+                            std::to_string(f_min) + ".." + std::to_string(f_max) + "): " + text
+                            );
+                }
+                return parsed;
+            };
+        if(argument == "--medium") f_options.medium = value();
+        else if(argument == "--respond") f_options.respond = true;
+        else if(argument == "--rate") f_options.rate = std::stod(value());
+        else if(argument == "--connections") f_options.connections = number(1, 199);
+        else if(argument == "--payload") f_options.payload = value();
+        else if(argument == "--request-response") f_options.requestResponse = true;
+        else if(argument == "--duration") f_options.durationSeconds = std::stod(value());
+        else if(argument == "--interval") f_options.reportIntervalSeconds = std::stod(value());
+        else if(argument == "--timeout") f_options.timeoutMilliseconds = number(0, UINT32_MAX);
+        else if(argument == "--no-retransmit") f_options.retransmit = false;
+        else if(argument == "--local-id") f_options.localId = number(1, 254);
+        else if(argument == "--remote-id") f_options.remoteBaseId = number(1, 254);
+        else if(argument == "--udp-port") f_options.udpPort = number(1, UINT16_MAX);
+        else if(argument == "--baud") f_options.wire.baudRate = number(0, UINT32_MAX);
+        else if(argument == "--loss") f_options.wire.lossRate = std::stod(value());
+        else if(argument == "--bit-errors") f_options.wire.bitErrorRate = std::stod(value());
+        else if(argument == "--propagation-delay") f_options.wire.propagationDelayMicroseconds = number(0, UINT32_MAX);
+        else
+        {
+            return false;
+        }
+    }
+    // all remote ids have to be valid device ids (1..254):
+    return
+        f_options.rate > 0 and
+        f_options.remoteBaseId + f_options.connections - 1 <= 254;
+}
+
+/// Random payload sizes following the distribution given on command line.
+class PayloadSizes
+{
+    public:
+        explicit PayloadSizes(const std::string & f_spec)
+        {
+            auto colon = f_spec.find(':');
+            std::string kind = f_spec.substr(0, colon);
+            std::string arguments = colon == std::string::npos ? "" : f_spec.substr(colon + 1);
+            if(kind == "fixed")
+            {
+                m_min = m_max = std::stoul(arguments);
+            }
+            else if(kind == "uniform")
+            {
+                auto dash = arguments.find('-');
+                m_min = std::stoul(arguments.substr(0, dash));
+                m_max = std::stoul(arguments.substr(dash + 1));
+            }
+            else if(kind == "choice")
+            {
+                std::stringstream stream(arguments);
+                std::string item;
+                while(std::getline(stream, item, ','))
+                {
+                    m_choices.push_back(std::stoul(item));
+                }
+            }
+            else
+            {
+                throw std::invalid_argument("invalid payload distribution: " + f_spec);
+            }
+        }
+
+        size_t next()
+        {
+            if(not m_choices.empty())
+            {
+                return m_choices[std::uniform_int_distribution<size_t>(0, m_choices.size() - 1)(m_random)];
+            }
+            return std::uniform_int_distribution<size_t>(m_min, m_max)(m_random);
+        }
+
+    private:
+        size_t m_min = 0;
+        size_t m_max = 0;
+        std::vector<size_t> m_choices;
+        std::minstd_rand m_random{42};
+};
+
+/// Counters and histograms of one report interval (or the whole run).
+struct Statistics
+{
+    uint64_t sent = 0;
+    uint64_t sentBytes = 0;
+    uint64_t succeeded = 0;
+    uint64_t failed = 0;
+    uint64_t responses = 0;
+    std::map<std::string, uint64_t> errors;
+    PjonHL::LatencyHistogram completion;
+    PjonHL::LatencyHistogram roundTrip;
+
+    void reset()
+    {
+        sent = sentBytes = succeeded = failed = responses = 0;
+        errors.clear();
+        completion.reset();
+        roundTrip.reset();
+    }
+};
+
+void printHistogram(const char * f_name, const PjonHL::LatencyHistogram & f_histogram)
+{
+    auto snapshot = f_histogram.snapshot();
+    std::cout << " " << f_name << "_us[p50/p99/p999]=" << snapshot.p50() << "/" << snapshot.p99() << "/" << snapshot.p999();
+}
+
+void printStatistics(const char * f_label, double f_seconds, const Statistics & f_statistics, bool f_requestResponse)
+{
+    std::cout << f_label
+        << " sent=" << f_statistics.sent
+        << " ok=" << f_statistics.succeeded
+        << " failed=" << f_statistics.failed
+        << " tx_pps=" << static_cast<uint64_t>(f_statistics.succeeded / f_seconds)
+        << " tx_Bps=" << static_cast<uint64_t>(f_statistics.sentBytes / f_seconds);
+    printHistogram("completion", f_statistics.completion);
+    if(f_requestResponse)
+    {
+        std::cout << " responses=" << f_statistics.responses;
+        printHistogram("rtt", f_statistics.roundTrip);
+    }
+    std::cout << std::endl;
+    for(const auto & error : f_statistics.errors)
+    {
+        std::cout << "    error \"" << error.first << "\": " << error.second << std::endl;
+    }
+}
+
+template<class Strategy>
+int runLoad(PjonHL::Bus<Strategy> & f_bus, const Options & f_options)
+{
+    using Connection = typename PjonHL::Bus<Strategy>::ConnectionHandle;
+    std::vector<Connection> connections;
+    for(uint32_t i = 0; i < f_options.connections; i++)
+    {
+        connections.push_back(f_bus.createConnection(PjonHL::Address{static_cast<int>(f_options.remoteBaseId + i)}));
+    }
+
+    PayloadSizes payloadSizes(f_options.payload);
+    std::mutex statisticsMutex;
+    Statistics interval;
+    Statistics total;
+    auto record = [&](auto f_function)
+        {
+            std::lock_guard<std::mutex> guard(statisticsMutex);
+            f_function(interval);
+            f_function(total);
+        };
+
+    // send times of requests waiting for a response, by sequence number:
+    std::mutex pendingMutex;
+    std::unordered_map<uint64_t, Clock::time_point> pendingResponses;
+
+    struct InFlight
+    {
+        Clock::time_point sendTime;
+        std::future<PjonHL::Result> result;
+    };
+    std::mutex inFlightMutex;
+    std::condition_variable inFlightCondition;
+    std::deque<InFlight> inFlight;
+    std::atomic<bool> generating{true};
+
+    // completions are reported in order, as PjonHL sends one packet at a time:
+    std::thread completionThread([&]
+        {
+            while(true)
+            {
+                InFlight entry;
+                {
+                    std::unique_lock<std::mutex> lock(inFlightMutex);
+                    inFlightCondition.wait(lock, [&]{ return not inFlight.empty() or not generating; });
+                    if(inFlight.empty())
+                    {
+                        return;
+                    }
+                    entry = std::move(inFlight.front());
+                    inFlight.pop_front();
+                }
+                PjonHL::Result result = entry.result.get();
+                auto latency = Clock::now() - entry.sendTime;
+                record([&](Statistics & f_statistics)
+                    {
+                        if(result.isGood())
+                        {
+                            f_statistics.succeeded++;
+                            f_statistics.completion.record(latency);
+                        }
+                        else
+                        {
+                            f_statistics.failed++;
+                            std::string message = result.getErrorMessage();
+                            f_statistics.errors[message.empty() ? "<no message>" : message]++;
+                        }
+                    });
+            }
+        });
+
+    std::atomic<bool> receiving{true};
+    std::vector<std::thread> receiveThreads;
+    if(f_options.requestResponse)
+    {
+        for(auto & connection : connections)
+        {
+            receiveThreads.emplace_back([&, connectionPtr = connection.get()]
+                {
+                    while(receiving)
+                    {
+                        // polling, as a blocking receive() would also block
+                        // send() on the same connection while waiting:
+                        auto packet = connectionPtr->receive(0);
+                        if(not packet.isValid())
+                        {
+                            std::this_thread::sleep_for(std::chrono::microseconds(200));
+                            continue;
+                        }
+                        if(packet.unwrap().payload.size() < sizeof(uint64_t))
+                        {
+                            continue;
+                        }
+                        uint64_t sequence;
+                        std::memcpy(&sequence, packet.unwrap().payload.data(), sizeof(sequence));
+                        Clock::time_point sendTime;
+                        {
+                            std::lock_guard<std::mutex> guard(pendingMutex);
+                            auto pending = pendingResponses.find(sequence);
+                            if(pending == pendingResponses.end())
+                            {
+                                continue;
+                            }
+                            sendTime = pending->second;
+                            pendingResponses.erase(pending);
+                        }
+                        auto latency = Clock::now() - sendTime;
+                        record([&](Statistics & f_statistics)
+                            {
+                                f_statistics.responses++;
+                                f_statistics.roundTrip.record(latency);
+                            });
+                    }
+                });
+        }
+    }
+
+    std::cout << "Generating load: " << f_options.rate << " packets/s over " << f_options.connections
+        << " connection(s) for " << f_options.durationSeconds << "s" << std::endl;
+
+    auto start = Clock::now();
+    auto end = start + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(f_options.durationSeconds));
+    auto reportInterval = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(f_options.reportIntervalSeconds));
+    auto nextReport = start + reportInterval;
+    auto lastReport = start;
+    uint64_t sequence = 0;
+    while(true)
+    {
+        auto sendTime = start + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(sequence / f_options.rate));
+        auto now = Clock::now();
+        if(nextReport <= sendTime or sendTime >= end)
+        {
+            std::this_thread::sleep_until(std::min(nextReport, end));
+            now = Clock::now();
+            std::lock_guard<std::mutex> guard(statisticsMutex);
+            double seconds = std::chrono::duration<double>(now - lastReport).count();
+            char label[32];
+            std::snprintf(label, sizeof(label), "[%.1fs]", std::chrono::duration<double>(now - start).count());
+            printStatistics(label, seconds, interval, f_options.requestResponse);
+            interval.reset();
+            lastReport = now;
+            nextReport += reportInterval;
+            if(now >= end)
+            {
+                break;
+            }
+            continue;
+        }
+        std::this_thread::sleep_until(sendTime);
+
+        std::vector<uint8_t> payload(payloadSizes.next());
+        if(f_options.requestResponse)
+        {
+            payload.resize(std::max(payload.size(), sizeof(sequence)));
+            std::memcpy(payload.data(), &sequence, sizeof(sequence));
+            std::lock_guard<std::mutex> guard(pendingMutex);
+            pendingResponses[sequence] = Clock::now();
+        }
+        size_t payloadSize = payload.size();
+        InFlight entry;
+        entry.sendTime = Clock::now();
+        entry.result = connections[sequence % connections.size()]->send(std::move(payload), f_options.timeoutMilliseconds, f_options.retransmit);
+        record([&](Statistics & f_statistics)
+            {
+                f_statistics.sent++;
+                f_statistics.sentBytes += payloadSize;
+            });
+        {
+            std::lock_guard<std::mutex> guard(inFlightMutex);
+            inFlight.push_back(std::move(entry));
+        }
+        inFlightCondition.notify_one();
+        sequence++;
+    }
+
+    double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+    // let outstanding packets complete:
+    {
+        std::lock_guard<std::mutex> guard(inFlightMutex);
+        generating = false;
+    }
+    inFlightCondition.notify_one();
+    completionThread.join();
+    std::this_thread::sleep_for(std::chrono::milliseconds(f_options.timeoutMilliseconds));
+    receiving = false;
+    for(auto & thread : receiveThreads)
+    {
+        thread.join();
+    }
+
+    std::cout << "Summary:" << std::endl;
+    printStatistics("[total]", seconds, total, f_options.requestResponse);
+    if(f_options.requestResponse)
+    {
+        std::cout << "  missing responses=" << pendingResponses.size() << std::endl;
+    }
+    auto metrics = f_bus.getMetrics();
+    std::cout << "  bus: retransmissions=" << metrics.retransmissions
+        << " rx_unmatched=" << metrics.packetsUnmatched
+        << " tx_queue_peak=" << metrics.txQueueDepth.peak << std::endl;
+    return total.failed == 0 ? 0 : 2;
+}
+
+template<class Strategy>
+int respond(PjonHL::Bus<Strategy> & f_bus, const Options & f_options)
+{
+    // any remote, any local address:
+    auto connection = f_bus.createDetachedConnection(PjonHL::Address{}, PjonHL::Address{}, PjonHL::Address{0}, PjonHL::Address{0});
+    std::cout << "Responding to all packets addressed to " << static_cast<int>(f_options.localId) << " (Ctrl+C to stop)" << std::endl;
+    uint64_t count = 0;
+    while(true)
+    {
+        auto packet = connection->receive(1000);
+        if(packet.isValid() and packet.unwrap().targetAddress.id == f_options.localId)
+        {
+            f_bus.send(packet.unwrap().targetAddress, packet.unwrap().remoteAddress, packet.unwrap().payload, f_options.timeoutMilliseconds, f_options.retransmit);
+            if(++count % 1000 == 0)
+            {
+                std::cout << "  echoed " << count << " packets" << std::endl;
+            }
+        }
+    }
+}
+
+}
+
+int main(int argc, char ** argv)
+{
+    Options options;
+    try
+    {
+        if(not parseOptions(argc, argv, options))
+        {
+            printUsage(argv[0]);
+            return 1;
+        }
+        PayloadSizes check(options.payload);
+    }
+    catch(const std::exception & f_exception)
+    {
+        std::cout << f_exception.what() << std::endl;
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    auto logger = std::make_unique<PjonHL::DefaultLogger>();
+    logger->setLevel(PjonHL::Logger::Info);
+
+    if(options.medium == "virtual")
+    {
+        auto wire = std::make_shared<PjonHL::VirtualWire>(options.wire);
+        std::vector<std::unique_ptr<PjonHL::VirtualRemoteNode>> nodes;
+        for(uint32_t i = 0; i < options.connections; i++)
+        {
+            nodes.push_back(std::make_unique<PjonHL::VirtualRemoteNode>(
+                        wire,
+                        PjonHL::Address{static_cast<int>(options.remoteBaseId + i)},
+                        options.requestResponse ? PjonHL::VirtualRemoteNode::echo() : PjonHL::VirtualRemoteNode::ackOnly()
+                        ));
+        }
+        PjonHL::Bus<PjonHL::VirtualMedium> bus(PjonHL::Address{options.localId}, PjonHL::VirtualMedium(wire), PjonHL::BusConfig{}, std::move(logger));
+        int result = runLoad(bus, options);
+        auto statistics = wire->getStatistics();
+        std::cout << "  wire: transmissions=" << statistics.transmissions
+            << " collisions=" << statistics.collisions
+            << " lost=" << statistics.lostDeliveries
+            << " corrupted=" << statistics.corruptedDeliveries << std::endl;
+        return result;
+    }
+    else if(options.medium == "udp")
+    {
+        LocalUDP udpStrategy;
+        udpStrategy.set_port(options.udpPort);
+        PjonHL::Bus<LocalUDP> bus(PjonHL::Address{options.localId}, udpStrategy, PjonHL::BusConfig{}, std::move(logger));
+        return options.respond ? respond(bus, options) : runLoad(bus, options);
+    }
+    printUsage(argv[0]);
+    return 1;
+}
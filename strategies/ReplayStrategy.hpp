@@ -0,0 +1,668 @@
+// Copyright 2021 Rainer Schoenberger
+// 
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+// 
+//     http://www.apache.org/licenses/LICENSE-2.0
+// 
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <fstream>
+#include <inttypes.h>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "PJONDefines.h"
+
+namespace PjonHL
+{
+
+/// A recorded sequence of PJON frames (as seen by a strategy, i.e. including
+/// PJON header and CRC).
+///
+/// File format (compact, all multi byte integers are unsigned LEB128
+/// varints):
+///
+///   magic "PJHLTRC\0" (8 bytes)
+///   version (1 byte, currently 1)
+///   records until end of file, each:
+///     direction (1 byte, 0 = frame received, 1 = frame transmitted)
+///     time since previous record in microseconds (varint)
+///     frame length (varint)
+///     frame (length bytes)
+struct ReplayTrace
+{
+    enum class Direction : uint8_t
+    {
+        Rx = 0,
+        Tx = 1
+    };
+
+    struct Frame
+    {
+        Direction direction;
+        /// Time since start of the recording.
+        std::chrono::microseconds time;
+        std::vector<uint8_t> data;
+    };
+
+    static constexpr char Magic[8] = {'P', 'J', 'H', 'L', 'T', 'R', 'C', '\0'};
+    static constexpr uint8_t Version = 1;
+
+    std::vector<Frame> frames;
+
+    /// Appends a frame f_time after start of the recording.
+    inline void add(Direction f_direction, std::chrono::microseconds f_time, std::vector<uint8_t> f_data)
+    {
+        frames.push_back(Frame{f_direction, f_time, std::move(f_data)});
+    }
+
+    /// @throws std::runtime_error if the file can not be read or is invalid.
+    static inline ReplayTrace load(const std::string & f_path)
+    {
+        std::ifstream file(f_path, std::ios::binary);
+        if(not file)
+        {
+            throw std::runtime_error("Could not open trace file " + f_path);
+        }
+        std::vector<uint8_t> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+        if(data.size() < sizeof(Magic) + 1 or std::memcmp(data.data(), Magic, sizeof(Magic)) != 0 or data[sizeof(Magic)] != Version)
+        {
+            throw std::runtime_error("Not a trace file or unsupported version: " + f_path);
+        }
+
+        ReplayTrace trace;
+        size_t position = sizeof(Magic) + 1;
+        uint64_t time = 0;
+        while(position < data.size())
+        {
+            uint8_t direction = data[position++];
+            uint64_t delta;
+            uint64_t length;
+            if(
+                direction > static_cast<uint8_t>(Direction::Tx)
+                or not readVarint(data, position, delta)
+                or not readVarint(data, position, length)
+                or length > data.size() - position
+              )
+            {
+                throw std::runtime_error("Truncated or corrupt trace file: " + f_path);
+            }
+            time += delta;
+            trace.add(
+                    static_cast<Direction>(direction),
+                    std::chrono::microseconds(time),
+                    std::vector<uint8_t>(data.begin() + position, data.begin() + position + length)
+                    );
+            position += length;
+        }
+        return trace;
+    }
+
+    /// @throws std::runtime_error if the file can not be written.
+    inline void save(const std::string & f_path) const
+    {
+        std::ofstream file(f_path, std::ios::binary | std::ios::trunc);
+        writeHeader(file);
+        std::chrono::microseconds previous(0);
+        for(const auto & frame : frames)
+        {
+            writeRecord(file, frame.direction, frame.time - previous, frame.data.data(), frame.data.size());
+            previous = frame.time;
+        }
+        file.flush();
+        if(not file)
+        {
+            throw std::runtime_error("Could not write trace file " + f_path);
+        }
+    }
+
+    static inline void writeHeader(std::ostream & f_stream)
+    {
+        f_stream.write(Magic, sizeof(Magic));
+        f_stream.put(static_cast<char>(Version));
+    }
+
+    static inline void writeRecord(std::ostream & f_stream, Direction f_direction, std::chrono::microseconds f_delta, const uint8_t * f_data, uint16_t f_length)
+    {
+        // 1 byte direction + 2 * max. 10 bytes varint:
+        uint8_t header[21];
+        size_t length = 0;
+        header[length++] = static_cast<uint8_t>(f_direction);
+        length = writeVarint(header, length, static_cast<uint64_t>(std::max<int64_t>(f_delta.count(), 0)));
+        length = writeVarint(header, length, f_length);
+        f_stream.write(reinterpret_cast<const char*>(header), length);
+        f_stream.write(reinterpret_cast<const char*>(f_data), f_length);
+    }
+
+    private:
+        static inline size_t writeVarint(uint8_t * f_buffer, size_t f_position, uint64_t f_value)
+        {
+            while(f_value >= 0x80)
+            {
+                f_buffer[f_position++] = static_cast<uint8_t>(f_value) | 0x80;
+                f_value >>= 7;
+            }
+            f_buffer[f_position++] = static_cast<uint8_t>(f_value);
+            return f_position;
+        }
+
+        static inline bool readVarint(const std::vector<uint8_t> & f_data, size_t & f_position, uint64_t & f_value)
+        {
+            f_value = 0;
+            for(unsigned shift = 0; shift < 64 and f_position < f_data.size(); shift += 7)
+            {
+                uint8_t byte = f_data[f_position++];
+                f_value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+                if((byte & 0x80) == 0)
+                {
+                    return true;
+                }
+            }
+            return false;
+        }
+};
+
+/// Writes frames to a trace file while they happen. Used by
+/// RecordingStrategy. Thread safe.
+class TraceWriter
+{
+    public:
+        /// @throws std::runtime_error if the file can not be created.
+        inline explicit TraceWriter(const std::string & f_path) :
+            m_file(f_path, std::ios::binary | std::ios::trunc),
+            m_previous(std::chrono::steady_clock::now())
+        {
+            if(not m_file)
+            {
+                throw std::runtime_error("Could not open trace file " + f_path);
+            }
+            ReplayTrace::writeHeader(m_file);
+        }
+
+        inline void write(ReplayTrace::Direction f_direction, const uint8_t * f_data, uint16_t f_length)
+        {
+            std::lock_guard<std::mutex> guard(m_mutex);
+            auto now = std::chrono::steady_clock::now();
+            ReplayTrace::writeRecord(m_file, f_direction, std::chrono::duration_cast<std::chrono::microseconds>(now - m_previous), f_data, f_length);
+            // accumulate rounding errors in the next delta instead of losing them:
+            m_previous += std::chrono::duration_cast<std::chrono::microseconds>(now - m_previous);
+        }
+
+        inline void flush()
+        {
+            std::lock_guard<std::mutex> guard(m_mutex);
+            m_file.flush();
+        }
+
+    private:
+        std::mutex m_mutex;
+        std::ofstream m_file;
+        std::chrono::steady_clock::time_point m_previous;
+};
+
+/// Wraps a PJON strategy and records all frames it receives and transmits
+/// into a trace file, e.g. to record production traffic for replaying it
+/// later with ReplayStrategy:
+///   auto writer = std::make_shared<TraceWriter>("traffic.trace");
+///   Bus<RecordingStrategy<ThroughSerial>> bus(address, RecordingStrategy<ThroughSerial>(serial, writer));
+template<class Strategy>
+class RecordingStrategy
+{
+    public:
+        RecordingStrategy() = default;
+
+        inline RecordingStrategy(Strategy f_strategy, std::shared_ptr<TraceWriter> f_writer) :
+            m_strategy(std::move(f_strategy)),
+            m_writer(std::move(f_writer))
+        {
+        }
+
+        inline Strategy & getStrategy()
+        {
+            return m_strategy;
+        }
+
+        // PJON strategy interface:
+
+        inline uint32_t back_off(uint8_t f_attempts)
+        {
+            return m_strategy.back_off(f_attempts);
+        }
+
+        inline bool begin(uint8_t f_deviceId = 0)
+        {
+            return m_strategy.begin(f_deviceId);
+        }
+
+        inline bool can_start()
+        {
+            return m_strategy.can_start();
+        }
+
+        inline uint8_t get_max_attempts()
+        {
+            return m_strategy.get_max_attempts();
+        }
+
+        inline uint16_t get_receive_time()
+        {
+            return m_strategy.get_receive_time();
+        }
+
+        inline void handle_collision()
+        {
+            m_strategy.handle_collision();
+        }
+
+        inline uint16_t receive_frame(uint8_t * f_data, uint16_t f_maxLength)
+        {
+            uint16_t length = m_strategy.receive_frame(f_data, f_maxLength);
+            if(m_writer and length != PJON_FAIL and length > 0)
+            {
+                m_writer->write(ReplayTrace::Direction::Rx, f_data, length);
+            }
+            return length;
+        }
+
+        inline uint16_t receive_response()
+        {
+            return m_strategy.receive_response();
+        }
+
+        inline void send_response(uint8_t f_response)
+        {
+            m_strategy.send_response(f_response);
+        }
+
+        inline void send_frame(uint8_t * f_data, uint16_t f_length)
+        {
+            if(m_writer)
+            {
+                m_writer->write(ReplayTrace::Direction::Tx, f_data, f_length);
+            }
+            m_strategy.send_frame(f_data, f_length);
+        }
+
+    private:
+        Strategy m_strategy;
+        std::shared_ptr<TraceWriter> m_writer;
+};
+
+/// Configuration of a ReplaySession.
+struct ReplayConfig
+{
+    enum class Timing
+    {
+        /// Frames are injected with the time offsets they were recorded with.
+        Original,
+        /// Time offsets are divided by speedUp.
+        SpeedUp,
+        /// Frames are injected whenever PJON polls for one.
+        AsFastAsPossible
+    };
+    Timing timing = Timing::Original;
+    double speedUp = 1.0;
+    /// Answer frames transmitted by PJON with an ACK (otherwise sending
+    /// fails if an ACK is requested).
+    bool acknowledge = true;
+    /// Start replaying with the first poll of the strategy. Otherwise
+    /// ReplaySession::start() has to be called, e.g. after all connections
+    /// consuming the replayed packets were created.
+    bool autoStart = true;
+};
+
+/// Shared state of a replay: injects the received (Rx) frames of a trace and
+/// collects frames transmitted during replay, which can be compared to the
+/// transmitted (Tx) frames of the trace afterwards.
+/// Replay starts with the first poll of ReplayStrategy (i.e. when the Bus
+/// starts) or with start() (see ReplayConfig::autoStart). Thread safe.
+class ReplaySession
+{
+    public:
+        using Clock = std::chrono::steady_clock;
+        using Config = ReplayConfig;
+
+        struct Statistics
+        {
+            uint64_t framesInjected = 0;
+            uint64_t bytesInjected = 0;
+            /// Frames of the trace larger than the receive buffer of PJON.
+            uint64_t framesDropped = 0;
+            uint64_t framesTransmitted = 0;
+            /// Time from start of replay until the last frame was injected
+            /// (or until now, if not yet finished).
+            Clock::duration duration{0};
+        };
+
+        /// Result of comparing transmitted frames to the expectations of the
+        /// trace (in order).
+        struct Comparison
+        {
+            uint64_t matched = 0;
+            uint64_t mismatched = 0;
+            /// Expected frames which were not transmitted.
+            uint64_t missing = 0;
+            /// Transmitted frames exceeding the expected ones.
+            uint64_t unexpected = 0;
+            /// Index of the first transmitted frame differing from the trace.
+            /// Only valid if not isEqual().
+            size_t firstDifference = 0;
+
+            inline bool isEqual() const
+            {
+                return mismatched == 0 and missing == 0 and unexpected == 0;
+            }
+        };
+
+        inline explicit ReplaySession(ReplayTrace f_trace, Config f_config = Config{}) :
+            m_config(f_config)
+        {
+            for(auto & frame : f_trace.frames)
+            {
+                if(frame.direction == ReplayTrace::Direction::Rx)
+                {
+                    m_rxFrames.push_back(std::move(frame));
+                }
+                else
+                {
+                    m_expectedTxFrames.push_back(std::move(frame.data));
+                }
+            }
+        }
+
+        inline const Config & getConfig() const
+        {
+            return m_config;
+        }
+
+        /// Starts replaying, timing of the trace is relative to this call.
+        /// Has no effect if already started.
+        inline void start()
+        {
+            std::lock_guard<std::mutex> guard(m_mutex);
+            startLocked();
+        }
+
+        /// Writes the next due frame to f_data.
+        /// @param f_frameStart if given, set to the time the frame was due.
+        /// @returns length of the frame or PJON_FAIL if no frame is due.
+        inline uint16_t nextFrame(uint8_t * f_data, uint16_t f_maxLength, Clock::time_point * f_frameStart = nullptr)
+        {
+            std::lock_guard<std::mutex> guard(m_mutex);
+            if(m_config.autoStart)
+            {
+                startLocked();
+            }
+            auto now = Clock::now();
+            if(not m_started or m_nextFrame >= m_rxFrames.size())
+            {
+                return PJON_FAIL;
+            }
+            const auto & frame = m_rxFrames[m_nextFrame];
+            auto dueTime = getDueTime(frame);
+            if(now < dueTime)
+            {
+                return PJON_FAIL;
+            }
+            if(f_frameStart)
+            {
+                *f_frameStart = m_config.timing == Config::Timing::AsFastAsPossible ? now : dueTime;
+            }
+            // frames which do not fit are dropped (PJON would not accept them
+            // either):
+            uint16_t length = frame.data.size() <= f_maxLength ? frame.data.size() : 0;
+            std::copy(frame.data.begin(), frame.data.begin() + length, f_data);
+            m_nextFrame++;
+            if(length > 0)
+            {
+                m_statistics.framesInjected++;
+                m_statistics.bytesInjected += length;
+            }
+            else
+            {
+                m_statistics.framesDropped++;
+            }
+            if(m_nextFrame == m_rxFrames.size())
+            {
+                m_endTime = now;
+                m_finishedCondition.notify_all();
+            }
+            return length > 0 ? length : PJON_FAIL;
+        }
+
+        /// Collects a frame transmitted during replay.
+        inline void transmitted(const uint8_t * f_data, uint16_t f_length)
+        {
+            std::lock_guard<std::mutex> guard(m_mutex);
+            m_txFrames.emplace_back(f_data, f_data + f_length);
+            m_statistics.framesTransmitted++;
+        }
+
+        /// @returns true if all frames of the trace were injected (or
+        ///          dropped).
+        inline bool isFinished() const
+        {
+            std::lock_guard<std::mutex> guard(m_mutex);
+            return isFinishedLocked();
+        }
+
+        /// Blocks until all frames were injected or f_timeout elapsed.
+        /// @returns isFinished()
+        inline bool waitUntilFinished(Clock::duration f_timeout) const
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            return m_finishedCondition.wait_for(lock, f_timeout, [this]{ return isFinishedLocked(); });
+        }
+
+        inline Statistics getStatistics() const
+        {
+            std::lock_guard<std::mutex> guard(m_mutex);
+            Statistics statistics = m_statistics;
+            if(m_started)
+            {
+                statistics.duration = (isFinishedLocked() ? m_endTime : Clock::now()) - m_startTime;
+            }
+            return statistics;
+        }
+
+        inline std::vector<std::vector<uint8_t>> getTransmittedFrames() const
+        {
+            std::lock_guard<std::mutex> guard(m_mutex);
+            return m_txFrames;
+        }
+
+        /// Compares frames transmitted so far to the transmitted frames of
+        /// the trace. Frames are compared byte by byte, so the Bus has to use
+        /// the same configuration (ACK, CRC, packet IDs, ...) as during
+        /// recording.
+        inline Comparison compare() const
+        {
+            std::lock_guard<std::mutex> guard(m_mutex);
+            Comparison result;
+            size_t common = std::min(m_txFrames.size(), m_expectedTxFrames.size());
+            bool foundDifference = false;
+            for(size_t i = 0; i < common; i++)
+            {
+                if(m_txFrames[i] == m_expectedTxFrames[i])
+                {
+                    result.matched++;
+                    continue;
+                }
+                result.mismatched++;
+                if(not foundDifference)
+                {
+                    foundDifference = true;
+                    result.firstDifference = i;
+                }
+            }
+            result.missing = m_expectedTxFrames.size() - common;
+            result.unexpected = m_txFrames.size() - common;
+            if(not foundDifference)
+            {
+                result.firstDifference = common;
+            }
+            return result;
+        }
+
+    private:
+        /// Only to be called with m_mutex locked.
+        inline bool isFinishedLocked() const
+        {
+            return m_started and m_nextFrame >= m_rxFrames.size();
+        }
+
+        /// Only to be called with m_mutex locked.
+        inline void startLocked()
+        {
+            if(not m_started)
+            {
+                m_started = true;
+                m_startTime = Clock::now();
+                if(m_rxFrames.empty())
+                {
+                    m_endTime = m_startTime;
+                    m_finishedCondition.notify_all();
+                }
+            }
+        }
+
+        /// Only to be called with m_mutex locked.
+        inline Clock::time_point getDueTime(const ReplayTrace::Frame & f_frame) const
+        {
+            switch(m_config.timing)
+            {
+                case Config::Timing::Original:
+                    return m_startTime + f_frame.time;
+                case Config::Timing::SpeedUp:
+                    return m_startTime + std::chrono::duration_cast<Clock::duration>(
+                            std::chrono::duration<double, std::micro>(f_frame.time.count() / m_config.speedUp)
+                            );
+                case Config::Timing::AsFastAsPossible:
+                default:
+                    return m_startTime;
+            }
+        }
+
+        const Config m_config;
+
+        mutable std::mutex m_mutex;
+        mutable std::condition_variable m_finishedCondition;
+
+        std::vector<ReplayTrace::Frame> m_rxFrames;
+        std::vector<std::vector<uint8_t>> m_expectedTxFrames;
+        std::vector<std::vector<uint8_t>> m_txFrames;
+        size_t m_nextFrame = 0;
+
+        bool m_started = false;
+        Clock::time_point m_startTime;
+        Clock::time_point m_endTime;
+        Statistics m_statistics;
+};
+
+/// PJON strategy replaying a recorded trace (see ReplayTrace and
+/// RecordingStrategy) as received traffic, e.g. to run production traffic
+/// through Bus and consumer code offline:
+///   auto session = std::make_shared<ReplaySession>(ReplayTrace::load("traffic.trace"));
+///   Bus<ReplayStrategy> bus(address, ReplayStrategy(session));
+///   session->waitUntilFinished(std::chrono::minutes(1));
+///   auto comparison = session->compare();
+/// Copies of a ReplayStrategy share the same session.
+class ReplayStrategy
+{
+    public:
+        /// Without session, nothing is received and all transmissions fail.
+        /// (PJON requires strategies to be default constructible)
+        ReplayStrategy() = default;
+
+        inline explicit ReplayStrategy(std::shared_ptr<ReplaySession> f_session) :
+            m_session(std::move(f_session))
+        {
+        }
+
+        inline const std::shared_ptr<ReplaySession> & getSession() const
+        {
+            return m_session;
+        }
+
+        /// Time the last received frame was due according to the trace (see
+        /// HasFrameStartTime in PjonHlBus.hpp).
+        inline ReplaySession::Clock::time_point getLastFrameStartTime() const
+        {
+            return m_lastFrameStart;
+        }
+
+        // PJON strategy interface:
+
+        inline uint32_t back_off(uint8_t f_attempts)
+        {
+            return 0;
+        }
+
+        inline bool begin(uint8_t f_deviceId = 0)
+        {
+            return static_cast<bool>(m_session);
+        }
+
+        inline bool can_start()
+        {
+            return static_cast<bool>(m_session);
+        }
+
+        inline uint8_t get_max_attempts()
+        {
+            return 1;
+        }
+
+        inline uint16_t get_receive_time()
+        {
+            return 0;
+        }
+
+        inline void handle_collision()
+        {
+        }
+
+        inline uint16_t receive_frame(uint8_t * f_data, uint16_t f_maxLength)
+        {
+            return m_session ? m_session->nextFrame(f_data, f_maxLength, &m_lastFrameStart) : PJON_FAIL;
+        }
+
+        inline uint16_t receive_response()
+        {
+            return m_session and m_session->getConfig().acknowledge ? PJON_ACK : PJON_FAIL;
+        }
+
+        inline void send_response(uint8_t f_response)
+        {
+        }
+
+        inline void send_frame(uint8_t * f_data, uint16_t f_length)
+        {
+            if(m_session)
+            {
+                m_session->transmitted(f_data, f_length);
+            }
+        }
+
+    private:
+        std::shared_ptr<ReplaySession> m_session;
+        ReplaySession::Clock::time_point m_lastFrameStart;
+};
+
+}
@@ -0,0 +1,499 @@
+// Copyright 2021 Rainer Schoenberger
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <inttypes.h>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "PJONDefines.h"
+
+namespace PjonHL
+{
+
+/// Configuration of a VirtualWire.
+struct VirtualWireConfig
+{
+    /// Bits per second, 0 emulates infinite speed (no air time).
+    uint32_t baudRate = 115200;
+
+    /// Bits on the wire per transmitted byte (8N1 = 10).
+    uint8_t bitsPerByte = 10;
+
+    /// Time between start of transmission and signal arriving at
+    /// the other endpoints.
+    uint32_t propagationDelayMicroseconds = 0;
+
+    /// Probability of each received bit being flipped.
+    double bitErrorRate = 0;
+
+    /// Probability of an endpoint not receiving a frame (or response)
+    /// at all.
+    double lossRate = 0;
+
+    /// Corrupt frames of overlapping transmissions.
+    bool emulateCollisions = true;
+
+    /// Probability of a frame being corrupted by a collision with an
+    /// emulated hidden node (which itself is not visible).
+    double hiddenCollisionRate = 0;
+
+    /// Time PJON waits for a response (ACK) after sending a frame.
+    uint32_t responseTimeoutMicroseconds = 20000;
+
+    /// Strategy parameters reported to PJON:
+    uint8_t maxAttempts = 10;
+    uint32_t backOffMicroseconds = 1000;
+
+    /// Seed of random effects (errors, loss, back off).
+    /// 0 means random seed.
+    uint32_t seed = 0;
+};
+
+/// In-process emulation of a shared physical medium (e.g. a RS485 line).
+/// Any number of VirtualMedium strategy instances (one per PJON instance) can
+/// be attached to one wire. Frames sent by one endpoint are received by all
+/// other endpoints after the emulated air time and propagation delay.
+///
+/// Emulated effects:
+/// - air time according to baud rate
+/// - propagation delay (also delays carrier sense, so collisions can happen)
+/// - collisions of overlapping transmissions (frames get corrupted)
+/// - random bit errors and frame loss
+///
+/// Usage:
+///   auto wire = std::make_shared<VirtualWire>(VirtualWire::Config{});
+///   Bus<VirtualMedium> bus(Address{1}, VirtualMedium(wire));
+///   VirtualRemoteNode node(wire, Address{2}, VirtualRemoteNode::echo());
+///
+/// Thread safe, every endpoint may be used by a different thread.
+class VirtualWire
+{
+    public:
+        using Clock = std::chrono::steady_clock;
+
+        using Config = VirtualWireConfig;
+
+        struct Statistics
+        {
+            /// Frames and responses put on the wire.
+            uint64_t transmissions = 0;
+            /// Transmissions which overlapped with other transmissions.
+            uint64_t collisions = 0;
+            /// Frames/responses not delivered to an endpoint.
+            uint64_t lostDeliveries = 0;
+            /// Frames/responses delivered corrupted to an endpoint.
+            uint64_t corruptedDeliveries = 0;
+        };
+
+        struct Endpoint;
+
+        inline explicit VirtualWire(Config f_config = Config{}) :
+            m_config(f_config),
+            m_random(f_config.seed != 0 ? f_config.seed : std::random_device{}())
+        {
+        }
+
+        inline const Config & getConfig() const
+        {
+            return m_config;
+        }
+
+        inline Statistics getStatistics() const
+        {
+            std::lock_guard<std::mutex> guard(m_mutex);
+            return m_statistics;
+        }
+
+        /// Creates a new endpoint. Used by VirtualMedium.
+        inline std::shared_ptr<Endpoint> attach()
+        {
+            auto endpoint = std::make_shared<Endpoint>();
+            std::lock_guard<std::mutex> guard(m_mutex);
+            m_endpoints.erase(
+                    std::remove_if(m_endpoints.begin(), m_endpoints.end(), [](const std::weak_ptr<Endpoint> & f_endpoint){ return f_endpoint.expired(); }),
+                    m_endpoints.end()
+                    );
+            m_endpoints.push_back(endpoint);
+            return endpoint;
+        }
+
+        /// @returns time required to transmit f_length bytes.
+        inline Clock::duration getAirTime(uint16_t f_length) const
+        {
+            if(m_config.baudRate == 0)
+            {
+                return Clock::duration::zero();
+            }
+            return std::chrono::microseconds(static_cast<uint64_t>(f_length) * m_config.bitsPerByte * 1000000 / m_config.baudRate);
+        }
+
+        /// Carrier sense: @returns true if another transmission is visible
+        /// on the wire at the given endpoint or the endpoint did not yet
+        /// receive all frames which arrived (like a UART with data in its
+        /// receive buffer).
+        inline bool isBusy(const Endpoint & f_endpoint)
+        {
+            std::lock_guard<std::mutex> guard(m_mutex);
+            auto now = Clock::now();
+            if(not f_endpoint.frames.empty() and f_endpoint.frames.front().deliverAt <= now)
+            {
+                return true;
+            }
+            auto propagationDelay = std::chrono::microseconds(m_config.propagationDelayMicroseconds);
+            for(const auto & transmission : m_activeTransmissions)
+            {
+                if(transmission->sender != &f_endpoint and transmission->start + propagationDelay <= now and now < transmission->end + propagationDelay)
+                {
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        /// Puts a frame (or response if f_response is set) on the wire.
+        /// @returns time at which the sender finished transmitting.
+        inline Clock::time_point transmit(Endpoint & f_sender, const uint8_t * f_data, uint16_t f_length, bool f_response)
+        {
+            auto transmission = std::make_shared<Transmission>();
+            transmission->data.assign(f_data, f_data + f_length);
+            transmission->sender = &f_sender;
+            transmission->start = Clock::now();
+            transmission->end = transmission->start + getAirTime(f_length);
+            auto deliverAt = transmission->end + std::chrono::microseconds(m_config.propagationDelayMicroseconds);
+
+            {
+                std::lock_guard<std::mutex> guard(m_mutex);
+                m_statistics.transmissions++;
+
+                m_activeTransmissions.erase(
+                        std::remove_if(
+                            m_activeTransmissions.begin(),
+                            m_activeTransmissions.end(),
+                            [this, &transmission](const std::shared_ptr<Transmission> & f_other)
+                            {
+                                return f_other->end + std::chrono::microseconds(m_config.propagationDelayMicroseconds) <= transmission->start;
+                            }),
+                        m_activeTransmissions.end()
+                        );
+                if(m_config.emulateCollisions)
+                {
+                    for(auto & other : m_activeTransmissions)
+                    {
+                        if(other->sender != &f_sender)
+                        {
+                            other->collided = true;
+                            transmission->collided = true;
+                        }
+                    }
+                    if(transmission->collided)
+                    {
+                        m_statistics.collisions++;
+                    }
+                }
+                if(m_config.hiddenCollisionRate > 0 and std::bernoulli_distribution(m_config.hiddenCollisionRate)(m_random))
+                {
+                    transmission->collided = true;
+                    m_statistics.collisions++;
+                }
+                m_activeTransmissions.push_back(transmission);
+
+                if(not f_response)
+                {
+                    // responses from previous exchanges are no longer relevant:
+                    f_sender.responses.clear();
+                }
+
+                for(const auto & weakEndpoint : m_endpoints)
+                {
+                    auto endpoint = weakEndpoint.lock();
+                    if(not endpoint or endpoint.get() == &f_sender)
+                    {
+                        continue;
+                    }
+                    if(m_config.lossRate > 0 and std::bernoulli_distribution(m_config.lossRate)(m_random))
+                    {
+                        m_statistics.lostDeliveries++;
+                        continue;
+                    }
+                    auto & queue = f_response ? endpoint->responses : endpoint->frames;
+                    queue.push_back(Delivery{transmission, deliverAt});
+                    if(f_response and queue.size() > MaxQueuedResponses)
+                    {
+                        // endpoints which are not waiting for a response
+                        // never receive it:
+                        queue.pop_front();
+                    }
+                }
+            }
+            m_delivered.notify_all();
+            return transmission->end;
+        }
+
+        /// Receives a frame if one arrived at the endpoint.
+        /// @param f_frameStart if given, set to the time the first bit of the
+        ///        frame arrived at the endpoint.
+        /// @returns length of the frame written to f_data or PJON_FAIL.
+        inline uint16_t receive(Endpoint & f_endpoint, uint8_t * f_data, uint16_t f_maxLength, bool f_response, Clock::time_point * f_frameStart = nullptr)
+        {
+            std::lock_guard<std::mutex> guard(m_mutex);
+            auto & queue = f_response ? f_endpoint.responses : f_endpoint.frames;
+            if(queue.empty() or queue.front().deliverAt > Clock::now())
+            {
+                return PJON_FAIL;
+            }
+            Delivery delivery = std::move(queue.front());
+            queue.pop_front();
+
+            const std::vector<uint8_t> & data = delivery.transmission->data;
+            uint16_t length = static_cast<uint16_t>(std::min<size_t>(data.size(), f_maxLength));
+            std::copy(data.begin(), data.begin() + length, f_data);
+            if(corrupt(*delivery.transmission, f_data, length))
+            {
+                m_statistics.corruptedDeliveries++;
+            }
+            if(f_frameStart)
+            {
+                *f_frameStart = delivery.transmission->start + std::chrono::microseconds(m_config.propagationDelayMicroseconds);
+            }
+            return length;
+        }
+
+        /// Blocks until a frame (or response) is available for the endpoint
+        /// or f_timeout elapsed.
+        /// @returns true if a frame is available.
+        inline bool waitForDelivery(Endpoint & f_endpoint, Clock::duration f_timeout, bool f_response)
+        {
+            auto deadline = Clock::now() + f_timeout;
+            std::unique_lock<std::mutex> lock(m_mutex);
+            auto & queue = f_response ? f_endpoint.responses : f_endpoint.frames;
+            while(true)
+            {
+                auto now = Clock::now();
+                if(not queue.empty() and queue.front().deliverAt <= now)
+                {
+                    return true;
+                }
+                if(now >= deadline)
+                {
+                    return false;
+                }
+                auto wakeUp = queue.empty() ? deadline : std::min(deadline, queue.front().deliverAt);
+                m_delivered.wait_until(lock, wakeUp);
+            }
+        }
+
+        /// @returns random back off in microseconds for PJON retries.
+        inline uint32_t getBackOff(uint8_t f_attempts)
+        {
+            std::lock_guard<std::mutex> guard(m_mutex);
+            uint32_t base = m_config.backOffMicroseconds * f_attempts;
+            return base + std::uniform_int_distribution<uint32_t>(0, m_config.backOffMicroseconds)(m_random);
+        }
+
+    private:
+        static constexpr size_t MaxQueuedResponses = 4;
+
+        struct Transmission
+        {
+            std::vector<uint8_t> data;
+            const Endpoint * sender = nullptr;
+            Clock::time_point start;
+            Clock::time_point end;
+            bool collided = false;
+        };
+
+        struct Delivery
+        {
+            std::shared_ptr<Transmission> transmission;
+            Clock::time_point deliverAt;
+        };
+
+    public:
+        struct Endpoint
+        {
+            std::deque<Delivery> frames;
+            std::deque<Delivery> responses;
+        };
+
+    private:
+        /// Applies collision and bit errors to a received copy of a frame.
+        /// Only to be called with m_mutex locked.
+        /// @returns true if data was modified.
+        inline bool corrupt(const Transmission & f_transmission, uint8_t * f_data, uint16_t f_length)
+        {
+            if(f_length == 0)
+            {
+                return false;
+            }
+            bool corrupted = false;
+            if(f_transmission.collided)
+            {
+                // superimposed signals, garbles (at least) a part of the frame:
+                f_data[f_length / 2] ^= 0xff;
+                corrupted = true;
+            }
+            if(m_config.bitErrorRate > 0)
+            {
+                // skip directly to the next flipped bit:
+                std::geometric_distribution<uint64_t> distance(m_config.bitErrorRate);
+                uint64_t bits = static_cast<uint64_t>(f_length) * 8;
+                for(uint64_t bit = distance(m_random); bit < bits; bit += 1 + distance(m_random))
+                {
+                    f_data[bit / 8] ^= static_cast<uint8_t>(1u << (bit % 8));
+                    corrupted = true;
+                }
+            }
+            return corrupted;
+        }
+
+        const Config m_config;
+
+        mutable std::mutex m_mutex;
+        std::condition_variable m_delivered;
+        std::minstd_rand m_random;
+        std::vector<std::weak_ptr<Endpoint>> m_endpoints;
+        std::vector<std::shared_ptr<Transmission>> m_activeTransmissions;
+        Statistics m_statistics;
+};
+
+/// PJON strategy transmitting over a VirtualWire. Allows running the full
+/// stack (PjonHL + PJON) without hardware, e.g. Bus<VirtualMedium>.
+/// Copies of a VirtualMedium share the same endpoint on the wire.
+class VirtualMedium
+{
+    public:
+        /// Not attached to any wire, all transmissions fail.
+        /// (PJON requires strategies to be default constructible)
+        VirtualMedium() = default;
+
+        inline explicit VirtualMedium(std::shared_ptr<VirtualWire> f_wire) :
+            m_wire(f_wire),
+            m_endpoint(f_wire->attach())
+        {
+        }
+
+        inline const std::shared_ptr<VirtualWire> & getWire() const
+        {
+            return m_wire;
+        }
+
+        /// Blocks until a frame is available to be received or f_timeout
+        /// elapsed. Allows emulated nodes to wait without busy looping.
+        /// @returns true if a frame is available.
+        inline bool waitForFrame(VirtualWire::Clock::duration f_timeout)
+        {
+            if(not m_wire)
+            {
+                std::this_thread::sleep_for(f_timeout);
+                return false;
+            }
+            return m_wire->waitForDelivery(*m_endpoint, f_timeout, false);
+        }
+
+        /// Time the first bit of the last received frame arrived (see
+        /// HasFrameStartTime in PjonHlBus.hpp).
+        inline VirtualWire::Clock::time_point getLastFrameStartTime() const
+        {
+            return m_lastFrameStart;
+        }
+
+        // PJON strategy interface:
+
+        inline uint32_t back_off(uint8_t f_attempts)
+        {
+            return m_wire ? m_wire->getBackOff(f_attempts) : 0;
+        }
+
+        inline bool begin(uint8_t f_deviceId = 0)
+        {
+            return static_cast<bool>(m_wire);
+        }
+
+        inline bool can_start()
+        {
+            return m_wire and not m_wire->isBusy(*m_endpoint);
+        }
+
+        inline uint8_t get_max_attempts()
+        {
+            return m_wire ? m_wire->getConfig().maxAttempts : 1;
+        }
+
+        inline uint16_t get_receive_time()
+        {
+            return 0;
+        }
+
+        inline void handle_collision()
+        {
+            std::this_thread::sleep_for(std::chrono::microseconds(back_off(1)));
+        }
+
+        inline uint16_t receive_frame(uint8_t * f_data, uint16_t f_maxLength)
+        {
+            return m_wire ? m_wire->receive(*m_endpoint, f_data, f_maxLength, false, &m_lastFrameStart) : PJON_FAIL;
+        }
+
+        inline uint16_t receive_response()
+        {
+            if(not m_wire)
+            {
+                return PJON_FAIL;
+            }
+            auto timeout = std::chrono::microseconds(m_wire->getConfig().responseTimeoutMicroseconds);
+            if(not m_wire->waitForDelivery(*m_endpoint, timeout, true))
+            {
+                return PJON_FAIL;
+            }
+            uint8_t response = 0;
+            if(m_wire->receive(*m_endpoint, &response, 1, true) != 1)
+            {
+                return PJON_FAIL;
+            }
+            return response;
+        }
+
+        inline void send_response(uint8_t f_response)
+        {
+            if(m_wire)
+            {
+                std::this_thread::sleep_until(m_wire->transmit(*m_endpoint, &f_response, 1, true));
+            }
+        }
+
+        inline void send_frame(uint8_t * f_data, uint16_t f_length)
+        {
+            if(m_wire)
+            {
+                // like a UART, sending blocks until the frame is on the wire:
+                std::this_thread::sleep_until(m_wire->transmit(*m_endpoint, f_data, f_length, false));
+            }
+        }
+
+    private:
+        std::shared_ptr<VirtualWire> m_wire;
+        std::shared_ptr<VirtualWire::Endpoint> m_endpoint;
+        VirtualWire::Clock::time_point m_lastFrameStart;
+};
+
+}
@@ -0,0 +1,237 @@
+// Copyright 2021 Rainer Schoenberger
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+// NOTE: requires the PJON implementation, i.e. include PJON.h before
+//       including this file in exactly the translation units using it.
+
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "Address.hpp"
+#include "BusConfig.hpp"
+#include "strategies/VirtualMedium.hpp"
+
+namespace PjonHL
+{
+
+/// Emulated remote device attached to a VirtualWire.
+/// Runs a real PJON instance in its own thread which ACKs packets addressed
+/// to it (if ACKs are enabled) and answers them as defined by a Responder.
+class VirtualRemoteNode
+{
+    public:
+        /// Called for every packet received by the node.
+        /// @returns payloads to send back to the sender (may be empty).
+        using Responder = std::function<std::vector<std::vector<uint8_t>>(const std::vector<uint8_t> & f_payload, const Address & f_sender)>;
+
+        /// Only ACKs received packets (done by PJON), never answers.
+        static inline Responder ackOnly()
+        {
+            return [](const std::vector<uint8_t> &, const Address &){ return std::vector<std::vector<uint8_t>>(); };
+        }
+
+        /// Sends every received payload back to its sender.
+        static inline Responder echo()
+        {
+            return [](const std::vector<uint8_t> & f_payload, const Address &){ return std::vector<std::vector<uint8_t>>{f_payload}; };
+        }
+
+        /// Answers the n-th received packet with the n-th entry of
+        /// f_script (which may contain zero or more payloads), starts over
+        /// after the last entry.
+        static inline Responder script(std::vector<std::vector<std::vector<uint8_t>>> f_script)
+        {
+            size_t index = 0;
+            return [f_script{std::move(f_script)}, index](const std::vector<uint8_t> &, const Address &) mutable
+                {
+                    if(f_script.empty())
+                    {
+                        return std::vector<std::vector<uint8_t>>();
+                    }
+                    auto responses = f_script[index];
+                    index = (index + 1) % f_script.size();
+                    return responses;
+                };
+        }
+
+        /// @param f_config PJON settings of the node, should match the ones
+        ///        of the Bus it communicates with.
+        /// @param f_responseDelay emulated processing time before answering.
+        inline VirtualRemoteNode(
+                std::shared_ptr<VirtualWire> f_wire,
+                Address f_address,
+                Responder f_responder = ackOnly(),
+                BusConfig f_config = BusConfig{},
+                std::chrono::microseconds f_responseDelay = std::chrono::microseconds(0)
+                ) :
+            m_address(f_address),
+            m_responder(std::move(f_responder)),
+            m_responseDelay(f_responseDelay),
+            m_pjon(f_address.busId.data(), f_address.id)
+        {
+            m_pjon.strategy = VirtualMedium(f_wire);
+            m_pjon.set_acknowledge(f_config.ackType == BusConfig::AckType::AckEnabled);
+            m_pjon.set_crc_32(f_config.crcType == BusConfig::CrcType::Crc32);
+            m_pjon.set_communication_mode(f_config.communicationMode == BusConfig::CommunicationMode::HalfDuplex);
+            m_pjon.set_shared_network(f_config.busTopology == BusConfig::BusTopology::Shared);
+            m_pjon.set_custom_pointer(this);
+            m_pjon.set_receiver(&receiverFunction);
+            m_pjon.set_error(&errorFunction);
+            m_pjon.begin();
+            m_thread = std::thread([this]{ run(); });
+        }
+
+        inline ~VirtualRemoteNode()
+        {
+            m_running = false;
+            m_thread.join();
+        }
+
+        VirtualRemoteNode(const VirtualRemoteNode &) = delete;
+        VirtualRemoteNode & operator=(const VirtualRemoteNode &) = delete;
+
+        /// Sends an unsolicited packet from this node to f_target.
+        inline void send(Address f_target, std::vector<uint8_t> f_payload)
+        {
+            std::lock_guard<std::mutex> guard(m_pendingMutex);
+            m_pending.push_back(PendingPacket{std::chrono::steady_clock::now(), f_target, std::move(f_payload)});
+        }
+
+        inline Address getAddress() const
+        {
+            return m_address;
+        }
+
+        /// Number of packets received by this node.
+        inline uint64_t getReceivedCount() const
+        {
+            return m_receivedCount;
+        }
+
+        /// Number of packets this node handed to PJON for sending.
+        inline uint64_t getSentCount() const
+        {
+            return m_sentCount;
+        }
+
+        /// Number of packets PJON failed to deliver (e.g. missing ACK).
+        inline uint64_t getSendFailureCount() const
+        {
+            return m_sendFailureCount;
+        }
+
+    private:
+        struct PendingPacket
+        {
+            std::chrono::steady_clock::time_point dueTime;
+            Address target;
+            std::vector<uint8_t> payload;
+        };
+
+        static inline void receiverFunction(uint8_t * f_payload, uint16_t f_length, const PJON_Packet_Info & f_info)
+        {
+            static_cast<VirtualRemoteNode*>(f_info.custom_pointer)->handleReceive(f_payload, f_length, f_info);
+        }
+
+        static inline void errorFunction(uint8_t f_code, uint16_t f_data, void * f_customPointer)
+        {
+            if(f_code == PJON_CONNECTION_LOST)
+            {
+                static_cast<VirtualRemoteNode*>(f_customPointer)->m_sendFailureCount++;
+            }
+        }
+
+        inline void handleReceive(uint8_t * f_payload, uint16_t f_length, const PJON_Packet_Info & f_info)
+        {
+            m_receivedCount++;
+            Address sender;
+            sender.id = f_info.tx.id;
+            std::copy(f_info.tx.bus_id, f_info.tx.bus_id + 4, sender.busId.begin());
+#if(PJON_INCLUDE_PORT)
+            sender.port = f_info.port;
+#endif
+            auto responses = m_responder(std::vector<uint8_t>(f_payload, f_payload + f_length), sender);
+            auto dueTime = std::chrono::steady_clock::now() + m_responseDelay;
+            std::lock_guard<std::mutex> guard(m_pendingMutex);
+            for(auto & response : responses)
+            {
+                m_pending.push_back(PendingPacket{dueTime, sender, std::move(response)});
+            }
+        }
+
+        inline void sendDuePackets()
+        {
+            std::lock_guard<std::mutex> guard(m_pendingMutex);
+            auto now = std::chrono::steady_clock::now();
+            while(not m_pending.empty() and m_pending.front().dueTime <= now)
+            {
+                PendingPacket & packet = m_pending.front();
+                PJON_Packet_Info info;
+                info.tx.id = m_address.id;
+                info.rx.id = packet.target.id;
+                info.header = PJON_NO_HEADER;
+                PJONTools::copy_id(info.tx.bus_id, m_address.busId.data(), 4);
+                PJONTools::copy_id(info.rx.bus_id, packet.target.busId.data(), 4);
+#if(PJON_INCLUDE_PACKET_ID)
+                info.id = 0;
+#endif
+#if(PJON_INCLUDE_PORT)
+                info.port = packet.target.port;
+#endif
+                if(m_pjon.send(info, packet.payload.data(), packet.payload.size()) == PJON_FAIL)
+                {
+                    // PJON packet buffer full, try again later:
+                    return;
+                }
+                m_sentCount++;
+                m_pending.pop_front();
+            }
+        }
+
+        inline void run()
+        {
+            while(m_running)
+            {
+                sendDuePackets();
+                m_pjon.update();
+                m_pjon.receive();
+                m_pjon.strategy.waitForFrame(std::chrono::microseconds(200));
+            }
+        }
+
+        const Address m_address;
+        Responder m_responder;
+        const std::chrono::microseconds m_responseDelay;
+
+        PJON<VirtualMedium> m_pjon;
+
+        std::mutex m_pendingMutex;
+        std::deque<PendingPacket> m_pending;
+
+        std::atomic<uint64_t> m_receivedCount{0};
+        std::atomic<uint64_t> m_sentCount{0};
+        std::atomic<uint64_t> m_sendFailureCount{0};
+
+        std::atomic<bool> m_running{true};
+        std::thread m_thread;
+};
+
+}
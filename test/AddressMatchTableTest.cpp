@@ -0,0 +1,80 @@
+// Copyright 2021 Rainer Schoenberger
+// 
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+// 
+//     http://www.apache.org/licenses/LICENSE-2.0
+// 
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "catch2/catch.hpp"
+
+#include "AddressMatchTable.hpp"
+#include <random>
+
+TEST_CASE( "MatchTable empty", "" ) {
+    PjonHL::AddressMatchTable table;
+    std::vector<uint32_t> matches{1, 2};
+    table.match(PjonHL::Address{42}, PjonHL::Address{36}, matches);
+    REQUIRE(matches.empty());
+}
+
+TEST_CASE( "MatchTable exact and wildcard", "" ) {
+    const auto all = PjonHL::Address::createAllOneAddress();
+    PjonHL::AddressMatchTable table;
+    table.add(PjonHL::Address{42}, all, PjonHL::Address{36}, all);
+    table.add(PjonHL::Address{43}, all, PjonHL::Address{36}, all);
+    table.add(PjonHL::Address{0}, PjonHL::Address{0}, PjonHL::Address{36}, all);
+    table.add(PjonHL::Address{42}, all, PjonHL::Address{0}, PjonHL::Address{0});
+    table.add(PjonHL::Address{"0.0.0.0/42:1"}, all, PjonHL::Address{36}, all);
+    REQUIRE(table.size() == 5);
+
+    std::vector<uint32_t> matches;
+    table.match(PjonHL::Address{42}, PjonHL::Address{36}, matches);
+    REQUIRE(matches == std::vector<uint32_t>{0, 2, 3});
+
+    table.match(PjonHL::Address{43}, PjonHL::Address{37}, matches);
+    REQUIRE(matches.empty());
+
+    table.match(PjonHL::Address{"0.0.0.0/42:1"}, PjonHL::Address{36}, matches);
+    REQUIRE(matches == std::vector<uint32_t>{2, 4});
+}
+
+TEST_CASE( "MatchTable SIMD equals scalar", "" ) {
+    std::mt19937_64 random(1234);
+    PjonHL::AddressMatchTable table;
+    // few distinct values, so there are plenty of matches:
+    auto randomAddress = [&random]{
+        PjonHL::Address address(static_cast<int>(random() % 4));
+        address.busId[random() % 4] = random() % 2;
+        address.port = random() % 2;
+        return address;
+    };
+    auto randomMask = [&random]{
+        return PjonHL::Address::fromKey(random() | random());
+    };
+    for(int i = 0; i < 37; i++)
+    {
+        table.add(randomAddress(), randomMask(), randomAddress(), randomMask());
+    }
+
+    std::vector<uint32_t> matches;
+    std::vector<uint32_t> expected;
+    size_t total = 0;
+    for(int i = 0; i < 1000; i++)
+    {
+        auto remote = randomAddress();
+        auto target = randomAddress();
+        table.match(remote, target, matches);
+        table.matchScalar(remote, target, expected);
+        REQUIRE(matches == expected);
+        total += matches.size();
+    }
+    REQUIRE(total > 0);
+    INFO(PjonHL::AddressMatchTable::implementationName());
+}
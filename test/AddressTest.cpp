@@ -15,6 +15,7 @@
 #include "catch2/catch.hpp"
 
 #include "Address.hpp"
+#include <sstream>
 
 // Good case tests:
 
@@ -145,3 +146,139 @@ TEST_CASE( "Format Error too small bus 2", "" ) {
     PjonHL::Address("0.0/45")
     );
 }
+
+TEST_CASE( "Format Error trailing characters", "" ) {
+    REQUIRE_THROWS(
+    PjonHL::Address("42:12a")
+    );
+    REQUIRE_THROWS(
+    PjonHL::Address("1.2.3.4/42/1")
+    );
+}
+
+TEST_CASE( "Format Error huge numbers", "" ) {
+    REQUIRE_THROWS(
+    PjonHL::Address("99999999999999999999")
+    );
+    REQUIRE_THROWS(
+    PjonHL::Address("42:99999999999999999999")
+    );
+}
+
+// tryParse:
+
+TEST_CASE( "tryParse good case", "" ) {
+    auto addr = PjonHL::Address::tryParse("1.5.6.38/42:873");
+    REQUIRE( addr.isValid() == true );
+    REQUIRE( addr.unwrap().id == 42 );
+    REQUIRE( addr.unwrap().port == 873 );
+    REQUIRE( addr.unwrap().busId[3] == 38 );
+}
+
+TEST_CASE( "tryParse bad case", "" ) {
+    REQUIRE( PjonHL::Address::tryParse("").isValid() == false );
+    REQUIRE( PjonHL::Address::tryParse("256").isValid() == false );
+    REQUIRE( PjonHL::Address::tryParse("0.0/45").isValid() == false );
+}
+
+TEST_CASE( "parse errors", "" ) {
+    using Error = PjonHL::Address::ParseError;
+    REQUIRE( PjonHL::Address::parse("42").error == Error::None );
+    REQUIRE( PjonHL::Address::parse("42/").error == Error::Format );
+    REQUIRE( PjonHL::Address::parse("256").error == Error::DeviceIdRange );
+    REQUIRE( PjonHL::Address::parse("0.0.0.0/256").error == Error::DeviceIdRange );
+    REQUIRE( PjonHL::Address::parse("0.0.0.256/42").error == Error::BusIdRange );
+    REQUIRE( PjonHL::Address::parse("42:65536").error == Error::PortRange );
+}
+
+TEST_CASE( "parse rejects numbers above 2^32", "" ) {
+    // would wrap to valid values if accumulated unchecked:
+    using Error = PjonHL::Address::ParseError;
+    REQUIRE( PjonHL::Address::parse("4294967338").error == Error::DeviceIdRange );
+    REQUIRE( PjonHL::Address::parse("1:4294967297").error == Error::PortRange );
+    REQUIRE( PjonHL::Address::parse("0.0.0.0/4294967338:1").error == Error::DeviceIdRange );
+    REQUIRE( PjonHL::Address::parse("4294967297.0.0.0/42").error == Error::BusIdRange );
+    REQUIRE( PjonHL::Address::parse("0.4294967297.0.0/42").error == Error::BusIdRange );
+    REQUIRE( PjonHL::Address::parse("0.0.4294967297.0/42").error == Error::BusIdRange );
+    REQUIRE( PjonHL::Address::parse("0.0.0.4294967297/42").error == Error::BusIdRange );
+    REQUIRE( PjonHL::Address::parse("99999999999999999999").error == Error::DeviceIdRange );
+    REQUIRE_THROWS( PjonHL::Address("4294967338") );
+    REQUIRE( PjonHL::Address::parse("1.2.3.4/255:65535").error == Error::None );
+}
+
+// compile time parsing:
+
+using namespace PjonHL::literals;
+
+TEST_CASE( "Address literal", "" ) {
+    constexpr PjonHL::Address addr = "1.2.3.4/42:1337"_pjon;
+    static_assert(addr.id == 42, "literal evaluated at compile time");
+    static_assert(addr.port == 1337, "literal evaluated at compile time");
+    static_assert(addr.busId[0] == 1 and addr.busId[3] == 4, "literal evaluated at compile time");
+    static_assert(PjonHL::Address::parse("1.2.3").error == PjonHL::Address::ParseError::Format, "parse at compile time");
+    REQUIRE( addr.id == 42 );
+
+    // at runtime invalid literals throw:
+    REQUIRE_THROWS( "1.2.3"_pjon );
+}
+
+// packed representation:
+
+TEST_CASE( "Key roundtrip", "" ) {
+    PjonHL::Address addr("1.2.3.4/56:8765");
+    REQUIRE( addr.toKey() == (0x0001020304380000ULL | 8765) );
+    PjonHL::Address copy = PjonHL::Address::fromKey(addr.toKey());
+    REQUIRE( copy.toString() == "1.2.3.4/56:8765" );
+    REQUIRE( copy == addr );
+    REQUIRE( copy != PjonHL::Address("1.2.3.4/56:8766") );
+    REQUIRE( PjonHL::Address::createAllOneAddress().toString() == "255.255.255.255/255:65535" );
+}
+
+TEST_CASE( "Masked match", "" ) {
+    PjonHL::Address addr("1.2.3.4/56:8765");
+    REQUIRE( addr.matches(PjonHL::Address("1.2.3.4/56:8765"), PjonHL::Address::createAllOneAddress()) );
+    REQUIRE( not addr.matches(PjonHL::Address("1.2.3.4/57:8765"), PjonHL::Address::createAllOneAddress()) );
+    REQUIRE( addr.matches(PjonHL::Address("1.2.3.4/57:1"), PjonHL::Address("255.255.255.255/0:0")) );
+    REQUIRE( not addr.matches(PjonHL::Address("1.2.3.5/57:1"), PjonHL::Address("255.255.255.255/0:0")) );
+    REQUIRE( addr.matches(PjonHL::Address("9.9.9.9/9:9"), PjonHL::Address()) );
+}
+
+TEST_CASE( "Address hash", "" ) {
+    std::hash<PjonHL::Address> hash;
+    REQUIRE( hash(PjonHL::Address("1.2.3.4/56:8765")) == hash(PjonHL::Address("1.2.3.4/56:8765")) );
+}
+
+// allocation free formatting:
+
+TEST_CASE( "toChars", "" ) {
+    PjonHL::Address addr = PjonHL::Address::createAllOneAddress();
+    char buffer[PjonHL::Address::MaxStringLength];
+    char * end = addr.toChars(buffer, buffer + sizeof(buffer));
+    REQUIRE( end == buffer + sizeof(buffer) );
+    REQUIRE( std::string(buffer, end) == "255.255.255.255/255:65535" );
+
+    // too small buffers:
+    for(size_t size = 0; size < sizeof(buffer); size++)
+    {
+        REQUIRE( addr.toChars(buffer, buffer + size) == nullptr );
+    }
+
+    PjonHL::Address small("1.2.3.4/56:8765");
+    end = small.toChars(buffer, buffer + sizeof(buffer));
+    REQUIRE( std::string(buffer, end) == "1.2.3.4/56:8765" );
+    REQUIRE( small.toChars(buffer, buffer + 15) == buffer + 15 );
+    REQUIRE( small.toChars(buffer, buffer + 14) == nullptr );
+}
+
+TEST_CASE( "appendTo", "" ) {
+    std::string output = "remote=";
+    PjonHL::Address("1.2.3.4/56:8765").appendTo(output);
+    REQUIRE( output == "remote=1.2.3.4/56:8765" );
+}
+
+TEST_CASE( "ostream", "" ) {
+    std::ostringstream stream;
+    const PjonHL::Address addr("1.2.3.4/56:8765");
+    stream << addr << "|" << PjonHL::Address();
+    REQUIRE( stream.str() == "1.2.3.4/56:8765|0.0.0.0/0:0" );
+}
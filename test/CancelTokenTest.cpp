@@ -0,0 +1,33 @@
+// Copyright 2021 Rainer Schoenberger
+// 
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+// 
+//     http://www.apache.org/licenses/LICENSE-2.0
+// 
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "catch2/catch.hpp"
+#include "CancelToken.hpp"
+
+using namespace PjonHL;
+
+TEST_CASE( "CancelToken default can not be cancelled", "" ) {
+    CancelToken token;
+    token.cancel();
+    REQUIRE(token.isCancelled() == false);
+}
+
+TEST_CASE( "CancelToken copies share state", "" ) {
+    CancelToken token = CancelToken::create();
+    CancelToken copy = token;
+    REQUIRE(copy.isCancelled() == false);
+    token.cancel();
+    REQUIRE(token.isCancelled() == true);
+    REQUIRE(copy.isCancelled() == true);
+}
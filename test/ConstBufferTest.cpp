@@ -0,0 +1,83 @@
+// Copyright 2021 Rainer Schoenberger
+// 
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+// 
+//     http://www.apache.org/licenses/LICENSE-2.0
+// 
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "catch2/catch.hpp"
+
+#include <array>
+#include <vector>
+#include "ConstBuffer.hpp"
+
+using PjonHL::ConstBuffer;
+
+TEST_CASE( "ConstBuffer default is empty", "" ) {
+    ConstBuffer buffer;
+    REQUIRE(buffer.empty() == true);
+    REQUIRE(buffer.size() == 0);
+    REQUIRE(buffer.toVector().empty() == true);
+}
+
+TEST_CASE( "ConstBuffer views without copying", "" ) {
+    std::vector<uint8_t> vector{1, 2, 3};
+    std::array<uint8_t, 2> array{4, 5};
+    uint8_t raw[] = {6, 7, 8, 9};
+    const char * text = "ab";
+
+    ConstBuffer fromVector = vector;
+    ConstBuffer fromArray = array;
+    ConstBuffer fromRaw = raw;
+    ConstBuffer fromPointer(text, 2);
+
+    REQUIRE(fromVector.data() == vector.data());
+    REQUIRE(fromVector.size() == 3);
+    REQUIRE(fromArray.data() == array.data());
+    REQUIRE(fromArray.size() == 2);
+    REQUIRE(fromRaw.data() == raw);
+    REQUIRE(fromRaw.size() == 4);
+    REQUIRE(fromPointer.size() == 2);
+    REQUIRE(fromPointer.data()[1] == 'b');
+}
+
+TEST_CASE( "ConstBuffer toVector copies", "" ) {
+    uint8_t raw[] = {6, 7, 8};
+    ConstBuffer buffer = raw;
+    auto copy = buffer.toVector();
+    raw[0] = 0;
+    REQUIRE(copy == std::vector<uint8_t>{6, 7, 8});
+    REQUIRE(std::vector<uint8_t>(buffer.begin(), buffer.end()) == std::vector<uint8_t>{0, 7, 8});
+}
+
+TEST_CASE( "ConstBufferList gathers segments in order", "" ) {
+    std::array<uint8_t, 2> header{1, 2};
+    std::vector<uint8_t> body{3, 4, 5};
+    PjonHL::ConstBufferList segments{header, body};
+    segments.push_back(ConstBuffer());
+    REQUIRE(segments.size() == 3);
+    REQUIRE(segments.totalSize() == 5);
+    REQUIRE(segments[1].data() == body.data());
+
+    std::vector<uint8_t> gathered{0};
+    segments.gatherInto(gathered);
+    REQUIRE(gathered == std::vector<uint8_t>{0, 1, 2, 3, 4, 5});
+}
+
+TEST_CASE( "ConstBufferList capacity", "" ) {
+    uint8_t byte = 0;
+    PjonHL::ConstBufferList segments;
+    for(size_t i = 0; i < PjonHL::ConstBufferList::Capacity; i++)
+    {
+        segments.push_back(ConstBuffer(&byte, 1));
+    }
+    REQUIRE(segments.totalSize() == PjonHL::ConstBufferList::Capacity);
+    REQUIRE_THROWS_AS(segments.push_back(ConstBuffer(&byte, 1)), std::length_error);
+}
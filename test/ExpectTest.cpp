@@ -14,6 +14,7 @@
 
 #include "catch2/catch.hpp"
 
+#include <memory>
 #include "Expect.hpp"
 
 TEST_CASE( "Default", "" ) {
@@ -29,3 +30,68 @@ TEST_CASE( "Value initialized", "" ) {
     REQUIRE(e.isValid() == true);
     REQUIRE(e.unwrap() == 78627);
 }
+
+namespace
+{
+struct MoveOnly
+{
+    explicit MoveOnly(int f_value) : value(std::make_unique<int>(f_value)) {}
+    std::unique_ptr<int> value;
+};
+
+struct CountingCopies
+{
+    CountingCopies() = default;
+    CountingCopies(const CountingCopies & f_other) : copies(f_other.copies + 1) {}
+    CountingCopies(CountingCopies && f_other) = default;
+    CountingCopies & operator=(const CountingCopies &) = default;
+    CountingCopies & operator=(CountingCopies &&) = default;
+    int copies = 0;
+};
+
+struct NoDefault
+{
+    static inline int constructed = 0;
+    explicit NoDefault(int) { constructed++; }
+};
+}
+
+TEST_CASE( "Value moved in and out", "" ) {
+    Expect<CountingCopies> e{CountingCopies()};
+    REQUIRE(e.unwrap().copies == 0);
+
+    Expect<CountingCopies> moved = std::move(e);
+    REQUIRE(moved.unwrap().copies == 0);
+
+    CountingCopies value = std::move(moved).unwrap();
+    REQUIRE(value.copies == 0);
+
+    Expect<CountingCopies> copied = value;
+    REQUIRE(copied.unwrap().copies == 1);
+}
+
+TEST_CASE( "Move only value", "" ) {
+    Expect<MoveOnly> e(std::in_place, 5);
+    REQUIRE(e.isValid() == true);
+    REQUIRE(*e.unwrap().value == 5);
+
+    Expect<MoveOnly> other;
+    other = std::move(e);
+    REQUIRE(other.isValid() == true);
+    REQUIRE(*other.unwrap().value == 5);
+}
+
+TEST_CASE( "Invalid does not construct value", "" ) {
+    NoDefault::constructed = 0;
+    Expect<NoDefault> e;
+    REQUIRE(e.isValid() == false);
+    REQUIRE(NoDefault::constructed == 0);
+
+    const Expect<NoDefault> & constRef = e;
+    REQUIRE_THROWS(constRef.unwrap());
+    REQUIRE_THROWS(std::move(e).unwrap());
+
+    e = Expect<NoDefault>(std::in_place, 1);
+    REQUIRE(e.isValid() == true);
+    REQUIRE(NoDefault::constructed == 1);
+}
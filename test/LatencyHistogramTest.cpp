@@ -0,0 +1,70 @@
+// Copyright 2021 Rainer Schoenberger
+// 
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+// 
+//     http://www.apache.org/licenses/LICENSE-2.0
+// 
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "catch2/catch.hpp"
+
+#include "LatencyHistogram.hpp"
+
+TEST_CASE( "Histogram empty", "" ) {
+    PjonHL::LatencyHistogram histogram;
+    auto snapshot = histogram.snapshot();
+    REQUIRE(snapshot.count == 0);
+    REQUIRE(snapshot.p50() == 0);
+    REQUIRE(snapshot.meanMicroseconds() == 0);
+}
+
+TEST_CASE( "Histogram bucket mapping", "" ) {
+    // every value has to be inside the bounds of its bucket:
+    for(uint64_t value = 0; value < 100000; value += 7)
+    {
+        uint32_t index = PjonHL::LatencyHistogram::bucketIndex(value);
+        REQUIRE(value <= PjonHL::LatencyHistogram::bucketUpperBound(index));
+        if(index > 0)
+        {
+            REQUIRE(value > PjonHL::LatencyHistogram::bucketUpperBound(index - 1));
+        }
+    }
+    REQUIRE(PjonHL::LatencyHistogram::bucketIndex(uint64_t(1) << 40) == PjonHL::LatencyHistogram::BucketCount - 1);
+}
+
+TEST_CASE( "Histogram percentiles", "" ) {
+    PjonHL::LatencyHistogram histogram;
+    for(uint64_t i = 1; i <= 1000; i++)
+    {
+        histogram.recordMicroseconds(i);
+    }
+    auto snapshot = histogram.snapshot();
+    REQUIRE(snapshot.count == 1000);
+    REQUIRE(snapshot.maxMicroseconds == 1000);
+    REQUIRE(snapshot.meanMicroseconds() == 500);
+    // relative error of buckets is at most 12.5%:
+    REQUIRE(snapshot.p50() >= 500);
+    REQUIRE(snapshot.p50() <= 500 * 1.125);
+    REQUIRE(snapshot.p99() >= 990);
+    REQUIRE(snapshot.p99() <= 1000);
+    REQUIRE(snapshot.p999() == 1000);
+}
+
+TEST_CASE( "Histogram record duration and reset", "" ) {
+    PjonHL::LatencyHistogram histogram;
+    histogram.record(std::chrono::milliseconds(3));
+    histogram.record(std::chrono::nanoseconds(-5));
+    auto snapshot = histogram.snapshot();
+    REQUIRE(snapshot.count == 2);
+    REQUIRE(snapshot.maxMicroseconds == 3000);
+    REQUIRE(snapshot.percentileMicroseconds(0.0) == 0);
+
+    histogram.reset();
+    REQUIRE(histogram.snapshot().count == 0);
+}
@@ -0,0 +1,158 @@
+// Copyright 2021 Rainer Schoenberger
+// 
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+// 
+//     http://www.apache.org/licenses/LICENSE-2.0
+// 
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "catch2/catch.hpp"
+
+#include "AsyncLogger.hpp"
+#include "LockFreeQueue.hpp"
+#include <sstream>
+#include <thread>
+#include <vector>
+
+class RecordingLogger : public PjonHL::Logger
+{
+    public:
+        virtual void log(LogLevel f_level, std::string f_message) override
+        {
+            messages.push_back(f_message);
+        }
+        std::vector<std::string> messages;
+};
+
+TEST_CASE( "Logger level filter", "" ) {
+    RecordingLogger logger;
+    REQUIRE(logger.isEnabled(PjonHL::Logger::Debug) == true);
+    logger.setLevel(PjonHL::Logger::Info);
+    REQUIRE(logger.isEnabled(PjonHL::Logger::Debug) == false);
+    REQUIRE(logger.isEnabled(PjonHL::Logger::Info) == true);
+    REQUIRE(logger.isEnabled(PjonHL::Logger::Error) == true);
+
+    logger.logRecord(PjonHL::LogRecord::rxPacket(PjonHL::Address{42}, PjonHL::Address{36}, 7, true));
+    REQUIRE(logger.messages.empty());
+}
+
+TEST_CASE( "Logger record formatting", "" ) {
+    RecordingLogger logger;
+    logger.logRecord(PjonHL::LogRecord::rxPacket(PjonHL::Address{42}, PjonHL::Address{"1.2.3.4/36:5"}, 7, true));
+    logger.logRecord(PjonHL::LogRecord::rxPacket(PjonHL::Address{42}, PjonHL::Address{36}, 0, false));
+    logger.logRecord(PjonHL::LogRecord::txRetransmit(PjonHL::Address{42}, 2, 1500));
+    REQUIRE(logger.messages.size() == 3);
+    REQUIRE(logger.messages[0] == "Rx packet: remote=0.0.0.0/42:0 target=1.2.3.4/36:5 packet id = 7");
+    REQUIRE(logger.messages[1] == "Rx packet: remote=0.0.0.0/42:0 target=0.0.0.0/36:0 packet id = [DISABLED_IN_PJON_HL]");
+    REQUIRE(logger.messages[2] == "Tx retransmit scheduled: remote=0.0.0.0/42:0 attempt=2 backoff_us=1500");
+}
+
+TEST_CASE( "AsyncLogger writes in background", "" ) {
+    std::ostringstream output;
+    {
+        PjonHL::AsyncLogger logger(output, 16, std::chrono::milliseconds(1));
+        logger.logRecord(PjonHL::LogRecord::txRetransmit(PjonHL::Address{42}, 2, 1500));
+        logger.log(PjonHL::Logger::Error, "some error");
+        logger.setLevel(PjonHL::Logger::Info);
+        logger.log(PjonHL::Logger::Debug, "filtered");
+        logger.flush();
+        std::string written = output.str();
+        REQUIRE(written.find("PjonHl: Tx retransmit scheduled: remote=0.0.0.0/42:0 attempt=2 backoff_us=1500\n") != std::string::npos);
+        REQUIRE(written.find("PjonHl: some error\n") != std::string::npos);
+        REQUIRE(written.find("filtered") == std::string::npos);
+    }
+}
+
+TEST_CASE( "AsyncLogger keeps order of records and messages", "" ) {
+    std::ostringstream output;
+    {
+        PjonHL::AsyncLogger logger(output, 16, std::chrono::hours(1));
+        logger.log(PjonHL::Logger::Error, "first");
+        logger.logRecord(PjonHL::LogRecord::txRetransmit(PjonHL::Address{42}, 2, 0));
+        logger.log(PjonHL::Logger::Error, "third");
+        logger.logRecord(PjonHL::LogRecord::txRetransmit(PjonHL::Address{42}, 4, 0));
+        logger.flush();
+        std::string written = output.str();
+        size_t first = written.find("first");
+        size_t second = written.find("attempt=2 ");
+        size_t third = written.find("third");
+        size_t fourth = written.find("attempt=4 ");
+        REQUIRE(fourth != std::string::npos);
+        REQUIRE(first < second);
+        REQUIRE(second < third);
+        REQUIRE(third < fourth);
+    }
+}
+
+TEST_CASE( "AsyncLogger drops records if full", "" ) {
+    std::ostringstream output;
+    {
+        PjonHL::AsyncLogger logger(output, 4, std::chrono::hours(1));
+        for(int i = 0; i < 10; i++)
+        {
+            logger.logRecord(PjonHL::LogRecord::txRetransmit(PjonHL::Address{42}, i, 0));
+        }
+        REQUIRE(logger.getDroppedCount() == 6);
+    }
+    // remaining records are written on destruction:
+    REQUIRE(output.str().find("attempt=3 ") != std::string::npos);
+    REQUIRE(output.str().find("6 log records dropped") != std::string::npos);
+}
+
+TEST_CASE( "BoundedMpmcQueue", "" ) {
+    PjonHL::BoundedMpmcQueue<int> queue(3);
+    REQUIRE(queue.capacity() == 4);
+    int value = 0;
+    REQUIRE(queue.pop(value) == false);
+    for(int i = 0; i < 4; i++)
+    {
+        REQUIRE(queue.push(i) == true);
+    }
+    REQUIRE(queue.push(4) == false);
+    for(int i = 0; i < 4; i++)
+    {
+        REQUIRE(queue.pop(value) == true);
+        REQUIRE(value == i);
+    }
+    REQUIRE(queue.pop(value) == false);
+}
+
+TEST_CASE( "BoundedMpmcQueue concurrent", "" ) {
+    PjonHL::BoundedMpmcQueue<uint64_t> queue(64);
+    const uint64_t perProducer = 20000;
+    std::vector<std::thread> producers;
+    for(uint64_t t = 0; t < 3; t++)
+    {
+        producers.emplace_back([&queue, perProducer]{
+            for(uint64_t i = 1; i <= perProducer; i++)
+            {
+                while(not queue.push(i))
+                {
+                    std::this_thread::yield();
+                }
+            }
+        });
+    }
+    uint64_t sum = 0;
+    uint64_t count = 0;
+    while(count < 3 * perProducer)
+    {
+        uint64_t value;
+        if(queue.pop(value))
+        {
+            sum += value;
+            count++;
+        }
+    }
+    for(auto & producer : producers)
+    {
+        producer.join();
+    }
+    REQUIRE(sum == 3 * perProducer * (perProducer + 1) / 2);
+}
@@ -0,0 +1,61 @@
+// Copyright 2021 Rainer Schoenberger
+// 
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+// 
+//     http://www.apache.org/licenses/LICENSE-2.0
+// 
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "catch2/catch.hpp"
+
+#include "Metrics.hpp"
+#include <thread>
+#include <vector>
+
+TEST_CASE( "Counter", "" ) {
+    PjonHL::Counter counter;
+    REQUIRE(counter.get() == 0);
+    counter.add();
+    counter.add(41);
+    REQUIRE(counter.get() == 42);
+}
+
+TEST_CASE( "Gauge peak", "" ) {
+    PjonHL::Gauge gauge;
+    gauge.increase();
+    gauge.increase(4);
+    gauge.decrease(3);
+    gauge.increase();
+    auto snapshot = gauge.snapshot();
+    REQUIRE(snapshot.current == 3);
+    REQUIRE(snapshot.peak == 5);
+}
+
+TEST_CASE( "Gauge concurrent", "" ) {
+    PjonHL::Gauge gauge;
+    std::vector<std::thread> threads;
+    for(int t = 0; t < 4; t++)
+    {
+        threads.emplace_back([&gauge]{
+            for(int i = 0; i < 10000; i++)
+            {
+                gauge.increase();
+                gauge.decrease();
+            }
+        });
+    }
+    for(auto & thread : threads)
+    {
+        thread.join();
+    }
+    auto snapshot = gauge.snapshot();
+    REQUIRE(snapshot.current == 0);
+    REQUIRE(snapshot.peak >= 1);
+    REQUIRE(snapshot.peak <= 4);
+}
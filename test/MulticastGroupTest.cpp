@@ -0,0 +1,214 @@
+// Copyright 2021 Rainer Schoenberger
+// 
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+// 
+//     http://www.apache.org/licenses/LICENSE-2.0
+// 
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "catch2/catch.hpp"
+#define PJON_INCLUDE_PACKET_ID 1
+#include "PjonHlBus.hpp"
+#include "MulticastGroup.hpp"
+#include "PJONDefines.h"
+#include <chrono>
+#include <future>
+#include <thread>
+#include <vector>
+#include "PjonMock.hpp"
+
+namespace
+{
+void waitForSendCount(size_t f_count)
+{
+    while(shadow().sendCount < f_count)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+}
+
+void enqueueAcknowledgement(uint8_t f_sender, uint8_t * f_payload)
+{
+    PJON_Packet_Info info;
+    info.rx.id = 36;
+    info.tx.id = f_sender;
+    shadow().enqueuePacketForRx(f_payload, 1, info);
+}
+}
+
+TEST_CASE( "Multicast unicast to all members", "" ) {
+    shadow().reset();
+    PjonHL::Bus<Strategy> bus(PjonHL::Address{36}, Strategy{});
+    PjonHL::MulticastGroup<Strategy> group(bus, {PjonHL::Address{1}, PjonHL::Address{2}, PjonHL::Address{3}});
+    REQUIRE(group.isBroadcastCollapsed() == false);
+
+    shadow().setSendResultSequence({true, false, true});
+    shadow().setDefaultSendResult(true);
+    auto result = group.send(std::vector<uint8_t>{0xab, 0xcd}, 1000, false).get();
+
+    REQUIRE(3 == shadow().sendCount);
+    REQUIRE(shadow().lastSendInfo.rx.id == 3);
+    REQUIRE(shadow().lastSendPayloadCopy == std::vector<uint8_t>{0xab, 0xcd});
+    REQUIRE(result.broadcast == false);
+    REQUIRE(result.members.size() == 3);
+    REQUIRE(result.members[0].address.id == 1);
+    REQUIRE(result.members[0].result.isGood() == true);
+    REQUIRE(result.members[1].result.isGood() == false);
+    REQUIRE(result.members[2].result.isGood() == true);
+    REQUIRE(result.getSuccessCount() == 2);
+    REQUIRE(result.isGood() == false);
+    REQUIRE(bus.getMetrics().packetsSent == 2);
+}
+
+TEST_CASE( "Multicast shares one payload", "" ) {
+    shadow().reset();
+    PjonHL::Bus<Strategy> bus(PjonHL::Address{36}, Strategy{});
+    PjonHL::MulticastGroup<Strategy> group(bus, {PjonHL::Address{1}, PjonHL::Address{2}});
+    shadow().setDefaultSendResult(true);
+    shadow().setHoldInFlight(true);
+
+    auto future = group.send(std::vector<uint8_t>{0x01});
+    waitForSendCount(1);
+    const void * firstPayload = shadow().lastSendPayload;
+    shadow().setHoldInFlight(false);
+    shadow().releaseInFlight();
+    REQUIRE(future.get().isGood() == true);
+    REQUIRE(shadow().lastSendPayload == firstPayload);
+}
+
+TEST_CASE( "Multicast waits for tx queue space", "" ) {
+    shadow().reset();
+    PjonHL::BusConfig config;
+    config.txQueue.maxPackets = 2;
+    config.txQueue.overflowPolicy = PjonHL::BusConfig::TxQueueConfig::OverflowPolicy::Block;
+    config.txQueue.blockTimeoutMilliseconds = 5000;
+    PjonHL::Bus<Strategy> bus(PjonHL::Address{36}, Strategy{}, config);
+    PjonHL::MulticastGroup<Strategy> group(bus, {
+            PjonHL::Address{1}, PjonHL::Address{2}, PjonHL::Address{3}, PjonHL::Address{4}, PjonHL::Address{5}
+            });
+    shadow().setDefaultSendResult(true);
+
+    // group is larger than the queue, members are queued as space frees up:
+    auto result = group.send(std::vector<uint8_t>{0x01}).get();
+
+    REQUIRE(result.isGood() == true);
+    REQUIRE(5 == shadow().sendCount);
+    REQUIRE(shadow().lastSendInfo.rx.id == 5);
+    REQUIRE(bus.getMetrics().txQueueRejects == 0);
+    REQUIRE(bus.getMetrics().txQueueWaits > 0);
+    REQUIRE(bus.getMetrics().txQueueDepth.peak == 2);
+    REQUIRE(bus.getMetrics().txQueueDepth.current == 0);
+}
+
+TEST_CASE( "Multicast rejects members once tx queue is full", "" ) {
+    shadow().reset();
+    PjonHL::BusConfig config;
+    config.txQueue.maxPackets = 2;
+    PjonHL::Bus<Strategy> bus(PjonHL::Address{36}, Strategy{}, config);
+    PjonHL::MulticastGroup<Strategy> group(bus, {PjonHL::Address{1}, PjonHL::Address{2}, PjonHL::Address{3}});
+    shadow().setDefaultSendResult(true);
+    shadow().setHoldInFlight(true);
+
+    auto future = group.send(std::vector<uint8_t>{0x01});
+    shadow().setHoldInFlight(false);
+    shadow().releaseInFlight();
+    auto result = future.get();
+
+    REQUIRE(result.getSuccessCount() == 2);
+    REQUIRE(result.members[2].result.isTxQueueFull() == true);
+    REQUIRE(bus.getMetrics().txQueueRejects == 1);
+}
+
+TEST_CASE( "Multicast empty group", "" ) {
+    shadow().reset();
+    PjonHL::Bus<Strategy> bus(PjonHL::Address{36}, Strategy{});
+    PjonHL::MulticastGroup<Strategy> group(bus, {});
+    auto result = group.send(std::vector<uint8_t>{0x01}).get();
+    REQUIRE(result.members.empty() == true);
+    REQUIRE(result.isGood() == true);
+    REQUIRE(0 == shadow().sendCount);
+}
+
+TEST_CASE( "Multicast broadcast collapse", "" ) {
+    shadow().reset();
+    PjonHL::Bus<Strategy> bus(PjonHL::Address{36}, Strategy{});
+    shadow().setDefaultSendResult(true);
+    PjonHL::MulticastConfig config;
+    config.membersCoverBus = true;
+    config.ackTimeoutMilliseconds = 100;
+    uint8_t ack = 0x06;
+    uint8_t notAck = 0x15;
+    config.isAcknowledgement = [](const PjonHL::ReceivedPacket & f_packet){ return f_packet.payload.at(0) == 0x06; };
+
+    SECTION("with unicast fallback") {
+        PjonHL::MulticastGroup<Strategy> group(bus, {PjonHL::Address{1}, PjonHL::Address{2}, PjonHL::Address{3}}, config);
+        REQUIRE(group.isBroadcastCollapsed() == true);
+        auto future = group.send(std::vector<uint8_t>{0x42});
+        waitForSendCount(1);
+        REQUIRE(shadow().lastSendInfo.rx.id == PJON_BROADCAST);
+        enqueueAcknowledgement(1, &ack);
+        enqueueAcknowledgement(3, &notAck);
+        enqueueAcknowledgement(3, &ack);
+        auto result = future.get();
+
+        // member 2 did not answer and was sent the packet individually:
+        REQUIRE(2 == shadow().sendCount);
+        REQUIRE(shadow().lastSendInfo.rx.id == 2);
+        REQUIRE(result.broadcast == true);
+        REQUIRE(result.isGood() == true);
+    }
+    SECTION("without unicast fallback") {
+        config.unicastFallback = false;
+        PjonHL::MulticastGroup<Strategy> group(bus, {PjonHL::Address{1}, PjonHL::Address{2}}, config);
+        auto future = group.send(std::vector<uint8_t>{0x42});
+        waitForSendCount(1);
+        enqueueAcknowledgement(2, &ack);
+        // not a member:
+        enqueueAcknowledgement(9, &ack);
+        auto result = future.get();
+
+        REQUIRE(1 == shadow().sendCount);
+        REQUIRE(result.broadcast == true);
+        REQUIRE(result.members[0].result.isGood() == false);
+        REQUIRE(result.members[1].result.isGood() == true);
+    }
+}
+
+TEST_CASE( "Multicast broadcast does not block an ignored result", "" ) {
+    shadow().reset();
+    PjonHL::Bus<Strategy> bus(PjonHL::Address{36}, Strategy{});
+    shadow().setDefaultSendResult(true);
+    PjonHL::MulticastConfig config;
+    config.membersCoverBus = true;
+    config.ackTimeoutMilliseconds = 300;
+    config.unicastFallback = false;
+    auto start = std::chrono::steady_clock::now();
+    {
+        PjonHL::MulticastGroup<Strategy> group(bus, {PjonHL::Address{1}, PjonHL::Address{2}}, config);
+        group.send(std::vector<uint8_t>{0x42});
+        REQUIRE(std::chrono::steady_clock::now() - start < std::chrono::milliseconds(200));
+        // group waits for the running broadcast, which still uses the bus:
+    }
+    REQUIRE(std::chrono::steady_clock::now() - start >= std::chrono::milliseconds(300));
+    REQUIRE(1 == shadow().sendCount);
+}
+
+TEST_CASE( "Multicast broadcast needs common bus and port", "" ) {
+    shadow().reset();
+    PjonHL::Bus<Strategy> bus(PjonHL::Address{36}, Strategy{});
+    PjonHL::MulticastConfig config;
+    config.membersCoverBus = true;
+
+    PjonHL::MulticastGroup<Strategy> differentPorts(bus, {PjonHL::Address("1:10"), PjonHL::Address("2:11")}, config);
+    REQUIRE(differentPorts.isBroadcastCollapsed() == false);
+    PjonHL::MulticastGroup<Strategy> differentBuses(bus, {PjonHL::Address("0.0.0.1/1"), PjonHL::Address("0.0.0.2/1")}, config);
+    REQUIRE(differentBuses.isBroadcastCollapsed() == false);
+    PjonHL::MulticastGroup<Strategy> sameBus(bus, {PjonHL::Address("0.0.0.1/1:10"), PjonHL::Address("0.0.0.1/2:10")}, config);
+    REQUIRE(sameBus.isBroadcastCollapsed() == true);
+}
@@ -0,0 +1,264 @@
+// Copyright 2021 Rainer Schoenberger
+// 
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+// 
+//     http://www.apache.org/licenses/LICENSE-2.0
+// 
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+// Mock of the PJON backend used by unit-tests and benchmarks.
+// Include after PjonHlBus.hpp. All PJON instances forward to the singleton
+// shadow(), so tests can control and monitor what PjonHL does with PJON.
+
+#include "PJONDefines.h"
+#include <atomic>
+#include <inttypes.h>
+#include <mutex>
+#include <vector>
+#include <queue>
+
+// Mock Strategy
+class Strategy
+{
+};
+
+class PJONShadow
+{
+    struct RxPacket
+    {
+        uint8_t *payload;
+        uint16_t length;
+        PJON_Packet_Info packet_info;
+    };
+    public:
+
+    void set_error(PJON_Error e) {
+      _error = e;
+    };
+
+    void set_receiver(PJON_Receiver r) {
+      _receiver = r;
+    };
+
+    void begin()
+    {
+    }
+
+    uint16_t update() {
+        if(m_releaseInFlight)
+        {
+            m_releaseInFlight = false;
+            packets[0].state = 0;
+        }
+        if(m_numErrorQueued>0)
+        {
+            m_numErrorQueued--;
+            _error(0,0,0);
+        }
+        return 0;
+    }
+    uint16_t receive() {
+        std::lock_guard<std::mutex> guard(m_rxPacketQueueMutex);
+        if(m_rxPacketQueue.size() > 0)
+        {
+            RxPacket & packet = m_rxPacketQueue.front();
+            _receiver(packet.payload, packet.length, packet.packet_info);
+            m_rxPacketQueue.pop();
+        }
+        return 0;
+    }
+
+    uint16_t send(
+      const PJON_Packet_Info &info,
+      const void *payload,
+      uint16_t length
+    )
+    {
+        sendCount++;
+        lastSendInfo = info;
+        lastSendPayload = payload;
+        lastSendPayloadCopy.assign(static_cast<const uint8_t*>(payload), static_cast<const uint8_t*>(payload) + length);
+        if(not m_sendResultSequence.empty())
+        {
+            m_nextSendResult = m_sendResultSequence.front();
+            m_sendResultSequence.pop();
+        }
+        packets[0].state = (m_nextSendResult and not m_holdInFlight)?0:1;
+        if(m_nextSendResult == false)
+        {
+            m_numErrorQueued++;
+        }
+        m_nextSendResult = m_defaultSendResult;
+        return 0;
+    };
+
+    PJON_Error _error;
+    PJON_Receiver _receiver;
+    Strategy strategy;
+    PJON_Packet * packets;
+
+    // test functionality:
+    size_t sendCount = 0;
+    // payload pointer and content of the last send() call:
+    PJON_Packet_Info lastSendInfo;
+    const void * lastSendPayload = nullptr;
+    std::vector<uint8_t> lastSendPayloadCopy;
+    size_t getRxQueueSize()
+    {
+        std::lock_guard<std::mutex> guard(m_rxPacketQueueMutex);
+        return m_rxPacketQueue.size();
+    }
+    void reset()
+    {
+        sendCount = 0;
+        lastSendPayload = nullptr;
+        lastSendPayloadCopy.clear();
+        _error = static_cast<PJON_Error>(nullptr);
+        _receiver = static_cast<PJON_Receiver>(nullptr);
+        strategy = Strategy();
+        packets = nullptr;
+        while(not m_rxPacketQueue.empty())
+        {
+            m_rxPacketQueue.pop();
+        }
+        m_numErrorQueued = 0;
+        m_holdInFlight = false;
+        m_releaseInFlight = false;
+        m_nextSendResult = false;
+        m_defaultSendResult = false;
+        while(not m_sendResultSequence.empty())
+        {
+            m_sendResultSequence.pop();
+        }
+    }
+
+    void setNextSendResult(bool result)
+    {
+        m_nextSendResult = result;
+    }
+    bool m_nextSendResult = false;
+
+    // result of all send() calls following the next one
+    void setDefaultSendResult(bool result)
+    {
+        m_defaultSendResult = result;
+        m_nextSendResult = result;
+    }
+    bool m_defaultSendResult = false;
+
+    // results for the next send() calls, takes precedence over m_nextSendResult
+    void setSendResultSequence(std::vector<bool> results)
+    {
+        for(bool result : results)
+        {
+            m_sendResultSequence.push(result);
+        }
+    }
+    std::queue<bool> m_sendResultSequence;
+
+    // successfully sent packets stay in transmission until
+    // releaseInFlight() is called:
+    void setHoldInFlight(bool hold)
+    {
+        m_holdInFlight = hold;
+    }
+    void releaseInFlight()
+    {
+        m_releaseInFlight = true;
+    }
+    std::atomic<bool> m_holdInFlight{false};
+    std::atomic<bool> m_releaseInFlight{false};
+
+    size_t m_numErrorQueued = 0;
+
+    std::queue<RxPacket> m_rxPacketQueue;
+
+    void enqueuePacketForRx(
+            uint8_t *payload,
+            uint16_t length,
+            const PJON_Packet_Info &packet_info
+            )
+    {
+        std::lock_guard<std::mutex> guard(m_rxPacketQueueMutex);
+        RxPacket packet;
+        packet.payload = payload;
+        packet.length = length;
+        packet.packet_info = packet_info;
+        m_rxPacketQueue.push(packet);
+    }
+    std::mutex m_rxPacketQueueMutex;
+};
+
+inline PJONShadow & shadow()
+{
+    static PJONShadow shadow;
+    return shadow;
+}
+
+// Mock PJON class. Forwards all calls to a singleton shadow class, so that we
+// can monitor what PjonHL is doing with the PJON backend
+template<class Strategy>
+class PJON
+{
+    public:
+    PJON(const uint8_t *b_id, uint8_t device_id)
+    {
+        shadow().packets = packets;
+        shadow().strategy = strategy;
+    }
+
+    void set_error(PJON_Error e) {
+        shadow().set_error(e);
+    };
+
+    void set_receiver(PJON_Receiver r) {
+        shadow().set_receiver(r);
+    };
+
+    void begin()
+    {
+        shadow().begin();
+    }
+
+    uint16_t update() {
+        return shadow().update();
+    }
+    uint16_t receive() {
+        return shadow().receive();
+    }
+
+    uint16_t send(
+      const PJON_Packet_Info &info,
+      const void *payload,
+      uint16_t length
+    )
+    {
+        return shadow().send(info, payload, length);
+    };
+
+    void set_acknowledge(bool)
+    {
+    }
+    void set_crc_32(bool)
+    {
+    }
+    void set_communication_mode(bool)
+    {
+    }
+    void set_shared_network(bool)
+    {
+    }
+
+    PJON_Error _error;
+    PJON_Receiver _receiver;
+    Strategy strategy;
+    PJON_Packet packets[PJON_MAX_PACKETS];
+};
@@ -0,0 +1,64 @@
+// Copyright 2021 Rainer Schoenberger
+// 
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+// 
+//     http://www.apache.org/licenses/LICENSE-2.0
+// 
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "catch2/catch.hpp"
+#include "PortDispatcher.hpp"
+#include "PjonHlBus.hpp"
+
+using namespace PjonHL;
+
+TEST_CASE( "PortDispatcher find", "" ) {
+    PortDispatcher dispatcher;
+    REQUIRE(dispatcher.empty() == true);
+    REQUIRE(dispatcher.find(0) == nullptr);
+    REQUIRE(dispatcher.find(0xffff) == nullptr);
+
+    uint16_t calledPort = 0;
+    for(uint16_t port : {0, 1, 255, 256, 8000, 0xffff})
+    {
+        dispatcher.set(port, [&calledPort, port](ConstBuffer, const ReceivedPacketInfo &){ calledPort = port; });
+    }
+    REQUIRE(dispatcher.size() == 6);
+
+    for(uint16_t port : {0, 1, 255, 256, 8000, 0xffff})
+    {
+        const PortDispatcher::Handler * handler = dispatcher.find(port);
+        REQUIRE(handler != nullptr);
+        (*handler)(ConstBuffer(), ReceivedPacketInfo());
+        REQUIRE(calledPort == port);
+    }
+    for(uint16_t port : {2, 254, 257, 7999, 0xfffe})
+    {
+        REQUIRE(dispatcher.find(port) == nullptr);
+    }
+}
+
+TEST_CASE( "PortDispatcher replace and remove", "" ) {
+    PortDispatcher dispatcher;
+    int called = 0;
+    dispatcher.set(42, [&](ConstBuffer, const ReceivedPacketInfo &){ called = 1; });
+    dispatcher.set(42, [&](ConstBuffer, const ReceivedPacketInfo &){ called = 2; });
+    REQUIRE(dispatcher.size() == 1);
+    (*dispatcher.find(42))(ConstBuffer(), ReceivedPacketInfo());
+    REQUIRE(called == 2);
+
+    dispatcher.set(42, PortDispatcher::Handler());
+    REQUIRE(dispatcher.size() == 0);
+    REQUIRE(dispatcher.find(42) == nullptr);
+
+    // removing a port which has no handler:
+    dispatcher.set(43, PortDispatcher::Handler());
+    dispatcher.set(4300, PortDispatcher::Handler());
+    REQUIRE(dispatcher.empty() == true);
+}
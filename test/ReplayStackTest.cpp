@@ -0,0 +1,104 @@
+// Copyright 2021 Rainer Schoenberger
+// 
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+// 
+//     http://www.apache.org/licenses/LICENSE-2.0
+// 
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Records traffic of the full stack (PjonHL + real PJON) on a VirtualMedium
+// and replays it with ReplayStrategy. Part of the stack test executable.
+
+#include "catch2/catch.hpp"
+
+#include <PJON.h>
+#include "PjonHlBus.hpp"
+#include "strategies/ReplayStrategy.hpp"
+#include "strategies/VirtualMedium.hpp"
+#include "strategies/VirtualRemoteNode.hpp"
+#include <cstdio>
+
+using PjonHL::Address;
+using PjonHL::Bus;
+using PjonHL::RecordingStrategy;
+using PjonHL::ReplayConfig;
+using PjonHL::ReplaySession;
+using PjonHL::ReplayStrategy;
+using PjonHL::ReplayTrace;
+using PjonHL::VirtualMedium;
+using PjonHL::VirtualRemoteNode;
+using PjonHL::VirtualWire;
+
+namespace
+{
+class SilentLogger : public PjonHL::Logger
+{
+    public:
+        virtual void log(LogLevel f_level, std::string f_message) override
+        {
+        }
+};
+
+std::unique_ptr<PjonHL::Logger> silentLogger()
+{
+    auto logger = std::make_unique<SilentLogger>();
+    logger->setLevel(PjonHL::Logger::Error);
+    return logger;
+}
+}
+
+TEST_CASE( "Replay recorded stack traffic", "" ) {
+    std::string path = "/tmp/PjonHLStackTest.trace";
+    {
+        VirtualWire::Config config;
+        config.baudRate = 0;
+        config.seed = 1;
+        auto wire = std::make_shared<VirtualWire>(config);
+        auto writer = std::make_shared<PjonHL::TraceWriter>(path);
+        VirtualRemoteNode node(wire, Address{42}, VirtualRemoteNode::echo());
+        Bus<RecordingStrategy<VirtualMedium>> bus(
+                Address{36},
+                RecordingStrategy<VirtualMedium>(VirtualMedium(wire), writer),
+                PjonHL::BusConfig{},
+                silentLogger()
+                );
+        auto connection = bus.createConnection(Address{42});
+        for(uint8_t i = 0; i < 5; i++)
+        {
+            REQUIRE(connection->send({i, 0xab}).get().isGood());
+            REQUIRE(connection->receive(1000).isValid());
+        }
+        writer->flush();
+    }
+
+    auto trace = ReplayTrace::load(path);
+    REQUIRE(trace.frames.size() == 10);
+
+    ReplayConfig config;
+    config.timing = ReplayConfig::Timing::AsFastAsPossible;
+    config.autoStart = false;
+    auto session = std::make_shared<ReplaySession>(trace, config);
+    Bus<ReplayStrategy> bus(Address{36}, ReplayStrategy(session), PjonHL::BusConfig{}, silentLogger());
+    auto connection = bus.createConnection(Address{42});
+    REQUIRE(session->isFinished() == false);
+    session->start();
+    REQUIRE(session->waitUntilFinished(std::chrono::seconds(5)));
+
+    // consumer sees the recorded packets and sends the same requests again:
+    for(uint8_t i = 0; i < 5; i++)
+    {
+        auto packet = connection->receive(1000);
+        REQUIRE(packet.isValid());
+        REQUIRE(packet.unwrap().payload == std::vector<uint8_t>{i, 0xab});
+        REQUIRE(connection->send({i, 0xab}).get().isGood());
+    }
+    REQUIRE(session->compare().isEqual());
+    REQUIRE(session->getStatistics().framesInjected == 5);
+    std::remove(path.c_str());
+}
@@ -0,0 +1,270 @@
+// Copyright 2021 Rainer Schoenberger
+// 
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+// 
+//     http://www.apache.org/licenses/LICENSE-2.0
+// 
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "catch2/catch.hpp"
+
+#include "strategies/ReplayStrategy.hpp"
+#include <cstdio>
+#include <fstream>
+
+using PjonHL::ReplayConfig;
+using PjonHL::ReplaySession;
+using PjonHL::ReplayStrategy;
+using PjonHL::ReplayTrace;
+
+namespace
+{
+// Minimal strategy delivering scripted frames, for testing RecordingStrategy:
+class ScriptedStrategy
+{
+    public:
+        std::vector<std::vector<uint8_t>> rxFrames;
+        std::vector<std::vector<uint8_t>> txFrames;
+
+        uint32_t back_off(uint8_t) { return 0; }
+        bool begin(uint8_t = 0) { return true; }
+        bool can_start() { return true; }
+        uint8_t get_max_attempts() { return 1; }
+        uint16_t get_receive_time() { return 0; }
+        void handle_collision() {}
+        uint16_t receive_frame(uint8_t * f_data, uint16_t f_maxLength)
+        {
+            if(rxFrames.empty())
+            {
+                return PJON_FAIL;
+            }
+            std::copy(rxFrames.front().begin(), rxFrames.front().end(), f_data);
+            uint16_t length = rxFrames.front().size();
+            rxFrames.erase(rxFrames.begin());
+            return length;
+        }
+        uint16_t receive_response() { return PJON_ACK; }
+        void send_response(uint8_t) {}
+        void send_frame(uint8_t * f_data, uint16_t f_length) { txFrames.emplace_back(f_data, f_data + f_length); }
+};
+}
+
+TEST_CASE( "Replay trace roundtrip", "" ) {
+    std::string path = "/tmp/PjonHLTest_roundtrip.trace";
+    ReplayTrace trace;
+    trace.add(ReplayTrace::Direction::Rx, std::chrono::microseconds(0), {1, 2, 3});
+    trace.add(ReplayTrace::Direction::Tx, std::chrono::microseconds(150), {4});
+    trace.add(ReplayTrace::Direction::Rx, std::chrono::microseconds(1000000), std::vector<uint8_t>(300, 0xab));
+    trace.save(path);
+
+    auto loaded = ReplayTrace::load(path);
+    REQUIRE(loaded.frames.size() == 3);
+    for(size_t i = 0; i < 3; i++)
+    {
+        REQUIRE(loaded.frames[i].direction == trace.frames[i].direction);
+        REQUIRE(loaded.frames[i].time == trace.frames[i].time);
+        REQUIRE(loaded.frames[i].data == trace.frames[i].data);
+    }
+
+    // header (9) + 3 records with 1 byte direction, 1-3 bytes delta, 1-2 bytes length:
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    REQUIRE(file.tellg() == 9 + (3 + 3) + (4 + 1) + (6 + 300));
+    std::remove(path.c_str());
+}
+
+TEST_CASE( "Replay trace invalid files", "" ) {
+    REQUIRE_THROWS_AS(ReplayTrace::load("/nonexistent/dir/trace"), std::runtime_error);
+
+    std::string path = "/tmp/PjonHLTest_invalid.trace";
+    {
+        std::ofstream file(path, std::ios::binary);
+        file << "no trace file";
+    }
+    REQUIRE_THROWS_AS(ReplayTrace::load(path), std::runtime_error);
+
+    // truncated frame:
+    ReplayTrace trace;
+    trace.add(ReplayTrace::Direction::Rx, std::chrono::microseconds(0), {1, 2, 3});
+    trace.save(path);
+    std::ifstream in(path, std::ios::binary);
+    std::string content((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    {
+        std::ofstream file(path, std::ios::binary | std::ios::trunc);
+        file << content.substr(0, content.size() - 1);
+    }
+    REQUIRE_THROWS_AS(ReplayTrace::load(path), std::runtime_error);
+    std::remove(path.c_str());
+}
+
+TEST_CASE( "Replay injects frames as fast as possible", "" ) {
+    ReplayTrace trace;
+    trace.add(ReplayTrace::Direction::Rx, std::chrono::microseconds(0), {1});
+    trace.add(ReplayTrace::Direction::Rx, std::chrono::seconds(100), {2, 2});
+    ReplayConfig config;
+    config.timing = ReplayConfig::Timing::AsFastAsPossible;
+    auto session = std::make_shared<ReplaySession>(trace, config);
+    ReplayStrategy strategy(session);
+
+    uint8_t buffer[16];
+    REQUIRE(strategy.begin());
+    REQUIRE(session->isFinished() == false);
+    REQUIRE(strategy.receive_frame(buffer, sizeof(buffer)) == 1);
+    REQUIRE(buffer[0] == 1);
+    REQUIRE(strategy.receive_frame(buffer, sizeof(buffer)) == 2);
+    REQUIRE(strategy.receive_frame(buffer, sizeof(buffer)) == PJON_FAIL);
+    REQUIRE(session->isFinished() == true);
+    REQUIRE(session->waitUntilFinished(std::chrono::seconds(0)) == true);
+
+    auto statistics = session->getStatistics();
+    REQUIRE(statistics.framesInjected == 2);
+    REQUIRE(statistics.bytesInjected == 3);
+    REQUIRE(statistics.duration < std::chrono::seconds(1));
+}
+
+TEST_CASE( "Replay drops frames larger than the receive buffer", "" ) {
+    ReplayTrace trace;
+    trace.add(ReplayTrace::Direction::Rx, std::chrono::microseconds(0), {1, 1, 1, 1});
+    trace.add(ReplayTrace::Direction::Rx, std::chrono::microseconds(0), {2});
+    ReplayConfig config;
+    config.timing = ReplayConfig::Timing::AsFastAsPossible;
+    auto session = std::make_shared<ReplaySession>(trace, config);
+    ReplayStrategy strategy(session);
+
+    uint8_t buffer[2];
+    REQUIRE(strategy.begin());
+    REQUIRE(strategy.receive_frame(buffer, sizeof(buffer)) == PJON_FAIL);
+    REQUIRE(strategy.receive_frame(buffer, sizeof(buffer)) == 1);
+    REQUIRE(buffer[0] == 2);
+    REQUIRE(session->isFinished() == true);
+
+    auto statistics = session->getStatistics();
+    REQUIRE(statistics.framesInjected == 1);
+    REQUIRE(statistics.bytesInjected == 1);
+    REQUIRE(statistics.framesDropped == 1);
+}
+
+TEST_CASE( "Replay started manually", "" ) {
+    ReplayTrace trace;
+    trace.add(ReplayTrace::Direction::Rx, std::chrono::microseconds(0), {1});
+    ReplayConfig config;
+    config.autoStart = false;
+    auto session = std::make_shared<ReplaySession>(trace, config);
+    ReplayStrategy strategy(session);
+
+    uint8_t buffer[16];
+    REQUIRE(strategy.receive_frame(buffer, sizeof(buffer)) == PJON_FAIL);
+    REQUIRE(session->isFinished() == false);
+    REQUIRE(session->getStatistics().duration == std::chrono::seconds(0));
+    session->start();
+    REQUIRE(strategy.receive_frame(buffer, sizeof(buffer)) == 1);
+    REQUIRE(session->isFinished() == true);
+
+    // empty trace is finished right after start:
+    auto emptySession = std::make_shared<ReplaySession>(ReplayTrace{}, config);
+    REQUIRE(emptySession->isFinished() == false);
+    emptySession->start();
+    REQUIRE(emptySession->isFinished() == true);
+}
+
+TEST_CASE( "Replay timing", "" ) {
+    ReplayTrace trace;
+    trace.add(ReplayTrace::Direction::Rx, std::chrono::microseconds(0), {1});
+    trace.add(ReplayTrace::Direction::Rx, std::chrono::milliseconds(200), {2});
+
+    ReplayConfig config;
+    SECTION("original") {
+        config.timing = ReplayConfig::Timing::Original;
+    }
+    SECTION("speed up") {
+        config.timing = ReplayConfig::Timing::SpeedUp;
+        config.speedUp = 4;
+    }
+    auto session = std::make_shared<ReplaySession>(trace, config);
+    ReplayStrategy strategy(session);
+    std::chrono::milliseconds expected(config.timing == ReplayConfig::Timing::Original ? 200 : 50);
+
+    uint8_t buffer[16];
+    auto start = std::chrono::steady_clock::now();
+    REQUIRE(strategy.receive_frame(buffer, sizeof(buffer)) == 1);
+    while(strategy.receive_frame(buffer, sizeof(buffer)) == PJON_FAIL)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    REQUIRE(elapsed >= expected);
+    REQUIRE(elapsed < expected + std::chrono::milliseconds(100));
+    REQUIRE(session->isFinished());
+}
+
+TEST_CASE( "Replay compares transmitted frames", "" ) {
+    ReplayTrace trace;
+    trace.add(ReplayTrace::Direction::Tx, std::chrono::microseconds(0), {1, 2});
+    trace.add(ReplayTrace::Direction::Tx, std::chrono::microseconds(0), {3, 4});
+    trace.add(ReplayTrace::Direction::Tx, std::chrono::microseconds(0), {5, 6});
+    auto session = std::make_shared<ReplaySession>(trace);
+    ReplayStrategy strategy(session);
+
+    // nothing transmitted yet:
+    auto comparison = session->compare();
+    REQUIRE(comparison.isEqual() == false);
+    REQUIRE(comparison.missing == 3);
+    REQUIRE(comparison.firstDifference == 0);
+
+    uint8_t frame1[] = {1, 2};
+    uint8_t frame2[] = {3, 5};
+    strategy.send_frame(frame1, sizeof(frame1));
+    strategy.send_frame(frame2, sizeof(frame2));
+    REQUIRE(strategy.receive_response() == PJON_ACK);
+    comparison = session->compare();
+    REQUIRE(comparison.matched == 1);
+    REQUIRE(comparison.mismatched == 1);
+    REQUIRE(comparison.missing == 1);
+    REQUIRE(comparison.unexpected == 0);
+    REQUIRE(comparison.firstDifference == 1);
+    REQUIRE(session->getTransmittedFrames().size() == 2);
+    REQUIRE(session->getStatistics().framesTransmitted == 2);
+
+    // ACKs can be disabled:
+    ReplayConfig config;
+    config.acknowledge = false;
+    ReplayStrategy noAck(std::make_shared<ReplaySession>(trace, config));
+    REQUIRE(noAck.receive_response() == PJON_FAIL);
+
+    // strategy without session:
+    ReplayStrategy unattached;
+    REQUIRE(unattached.begin() == false);
+    REQUIRE(unattached.receive_frame(frame1, sizeof(frame1)) == PJON_FAIL);
+}
+
+TEST_CASE( "Recording strategy records replayable trace", "" ) {
+    std::string path = "/tmp/PjonHLTest_recording.trace";
+    {
+        ScriptedStrategy scripted;
+        scripted.rxFrames = {{1, 2, 3}, {4}};
+        PjonHL::RecordingStrategy<ScriptedStrategy> recording(scripted, std::make_shared<PjonHL::TraceWriter>(path));
+        uint8_t buffer[16];
+        REQUIRE(recording.receive_frame(buffer, sizeof(buffer)) == 3);
+        uint8_t frame[] = {9, 8};
+        recording.send_frame(frame, sizeof(frame));
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        REQUIRE(recording.receive_frame(buffer, sizeof(buffer)) == 1);
+        REQUIRE(recording.receive_frame(buffer, sizeof(buffer)) == PJON_FAIL);
+        REQUIRE(recording.getStrategy().txFrames.size() == 1);
+    }
+
+    auto trace = ReplayTrace::load(path);
+    REQUIRE(trace.frames.size() == 3);
+    REQUIRE(trace.frames[0].direction == ReplayTrace::Direction::Rx);
+    REQUIRE(trace.frames[0].data == std::vector<uint8_t>{1, 2, 3});
+    REQUIRE(trace.frames[1].direction == ReplayTrace::Direction::Tx);
+    REQUIRE(trace.frames[1].data == std::vector<uint8_t>{9, 8});
+    REQUIRE(trace.frames[2].data == std::vector<uint8_t>{4});
+    REQUIRE(trace.frames[2].time - trace.frames[1].time >= std::chrono::milliseconds(20));
+    std::remove(path.c_str());
+}
@@ -0,0 +1,98 @@
+// Copyright 2021 Rainer Schoenberger
+// 
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+// 
+//     http://www.apache.org/licenses/LICENSE-2.0
+// 
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "catch2/catch.hpp"
+
+#include "RetransmitPolicy.hpp"
+
+using namespace std::chrono_literals;
+
+TEST_CASE( "Retransmit initial RTO", "" ) {
+    PjonHL::BusConfig::RetransmitConfig config;
+    config.initialRtoMilliseconds = 123;
+    PjonHL::RetransmitPolicy policy(config);
+    REQUIRE(policy.getRetransmitTimeout(PjonHL::Address{42}) == 123ms);
+    REQUIRE(policy.getMaxAttempts(PjonHL::Address{42}) == config.maxAttempts);
+}
+
+TEST_CASE( "Retransmit RTO follows RTT", "" ) {
+    PjonHL::BusConfig::RetransmitConfig config;
+    config.minRtoMilliseconds = 1;
+    PjonHL::RetransmitPolicy policy(config);
+    for(int i = 0; i < 50; i++)
+    {
+        policy.reportSuccess(PjonHL::Address{42}, 10ms);
+        policy.reportSuccess(PjonHL::Address{43}, 1000ms);
+    }
+    // no variance, so RTO converges towards RTT:
+    REQUIRE(policy.getRetransmitTimeout(PjonHL::Address{42}) < 12ms);
+    REQUIRE(policy.getRetransmitTimeout(PjonHL::Address{42}) >= 10ms);
+    REQUIRE(policy.getRetransmitTimeout(PjonHL::Address{43}) >= 1000ms);
+
+    // port is not relevant for remote statistics:
+    REQUIRE(policy.getRetransmitTimeout(PjonHL::Address{"42:1337"}) == policy.getRetransmitTimeout(PjonHL::Address{42}));
+}
+
+TEST_CASE( "Retransmit RTO bounds", "" ) {
+    PjonHL::BusConfig::RetransmitConfig config;
+    config.minRtoMilliseconds = 20;
+    config.maxRtoMilliseconds = 500;
+    PjonHL::RetransmitPolicy policy(config);
+    policy.reportSuccess(PjonHL::Address{42}, 1ms);
+    policy.reportSuccess(PjonHL::Address{43}, 10s);
+    REQUIRE(policy.getRetransmitTimeout(PjonHL::Address{42}) == 20ms);
+    REQUIRE(policy.getRetransmitTimeout(PjonHL::Address{43}) == 500ms);
+}
+
+TEST_CASE( "Retransmit exponential backoff", "" ) {
+    PjonHL::BusConfig::RetransmitConfig config;
+    config.initialRtoMilliseconds = 100;
+    config.maxRtoMilliseconds = 1000;
+    PjonHL::RetransmitPolicy policy(config);
+    for(int i = 0; i < 20; i++)
+    {
+        auto first = policy.getBackoff(PjonHL::Address{42}, 1);
+        REQUIRE(first >= 50ms);
+        REQUIRE(first <= 100ms);
+        auto third = policy.getBackoff(PjonHL::Address{42}, 3);
+        REQUIRE(third >= 200ms);
+        REQUIRE(third <= 400ms);
+        auto capped = policy.getBackoff(PjonHL::Address{42}, 200);
+        REQUIRE(capped >= 500ms);
+        REQUIRE(capped <= 1000ms);
+    }
+}
+
+TEST_CASE( "Retransmit recent failures reduce attempts", "" ) {
+    PjonHL::BusConfig::RetransmitConfig config;
+    config.maxAttempts = 3;
+    config.failureMemoryMilliseconds = 1000;
+    PjonHL::RetransmitPolicy policy(config);
+    auto now = std::chrono::steady_clock::now();
+
+    policy.reportFailure(PjonHL::Address{42}, now);
+    REQUIRE(policy.getMaxAttempts(PjonHL::Address{42}, now) == 2);
+    REQUIRE(policy.getMaxAttempts(PjonHL::Address{43}, now) == 3);
+    policy.reportFailure(PjonHL::Address{42}, now);
+    policy.reportFailure(PjonHL::Address{42}, now);
+    policy.reportFailure(PjonHL::Address{42}, now);
+    REQUIRE(policy.getMaxAttempts(PjonHL::Address{42}, now) == 1);
+
+    // failures are forgotten after some time:
+    REQUIRE(policy.getMaxAttempts(PjonHL::Address{42}, now + 2s) == 3);
+
+    // or on success:
+    policy.reportSuccess(PjonHL::Address{42}, 1ms);
+    REQUIRE(policy.getMaxAttempts(PjonHL::Address{42}, now) == 3);
+}
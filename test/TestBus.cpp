@@ -17,248 +17,707 @@
 #include "PjonHlBus.hpp"
 #include "PJONDefines.h"
 #include <algorithm>
+#include <array>
+#include <future>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
 #include <inttypes.h>
 #include <vector>
 #include <queue>
 #include <thread>
+#include "PjonMock.hpp"
 
-// Mock Strategy
-class Strategy
-{
-};
-
-class PJONShadow
-{
-    struct RxPacket
+TEST_CASE( "destruct bus before connection", "" ) {
+    shadow().reset();
+    std::unique_ptr<PjonHL::Bus<Strategy>::ConnectionHandle> connection;
     {
-        uint8_t *payload;
-        uint16_t length;
-        PJON_Packet_Info packet_info;
-    };
-    public:
+        PjonHL::Bus<Strategy> bus(PjonHL::Address{}, Strategy{});
+        connection = std::make_unique<PjonHL::Bus<Strategy>::ConnectionHandle>(bus.createConnection(PjonHL::Address{}));
+    }
+    // now use connection:
+    auto future = (*connection)->send(std::vector<uint8_t>{0x00});
 
-    void set_error(PJON_Error e) {
-      _error = e;
-    };
+    REQUIRE(future.valid() == true);
+    REQUIRE(future.get().isGood() == false);
+    REQUIRE(shadow().sendCount == 0);
+}
 
-    void set_receiver(PJON_Receiver r) {
-      _receiver = r;
-    };
+TEST_CASE( "Send Succeed", "" ) {
+    shadow().reset();
+    PjonHL::Bus<Strategy> bus(PjonHL::Address{}, Strategy{});
+    auto connection = bus.createConnection(PjonHL::Address{});
+    shadow().setNextSendResult(true);
+    auto future = connection->send(std::vector<uint8_t>{0x00});
+    REQUIRE(future.valid() == true);
+    REQUIRE(future.get().isGood() == true);
+    REQUIRE(1 == shadow().sendCount);
+}
 
-    void begin()
-    {
-    }
+TEST_CASE( "Send moves payload to PJON without copy", "" ) {
+    shadow().reset();
+    PjonHL::Bus<Strategy> bus(PjonHL::Address{}, Strategy{});
+    auto connection = bus.createConnection(PjonHL::Address{});
+    shadow().setNextSendResult(true);
+    std::vector<uint8_t> payload{0x01, 0x02, 0x03};
+    const uint8_t * payloadData = payload.data();
+    REQUIRE(connection->send(std::move(payload)).get().isGood() == true);
+    REQUIRE(shadow().lastSendPayload == payloadData);
+    REQUIRE(shadow().lastSendPayloadCopy == std::vector<uint8_t>{0x01, 0x02, 0x03});
+}
 
-    uint16_t update() {
-        if(m_numErrorQueued>0)
-        {
-            m_numErrorQueued--;
-            _error(0,0,0);
-        }
-        return 0;
-    }
-    uint16_t receive() {
-        std::lock_guard<std::mutex> guard(m_rxPacketQueueMutex);
-        if(m_rxPacketQueue.size() > 0)
+TEST_CASE( "Send copies ConstBuffer payload", "" ) {
+    shadow().reset();
+    PjonHL::Bus<Strategy> bus(PjonHL::Address{}, Strategy{});
+    auto connection = bus.createConnection(PjonHL::Address{});
+    shadow().setDefaultSendResult(true);
+    uint8_t rawPayload[] = {0x0a, 0x0b};
+    REQUIRE(connection->send(rawPayload).get().isGood() == true);
+    REQUIRE(shadow().lastSendPayload != rawPayload);
+    REQUIRE(shadow().lastSendPayloadCopy == std::vector<uint8_t>{0x0a, 0x0b});
+
+    const std::vector<uint8_t> payload{0x0c};
+    REQUIRE(connection->send(payload).get().isGood() == true);
+    REQUIRE(shadow().lastSendPayloadCopy == payload);
+}
+
+TEST_CASE( "Send caller-owned buffer with completion handler", "" ) {
+    shadow().reset();
+    PjonHL::Bus<Strategy> bus(PjonHL::Address{}, Strategy{});
+    auto connection = bus.createConnection(PjonHL::Address{});
+    shadow().setNextSendResult(true);
+    std::array<uint8_t, 2> payload{0x05, 0x06};
+    std::promise<PjonHL::Result> resultPromise;
+    std::thread::id handlerThread;
+    connection->send(payload, [&](PjonHL::Result f_result)
         {
-            RxPacket & packet = m_rxPacketQueue.front();
-            _receiver(packet.payload, packet.length, packet.packet_info);
-            m_rxPacketQueue.pop();
-        }
-        return 0;
-    }
+            handlerThread = std::this_thread::get_id();
+            resultPromise.set_value(std::move(f_result));
+        });
+    REQUIRE(resultPromise.get_future().get().isGood() == true);
+    REQUIRE(handlerThread != std::this_thread::get_id());
+    REQUIRE(shadow().lastSendPayload == payload.data());
+    REQUIRE(1 == shadow().sendCount);
+}
 
-    uint16_t send(
-      const PJON_Packet_Info &info,
-      const void *payload,
-      uint16_t length
-    )
+TEST_CASE( "Send segments", "" ) {
+    shadow().reset();
+    PjonHL::Bus<Strategy> bus(PjonHL::Address{}, Strategy{});
+    auto connection = bus.createConnection(PjonHL::Address{});
+    shadow().setDefaultSendResult(true);
+    std::array<uint8_t, 2> header{0x01, 0x02};
+    std::vector<uint8_t> body{0x03, 0x04, 0x05};
+
+    REQUIRE(connection->send({header, body}).get().isGood() == true);
+    REQUIRE(shadow().lastSendPayloadCopy == std::vector<uint8_t>{0x01, 0x02, 0x03, 0x04, 0x05});
+
+    std::promise<PjonHL::Result> resultPromise;
+    connection->send({body, header}, [&](PjonHL::Result f_result){ resultPromise.set_value(std::move(f_result)); });
+    REQUIRE(resultPromise.get_future().get().isGood() == true);
+    REQUIRE(shadow().lastSendPayloadCopy == std::vector<uint8_t>{0x03, 0x04, 0x05, 0x01, 0x02});
+    REQUIRE(bus.getMetrics().bytesSent == 10);
+}
+
+TEST_CASE( "Send completion handler called on bus destruction", "" ) {
+    shadow().reset();
+    std::array<uint8_t, 1> payload{0x07};
+    std::promise<PjonHL::Result> resultPromise;
     {
-        sendCount++;
-        packets[0].state = m_nextSendResult?0:1;
-        if(m_nextSendResult == false)
+        PjonHL::Bus<Strategy> bus(PjonHL::Address{}, Strategy{});
+        auto connection = bus.createConnection(PjonHL::Address{});
+        shadow().setNextSendResult(true);
+        shadow().setHoldInFlight(true);
+        connection->send(payload, [&](PjonHL::Result f_result){ resultPromise.set_value(std::move(f_result)); });
+        while(shadow().sendCount == 0)
         {
-            m_numErrorQueued++;
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
         }
-        m_nextSendResult = false;;
-        return 0;
-    };
-
-    PJON_Error _error;
-    PJON_Receiver _receiver;
-    Strategy strategy;
-    PJON_Packet * packets;
-
-    // test functionality:
-    size_t sendCount = 0;
-    size_t getRxQueueSize()
-    {
-        std::lock_guard<std::mutex> guard(m_rxPacketQueueMutex);
-        return m_rxPacketQueue.size();
     }
-    void reset()
+    REQUIRE(resultPromise.get_future().get().isGood() == false);
+}
+
+TEST_CASE( "Send completion handler called if connection inactive", "" ) {
+    shadow().reset();
+    std::unique_ptr<PjonHL::Bus<Strategy>::ConnectionHandle> connection;
     {
-        sendCount = 0;
-        _error = static_cast<PJON_Error>(nullptr);
-        _receiver = static_cast<PJON_Receiver>(nullptr);
-        strategy = Strategy();
-        packets = nullptr;
-        while(not m_rxPacketQueue.empty())
-        {
-            m_rxPacketQueue.pop();
-        }
-        m_numErrorQueued = 0;
-        m_nextSendResult = false;
+        PjonHL::Bus<Strategy> bus(PjonHL::Address{}, Strategy{});
+        connection = std::make_unique<PjonHL::Bus<Strategy>::ConnectionHandle>(bus.createConnection(PjonHL::Address{}));
     }
+    std::array<uint8_t, 1> payload{0x08};
+    bool called = false;
+    (*connection)->send(payload, [&](PjonHL::Result f_result)
+        {
+            called = true;
+            REQUIRE(f_result.isGood() == false);
+        });
+    REQUIRE(called == true);
+    REQUIRE(shadow().sendCount == 0);
+}
 
-    void setNextSendResult(bool result)
+TEST_CASE( "Send With Bus Pause", "" ) {
+    shadow().reset();
+    PjonHL::Bus<Strategy> bus(PjonHL::Address{}, Strategy{});
+    auto connection = bus.createConnection(PjonHL::Address{});
+    shadow().setNextSendResult(true);
+
+    bus.pause();
+
+    auto future = connection->send(std::vector<uint8_t>{0x00});
+    REQUIRE(future.valid() == true);
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    // bus is paused, shadow should not have seen any traffic:
+    REQUIRE(0 == shadow().sendCount);
+
+    bus.resume();
+
+    // now bus is resumed. send should succeed now.
+    REQUIRE(future.get().isGood() == true);
+    REQUIRE(1 == shadow().sendCount);
+}
+
+TEST_CASE( "Bus pause parks event loop", "" ) {
+    shadow().reset();
+    PjonHL::Bus<Strategy> bus(PjonHL::Address{}, Strategy{});
+    auto connection = bus.createConnection(PjonHL::Address{});
+    shadow().setDefaultSendResult(true);
+
+    REQUIRE(bus.isPaused() == false);
+    for(int i = 0; i < 100; i++)
     {
-        m_nextSendResult = result;
+        bus.pause();
+        REQUIRE(bus.isPaused() == true);
+        auto iterations = bus.getMetrics().eventLoopIterations;
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        REQUIRE(bus.getMetrics().eventLoopIterations == iterations);
+        bus.resume();
+        REQUIRE(connection->send(std::vector<uint8_t>{0x00}).get().isGood() == true);
     }
-    bool m_nextSendResult = false;
+    REQUIRE(100 == shadow().sendCount);
 
-    size_t m_numErrorQueued = 0;
+    // pausing twice / resuming a running bus has no effect:
+    bus.pause();
+    bus.pause();
+    REQUIRE(bus.isPaused() == true);
+    bus.resume();
+    bus.resume();
+    REQUIRE(bus.isPaused() == false);
+}
 
-    std::queue<RxPacket> m_rxPacketQueue;
+TEST_CASE( "Bus pause finishing in-flight TX", "" ) {
+    shadow().reset();
+    PjonHL::Bus<Strategy> bus(PjonHL::Address{}, Strategy{});
+    auto connection = bus.createConnection(PjonHL::Address{});
+    shadow().setDefaultSendResult(true);
+    shadow().setHoldInFlight(true);
 
-    void enqueuePacketForRx(
-            uint8_t *payload,
-            uint16_t length,
-            const PJON_Packet_Info &packet_info
-            )
+    auto first = connection->send(std::vector<uint8_t>{0x01});
+    while(shadow().sendCount == 0)
     {
-        std::lock_guard<std::mutex> guard(m_rxPacketQueueMutex);
-        RxPacket packet;
-        packet.payload = payload;
-        packet.length = length;
-        packet.packet_info = packet_info;
-        m_rxPacketQueue.push(packet);
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
     }
-    std::mutex m_rxPacketQueueMutex;
-};
-
-PJONShadow & shadow()
-{
-    static PJONShadow shadow;
-    return shadow;
-}
-
-// Mock PJON class. Forwards all calls to a singleton shadow class, so that we
-// can monitor what PjonHL is doing with the PJON backend
-template<class Strategy>
-class PJON
-{
-    public:
-    PJON(const uint8_t *b_id, uint8_t device_id)
+
+    PjonHL::PauseOptions options;
+    options.finishInFlightTx = true;
+    auto pauseFuture = std::async(std::launch::async, [&]{ bus.pause(options); });
+    auto second = connection->send(std::vector<uint8_t>{0x02});
+    REQUIRE(pauseFuture.wait_for(std::chrono::milliseconds(50)) == std::future_status::timeout);
+
+    shadow().setHoldInFlight(false);
+    shadow().releaseInFlight();
+    pauseFuture.get();
+    REQUIRE(first.get().isGood() == true);
+
+    // second packet is not started while paused:
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    REQUIRE(1 == shadow().sendCount);
+    bus.resume();
+    REQUIRE(second.get().isGood() == true);
+    REQUIRE(2 == shadow().sendCount);
+}
+
+TEST_CASE( "Bus pause from completion handler", "" ) {
+    shadow().reset();
+    PjonHL::Bus<Strategy> bus(PjonHL::Address{}, Strategy{});
+    auto connection = bus.createConnection(PjonHL::Address{});
+    shadow().setDefaultSendResult(true);
+
+    // runs on the event-loop thread, so must not wait for it to park:
+    std::promise<PjonHL::Result> firstResult;
+    std::array<uint8_t, 1> payload{0x01};
+    connection->send(payload, [&](PjonHL::Result f_result)
+        {
+            bus.pause();
+            firstResult.set_value(std::move(f_result));
+        });
+    REQUIRE(firstResult.get_future().get().isGood() == true);
+    while(not bus.isPaused())
     {
-        shadow().packets = packets;
-        shadow().strategy = strategy;
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
     }
 
-    void set_error(PJON_Error e) {
-        shadow().set_error(e);
-    };
+    auto second = connection->send(std::vector<uint8_t>{0x02});
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    REQUIRE(1 == shadow().sendCount);
+    bus.resume();
+    REQUIRE(second.get().isGood() == true);
+    REQUIRE(2 == shadow().sendCount);
+}
 
-    void set_receiver(PJON_Receiver r) {
-        shadow().set_receiver(r);
-    };
+TEST_CASE( "Bus pause dropping queued RX", "" ) {
+    shadow().reset();
+    PjonHL::Bus<Strategy> bus(PjonHL::Address{36}, Strategy{});
+    auto connection = bus.createConnection(PjonHL::Address{42});
 
-    void begin()
+    std::vector<uint8_t> payload{0xab, 0xcd, 0xef};
+    PJON_Packet_Info info;
+    info.rx.id = 36;
+    info.tx.id = 42;
+    shadow().enqueuePacketForRx(payload.data(), payload.size(), info);
+    shadow().enqueuePacketForRx(payload.data(), payload.size(), info);
+    while(shadow().getRxQueueSize() > 0)
     {
-        shadow().begin();
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
     }
 
-    uint16_t update() {
-        return shadow().update();
+    PjonHL::PauseOptions options;
+    SECTION("hold") {
+        options.queuedRx = PjonHL::PauseOptions::QueuedRx::Hold;
+        bus.pause(options);
+        REQUIRE(connection->receive(0).isValid() == true);
+        REQUIRE(connection->receive(0).isValid() == true);
     }
-    uint16_t receive() {
-        return shadow().receive();
+    SECTION("drop") {
+        options.queuedRx = PjonHL::PauseOptions::QueuedRx::Drop;
+        bus.pause(options);
+        REQUIRE(connection->receive(0).isValid() == false);
+        REQUIRE(connection->getMetrics().rxQueueDepth.current == 0);
+        REQUIRE(bus.getMetrics().rxQueueDepth.current == 0);
     }
+    bus.resume();
+}
 
-    uint16_t send(
-      const PJON_Packet_Info &info,
-      const void *payload,
-      uint16_t length
-    )
-    {
-        return shadow().send(info, payload, length);
-    };
+#if defined(__linux__)
+TEST_CASE( "Bus event loop thread config", "" ) {
+    shadow().reset();
+    PjonHL::BusConfig config;
+    config.eventLoopThread.name = "PjonHLTestLoop";
+    PjonHL::Bus<Strategy> bus(PjonHL::Address{}, Strategy{}, config);
 
-    void set_acknowledge(bool)
+    // find event-loop thread by its name:
+    bool found = false;
+    for(int i = 0; i < 100 and not found; i++)
     {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        for(const auto & task : std::filesystem::directory_iterator("/proc/self/task"))
+        {
+            std::ifstream comm(task.path() / "comm");
+            std::string name;
+            std::getline(comm, name);
+            found = found or name == "PjonHLTestLoop";
+        }
     }
-    void set_crc_32(bool)
+    REQUIRE(found);
+}
+#endif
+
+TEST_CASE( "Send Fail", "" ) {
+    shadow().reset();
+    PjonHL::Bus<Strategy> bus(PjonHL::Address{}, Strategy{});
+    auto connection = bus.createConnection(PjonHL::Address{});
+    shadow().setNextSendResult(false);
+    auto future = connection->send(std::vector<uint8_t>{0x00}, 1000, false);
+    REQUIRE(future.valid() == true);
+    REQUIRE(future.get().isGood() == false);
+    REQUIRE(1 == shadow().sendCount);
+}
+
+TEST_CASE( "Send latency statistics", "" ) {
+    shadow().reset();
+    PjonHL::Bus<Strategy> bus(PjonHL::Address{}, Strategy{});
+    auto connection1 = bus.createConnection(PjonHL::Address{42});
+    auto connection2 = bus.createConnection(PjonHL::Address{43});
+    shadow().setSendResultSequence({true, true});
+    REQUIRE(connection1->send(std::vector<uint8_t>{0x00}).get().isGood() == true);
+    REQUIRE(connection1->send(std::vector<uint8_t>{0x00}).get().isGood() == true);
+
+    auto connectionStatistics = connection1->getLatencyStatistics();
+    REQUIRE(connectionStatistics[PjonHL::LatencyStatistics::TxQueueWait].count == 2);
+    REQUIRE(connectionStatistics[PjonHL::LatencyStatistics::TxWire].count == 2);
+    REQUIRE(connectionStatistics[PjonHL::LatencyStatistics::TxTotal].count == 2);
+    REQUIRE(connectionStatistics[PjonHL::LatencyStatistics::RxTotal].count == 0);
+    REQUIRE(connection2->getLatencyStatistics()[PjonHL::LatencyStatistics::TxTotal].count == 0);
+    REQUIRE(bus.getLatencyStatistics()[PjonHL::LatencyStatistics::TxTotal].count == 2);
+}
+
+TEST_CASE( "Send metrics", "" ) {
+    shadow().reset();
+    PjonHL::Bus<Strategy> bus(PjonHL::Address{}, Strategy{});
+    auto connection = bus.createConnection(PjonHL::Address{42});
+    shadow().setSendResultSequence({true, false});
+    REQUIRE(connection->send(std::vector<uint8_t>{0x00, 0x01}).get().isGood() == true);
+    REQUIRE(connection->send(std::vector<uint8_t>{0x00}, 1000, false).get().isGood() == false);
+
+    // a snapshot may catch an iteration before its receive() calls were
+    // counted, so only check the ratio after enough iterations:
+    while(bus.getMetrics().eventLoopIterations < 20)
     {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
     }
-    void set_communication_mode(bool)
-    {
+    auto metrics = bus.getMetrics();
+    REQUIRE(metrics.packetsSent == 1);
+    REQUIRE(metrics.bytesSent == 2);
+    REQUIRE(metrics.sendFailures == 1);
+    REQUIRE(metrics.errors[0] == 1);
+    REQUIRE(metrics.txQueueDepth.current == 0);
+    REQUIRE(metrics.txQueueDepth.peak == 1);
+    REQUIRE(metrics.eventLoopIterations > 0);
+    REQUIRE(metrics.receiveCallsPerIteration() > 90.0);
+    REQUIRE(metrics.receiveCallsPerIteration() <= 100.0);
+
+    auto connectionMetrics = connection->getMetrics();
+    REQUIRE(connectionMetrics.packetsSent == 1);
+    REQUIRE(connectionMetrics.bytesSent == 2);
+    REQUIRE(connectionMetrics.sendFailures == 1);
+    REQUIRE(connectionMetrics.txQueueDepth.current == 0);
+}
+
+TEST_CASE( "Send TX queue limit rejects", "" ) {
+    shadow().reset();
+    PjonHL::BusConfig config;
+    config.txQueue.maxPacketsPerConnection = 2;
+    PjonHL::Bus<Strategy> bus(PjonHL::Address{}, Strategy{}, config);
+    auto connection = bus.createConnection(PjonHL::Address{42});
+    auto otherConnection = bus.createConnection(PjonHL::Address{43});
+    shadow().setDefaultSendResult(true);
+    shadow().setHoldInFlight(true);
+
+    auto first = connection->send(std::vector<uint8_t>{0x01});
+    auto second = connection->send(std::vector<uint8_t>{0x02});
+    auto rejected = connection->send(std::vector<uint8_t>{0x03}).get();
+    REQUIRE(rejected.isGood() == false);
+    REQUIRE(rejected.isTxQueueFull() == true);
+
+    bool handlerCalled = false;
+    std::array<uint8_t, 1> payload{0x04};
+    connection->send(payload, [&](PjonHL::Result f_result)
+        {
+            handlerCalled = true;
+            REQUIRE(f_result.isTxQueueFull() == true);
+        });
+    REQUIRE(handlerCalled == true);
+
+    // limit is per connection:
+    auto other = otherConnection->send(std::vector<uint8_t>{0x05});
+
+    shadow().setHoldInFlight(false);
+    shadow().releaseInFlight();
+    auto firstResult = first.get();
+    REQUIRE(firstResult.isGood() == true);
+    REQUIRE(firstResult.isTxQueueFull() == false);
+    REQUIRE(second.get().isGood() == true);
+    REQUIRE(other.get().isGood() == true);
+    REQUIRE(3 == shadow().sendCount);
+
+    REQUIRE(bus.getMetrics().txQueueRejects == 2);
+    REQUIRE(bus.getMetrics().txQueueDepth.peak == 3);
+    REQUIRE(connection->getMetrics().txQueueRejects == 2);
+    REQUIRE(connection->getMetrics().txQueueDepth.peak == 2);
+    REQUIRE(otherConnection->getMetrics().txQueueRejects == 0);
+
+    // space is given back on completion:
+    REQUIRE(connection->send(std::vector<uint8_t>{0x06}).get().isGood() == true);
+}
+
+TEST_CASE( "Send TX queue limit blocks", "" ) {
+    shadow().reset();
+    PjonHL::BusConfig config;
+    config.txQueue.maxPackets = 1;
+    config.txQueue.overflowPolicy = PjonHL::BusConfig::TxQueueConfig::OverflowPolicy::Block;
+    config.txQueue.blockTimeoutMilliseconds = 20;
+    PjonHL::Bus<Strategy> bus(PjonHL::Address{}, Strategy{}, config);
+    auto connection = bus.createConnection(PjonHL::Address{42});
+    shadow().setDefaultSendResult(true);
+    shadow().setHoldInFlight(true);
+
+    auto first = connection->send(std::vector<uint8_t>{0x01});
+
+    SECTION("timeout") {
+        auto start = std::chrono::steady_clock::now();
+        // limit is per bus, so also packets sent without connection wait:
+        auto result = bus.send(PjonHL::Address{}, PjonHL::Address{43}, {0x02}, 1000).get();
+        REQUIRE(std::chrono::steady_clock::now() - start >= std::chrono::milliseconds(20));
+        REQUIRE(result.isTxQueueFull() == true);
+        REQUIRE(bus.getMetrics().txQueueRejects == 1);
+    }
+    SECTION("space becomes available") {
+        auto second = std::async(std::launch::async, [&]{ return connection->send(std::vector<uint8_t>{0x02}).get(); });
+        while(bus.getMetrics().txQueueWaits == 0)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        shadow().setHoldInFlight(false);
+        shadow().releaseInFlight();
+        REQUIRE(second.get().isGood() == true);
+        REQUIRE(bus.getMetrics().txQueueRejects == 0);
     }
-    void set_shared_network(bool)
+    shadow().setHoldInFlight(false);
+    shadow().releaseInFlight();
+    REQUIRE(first.get().isGood() == true);
+    REQUIRE(bus.getMetrics().txQueueWaits == 1);
+    REQUIRE(bus.getMetrics().txQueueDepth.peak == 1);
+}
+
+TEST_CASE( "Send TX credit callback", "" ) {
+    shadow().reset();
+    PjonHL::BusConfig config;
+    config.txQueue.maxPacketsPerConnection = 1;
+    PjonHL::Bus<Strategy> bus(PjonHL::Address{}, Strategy{}, config);
+    auto connection = bus.createConnection(PjonHL::Address{42});
+    shadow().setDefaultSendResult(true);
+
+    // space available, called immediately:
+    bool called = false;
+    connection->onTxCredit([&]{ called = true; });
+    REQUIRE(called == true);
+
+    shadow().setHoldInFlight(true);
+    auto first = connection->send(std::vector<uint8_t>{0x01});
+    std::promise<PjonHL::Result> nextResult;
+    connection->onTxCredit([&]
+        {
+            // sending from the callback does not wait:
+            connection->send(std::vector<uint8_t>{0x02}, [&](PjonHL::Result f_result){ nextResult.set_value(std::move(f_result)); });
+        });
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    REQUIRE(1 == shadow().sendCount);
+
+    shadow().setHoldInFlight(false);
+    shadow().releaseInFlight();
+    REQUIRE(first.get().isGood() == true);
+    REQUIRE(nextResult.get_future().get().isGood() == true);
+    REQUIRE(2 == shadow().sendCount);
+    REQUIRE(bus.getMetrics().txQueueRejects == 0);
+}
+
+TEST_CASE( "Send cancelled before dispatch", "" ) {
+    shadow().reset();
+    PjonHL::Bus<Strategy> bus(PjonHL::Address{}, Strategy{});
+    auto connection = bus.createConnection(PjonHL::Address{42});
+    shadow().setDefaultSendResult(true);
+    shadow().setHoldInFlight(true);
+
+    auto token = PjonHL::CancelToken::create();
+    auto first = connection->send(std::vector<uint8_t>{0x01}, 1000, true, token);
+    while(shadow().sendCount == 0)
     {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
     }
+    auto second = connection->send(std::vector<uint8_t>{0x02}, 1000, true, token);
+    std::promise<PjonHL::Result> thirdResult;
+    std::array<uint8_t, 1> payload{0x03};
+    connection->send(payload, [&](PjonHL::Result f_result){ thirdResult.set_value(std::move(f_result)); }, 1000, true, token);
+    auto fourth = connection->send(std::vector<uint8_t>{0x04});
+
+    // already dispatched packets are not withdrawn:
+    token.cancel();
+    shadow().setHoldInFlight(false);
+    shadow().releaseInFlight();
+
+    auto firstResult = first.get();
+    REQUIRE(firstResult.isGood() == true);
+    REQUIRE(firstResult.isCancelled() == false);
+    auto secondResult = second.get();
+    REQUIRE(secondResult.isGood() == false);
+    REQUIRE(secondResult.isCancelled() == true);
+    REQUIRE(thirdResult.get_future().get().isCancelled() == true);
+    REQUIRE(fourth.get().isGood() == true);
+
+    REQUIRE(2 == shadow().sendCount);
+    REQUIRE(shadow().lastSendPayloadCopy == std::vector<uint8_t>{0x04});
+    REQUIRE(bus.getMetrics().sendsCancelled == 2);
+    REQUIRE(bus.getMetrics().sendFailures == 0);
+    REQUIRE(bus.getMetrics().txQueueDepth.current == 0);
+    REQUIRE(connection->getMetrics().sendsCancelled == 2);
+}
 
-    PJON_Error _error;
-    PJON_Receiver _receiver;
-    Strategy strategy;
-    PJON_Packet packets[PJON_MAX_PACKETS];
-};
+TEST_CASE( "Send cancelled while waiting for retransmission", "" ) {
+    shadow().reset();
+    PjonHL::BusConfig config;
+    config.retransmit.initialRtoMilliseconds = 200;
+    config.retransmit.maxRtoMilliseconds = 200;
+    PjonHL::Bus<Strategy> bus(PjonHL::Address{}, Strategy{}, config);
+    auto connection = bus.createConnection(PjonHL::Address{42});
+    shadow().setDefaultSendResult(false);
 
-TEST_CASE( "destruct bus before connection", "" ) {
+    auto token = PjonHL::CancelToken::create();
+    auto result = connection->send(std::vector<uint8_t>{0x01}, 5000, true, token);
+    while(bus.getMetrics().retransmissions == 0)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    token.cancel();
+    REQUIRE(result.get().isCancelled() == true);
+    REQUIRE(1 == shadow().sendCount);
+}
+
+TEST_CASE( "Send cancelled behind packet in flight completes immediately", "" ) {
     shadow().reset();
-    std::unique_ptr<PjonHL::Bus<Strategy>::ConnectionHandle> connection;
+    PjonHL::BusConfig config;
+    config.txQueue.maxPacketsPerConnection = 2;
+    PjonHL::Bus<Strategy> bus(PjonHL::Address{}, Strategy{}, config);
+    auto connection = bus.createConnection(PjonHL::Address{42});
+    shadow().setDefaultSendResult(true);
+    shadow().setHoldInFlight(true);
+
+    auto first = connection->send(std::vector<uint8_t>{0x01});
+    while(shadow().sendCount == 0)
     {
-        PjonHL::Bus<Strategy> bus(PjonHL::Address{}, Strategy{});
-        connection = std::make_unique<PjonHL::Bus<Strategy>::ConnectionHandle>(bus.createConnection(PjonHL::Address{}));
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
     }
-    // now use connection:
-    auto future = (*connection)->send(std::vector<uint8_t>{0x00});
+    auto token = PjonHL::CancelToken::create();
+    auto second = connection->send(std::vector<uint8_t>{0x02}, 1000, true, token);
+    REQUIRE(bus.getMetrics().txQueueDepth.current == 2);
+
+    // completed and credit given back while first packet is still held:
+    token.cancel();
+    REQUIRE(second.wait_for(std::chrono::seconds(0)) == std::future_status::ready);
+    REQUIRE(second.get().isCancelled() == true);
+    REQUIRE(bus.getMetrics().txQueueDepth.current == 1);
+    REQUIRE(connection->getMetrics().txQueueDepth.current == 1);
+
+    // already cancelled token completes the packet within send():
+    std::promise<PjonHL::Result> thirdResult;
+    std::array<uint8_t, 1> payload{0x03};
+    connection->send(payload, [&](PjonHL::Result f_result){ thirdResult.set_value(std::move(f_result)); }, 1000, true, token);
+    auto third = thirdResult.get_future();
+    REQUIRE(third.wait_for(std::chrono::seconds(0)) == std::future_status::ready);
+    REQUIRE(third.get().isCancelled() == true);
+    REQUIRE(bus.getMetrics().txQueueDepth.current == 1);
+
+    // place is usable again:
+    auto fourth = connection->send(std::vector<uint8_t>{0x04});
+    REQUIRE(bus.getMetrics().txQueueRejects == 0);
+
+    shadow().setHoldInFlight(false);
+    shadow().releaseInFlight();
+    REQUIRE(first.get().isGood() == true);
+    REQUIRE(fourth.get().isGood() == true);
+    REQUIRE(2 == shadow().sendCount);
+    REQUIRE(shadow().lastSendPayloadCopy == std::vector<uint8_t>{0x04});
+    REQUIRE(bus.getMetrics().sendsCancelled == 2);
+    REQUIRE(bus.getMetrics().txQueueDepth.current == 0);
+}
 
-    REQUIRE(future.valid() == true);
-    REQUIRE(future.get().isGood() == false);
-    REQUIRE(shadow().sendCount == 0);
+TEST_CASE( "Send latest value conflates queued packets", "" ) {
+    shadow().reset();
+    PjonHL::Bus<Strategy> bus(PjonHL::Address{}, Strategy{});
+    auto connection = bus.createConnection(PjonHL::Address{42});
+    shadow().setDefaultSendResult(true);
+    shadow().setHoldInFlight(true);
+
+    auto inFlight = connection->sendLatest(std::vector<uint8_t>{0x01});
+    while(shadow().sendCount == 0)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    auto other = connection->send(std::vector<uint8_t>{0x10});
+    auto superseded = connection->sendLatest(std::vector<uint8_t>{0x02});
+    auto otherStream = connection->sendLatest(std::vector<uint8_t>{0x20}, 1000, true, 1);
+    auto latest = connection->sendLatest(std::vector<uint8_t>{0x03});
+
+    auto supersededResult = superseded.get();
+    REQUIRE(supersededResult.isGood() == false);
+    REQUIRE(supersededResult.isSuperseded() == true);
+    REQUIRE(bus.getMetrics().txQueueDepth.current == 4);
+
+    shadow().setHoldInFlight(false);
+    shadow().releaseInFlight();
+    REQUIRE(inFlight.get().isGood() == true);
+    REQUIRE(other.get().isGood() == true);
+    REQUIRE(latest.get().isGood() == true);
+    REQUIRE(otherStream.get().isGood() == true);
+
+    // latest took the queue position of the superseded packet (before
+    // otherStream), the packet in flight was not replaced:
+    REQUIRE(4 == shadow().sendCount);
+    REQUIRE(shadow().lastSendPayloadCopy == std::vector<uint8_t>{0x20});
+    REQUIRE(bus.getMetrics().sendsSuperseded == 1);
+    REQUIRE(connection->getMetrics().sendsSuperseded == 1);
+    REQUIRE(bus.getMetrics().txQueueDepth.current == 0);
+    REQUIRE(connection->getMetrics().txQueueDepth.current == 0);
+
+    // nothing queued, so nothing to replace:
+    REQUIRE(connection->sendLatest(std::vector<uint8_t>{0x04}).get().isGood() == true);
+    REQUIRE(bus.getMetrics().sendsSuperseded == 1);
 }
 
-TEST_CASE( "Send Succeed", "" ) {
+TEST_CASE( "Send Retransmit Succeed", "" ) {
     shadow().reset();
     PjonHL::Bus<Strategy> bus(PjonHL::Address{}, Strategy{});
     auto connection = bus.createConnection(PjonHL::Address{});
-    shadow().setNextSendResult(true);
-    auto future = connection->send(std::vector<uint8_t>{0x00});
+    shadow().setSendResultSequence({false, false, true});
+    auto future = connection->send(std::vector<uint8_t>{0x00}, 2000);
     REQUIRE(future.valid() == true);
     REQUIRE(future.get().isGood() == true);
-    REQUIRE(1 == shadow().sendCount);
+    REQUIRE(3 == shadow().sendCount);
 }
 
-TEST_CASE( "Send With Bus Pause", "" ) {
+TEST_CASE( "Send result timestamps", "" ) {
     shadow().reset();
     PjonHL::Bus<Strategy> bus(PjonHL::Address{}, Strategy{});
     auto connection = bus.createConnection(PjonHL::Address{});
-    shadow().setNextSendResult(true);
 
-    bus.pause();
+    auto before = std::chrono::steady_clock::now();
+    shadow().setSendResultSequence({false, true});
+    auto result = connection->send(std::vector<uint8_t>{0x00}, 2000).get();
+    auto after = std::chrono::steady_clock::now();
+    REQUIRE(result.isGood() == true);
+    REQUIRE(before <= result.getEnqueueTime());
+    REQUIRE(result.getEnqueueTime() <= result.getDispatchTime());
+    // retransmitted:
+    REQUIRE(result.getDispatchTime() < result.getLastDispatchTime());
+    REQUIRE(result.getLastDispatchTime() <= result.getCompletionTime());
+    REQUIRE(result.getCompletionTime() <= after);
+}
 
-    auto future = connection->send(std::vector<uint8_t>{0x00});
-    REQUIRE(future.valid() == true);
-    std::this_thread::sleep_for(std::chrono::milliseconds(50));
-    // bus is paused, shadow should not have seen any traffic:
-    REQUIRE(0 == shadow().sendCount);
+TEST_CASE( "Result from string literal is an error", "" ) {
+    PjonHL::Result result("error message");
+    REQUIRE(result.isBad() == true);
+    REQUIRE(result.getErrorMessage() == "error message");
+    REQUIRE(PjonHL::Result(true).isGood() == true);
+}
 
-    bus.resume();
+TEST_CASE( "Send Retransmit attempts exhausted", "" ) {
+    shadow().reset();
+    PjonHL::BusConfig config;
+    config.retransmit.maxAttempts = 3;
+    config.retransmit.initialRtoMilliseconds = 5;
+    PjonHL::Bus<Strategy> bus(PjonHL::Address{}, Strategy{}, config);
+    auto connection = bus.createConnection(PjonHL::Address{42});
+    auto future = connection->send(std::vector<uint8_t>{0x00}, 2000);
+    REQUIRE(future.get().isGood() == false);
+    REQUIRE(3 == shadow().sendCount);
 
-    // now bus is resumed. send should succeed now.
-    REQUIRE(future.get().isGood() == true);
+    // remote failed recently, so next packet gets fewer attempts:
+    shadow().sendCount = 0;
+    future = connection->send(std::vector<uint8_t>{0x00}, 2000);
+    REQUIRE(future.get().isGood() == false);
     REQUIRE(1 == shadow().sendCount);
 }
 
-TEST_CASE( "Send Fail", "" ) {
+TEST_CASE( "Send Retransmit timeout", "" ) {
     shadow().reset();
-    PjonHL::Bus<Strategy> bus(PjonHL::Address{}, Strategy{});
-    auto connection = bus.createConnection(PjonHL::Address{});
-    shadow().setNextSendResult(false);
-    auto future = connection->send(std::vector<uint8_t>{0x00});
-    REQUIRE(future.valid() == true);
+    PjonHL::BusConfig config;
+    config.retransmit.maxAttempts = 10;
+    config.retransmit.initialRtoMilliseconds = 100;
+    config.retransmit.minRtoMilliseconds = 100;
+    PjonHL::Bus<Strategy> bus(PjonHL::Address{}, Strategy{}, config);
+    auto connection = bus.createConnection(PjonHL::Address{42});
+    // backoff is at least 50ms, 100ms and 200ms for the first 3 retries, so
+    // we cannot get more than 3 attempts within 200ms:
+    auto future = connection->send(std::vector<uint8_t>{0x00}, 200);
     REQUIRE(future.get().isGood() == false);
-    REQUIRE(1 == shadow().sendCount);
+    REQUIRE(shadow().sendCount <= 3);
 }
 
 TEST_CASE( "Rx good case With Bus Pause", "" ) {
@@ -317,9 +776,11 @@ TEST_CASE( "Rx good case", "" ) {
     PJON_Packet_Info info;
     info.rx.id = 36;
     info.tx.id = 42;
+    auto enqueueTime = std::chrono::steady_clock::now();
     shadow().enqueuePacketForRx(payload.data(), payload.size(), info);
 
     auto expectedData = receiveFuture.get();
+    auto receiveTime = std::chrono::steady_clock::now();
 
     REQUIRE(expectedData.isValid() == true);
     auto data = expectedData.unwrap();
@@ -327,6 +788,323 @@ TEST_CASE( "Rx good case", "" ) {
     REQUIRE(data.payload[0] == 0xab);
     REQUIRE(data.payload[1] == 0xcd);
     REQUIRE(data.payload[2] == 0xef);
+
+    REQUIRE(enqueueTime <= data.rxTime);
+    REQUIRE(data.rxTime <= receiveTime);
+    // mock strategy does not report frame start:
+    REQUIRE(data.frameStartTime == data.rxTime);
+}
+
+TEST_CASE( "Rx into caller buffer", "" ) {
+    shadow().reset();
+    PjonHL::Bus<Strategy> bus(PjonHL::Address{36}, Strategy{});
+    auto connection = bus.createConnection(PjonHL::Address{42});
+
+    PJON_Packet_Info info;
+    info.rx.id = 36;
+    info.tx.id = 42;
+    std::vector<uint8_t> payload{0xab, 0xcd, 0xef};
+    uint8_t buffer[4] = {};
+
+    REQUIRE(connection->receiveInto(buffer, 0).isValid() == false);
+
+    for(int i = 0; i < 3; i++)
+    {
+        shadow().enqueuePacketForRx(payload.data(), payload.size(), info);
+        auto received = connection->receiveInto(buffer, 100);
+        REQUIRE(received.isValid() == true);
+        auto & packetInfo = received.unwrap();
+        REQUIRE(packetInfo.size == 3);
+        REQUIRE(packetInfo.payloadSize == 3);
+        REQUIRE(packetInfo.isTruncated() == false);
+        REQUIRE(packetInfo.remoteAddress.id == 42);
+        REQUIRE(packetInfo.targetAddress.id == 36);
+        REQUIRE(packetInfo.rxTime != std::chrono::steady_clock::time_point());
+        REQUIRE(std::vector<uint8_t>(buffer, buffer + 3) == payload);
+        payload[0]++;
+    }
+
+    // later packets are stored in storage handed back by receiveInto():
+    shadow().enqueuePacketForRx(payload.data(), payload.size(), info);
+    auto received = connection->receive(100);
+    REQUIRE(received.isValid() == true);
+    REQUIRE(received.unwrap().payload == payload);
+
+    SECTION("truncated") {
+        std::vector<uint8_t> small(2);
+        shadow().enqueuePacketForRx(payload.data(), payload.size(), info);
+        auto truncated = connection->receiveInto(small, 100);
+        REQUIRE(truncated.isValid() == true);
+        REQUIRE(truncated.unwrap().size == 2);
+        REQUIRE(truncated.unwrap().payloadSize == 3);
+        REQUIRE(truncated.unwrap().isTruncated() == true);
+        REQUIRE(small == std::vector<uint8_t>{payload[0], payload[1]});
+    }
+}
+
+TEST_CASE( "Typed message send and receive", "" ) {
+    using Identification = PjonHL::MessageSchema<0x20, PjonHL::Endian::Little, uint8_t, PjonHL::Bytes<4>>;
+    shadow().reset();
+    PjonHL::Bus<Strategy> bus(PjonHL::Address{36}, Strategy{});
+    auto connection = bus.createConnection(PjonHL::Address{42});
+    shadow().setDefaultSendResult(true);
+
+    REQUIRE(connection->send<Identification>(7, std::array<uint8_t, 4>{1, 2, 3, 4}).get().isGood() == true);
+    REQUIRE(shadow().lastSendPayloadCopy == std::vector<uint8_t>{0x20, 7, 1, 2, 3, 4});
+
+    PJON_Packet_Info info;
+    info.rx.id = 36;
+    info.tx.id = 42;
+    auto payload = Identification::encode(9, std::array<uint8_t, 4>{5, 6, 7, 8});
+    shadow().enqueuePacketForRx(payload.data(), payload.size(), info);
+    auto message = connection->receive<Identification>(100);
+    REQUIRE(message.isValid() == true);
+    REQUIRE(message.unwrap().packet.remoteAddress.id == 42);
+    REQUIRE(message.unwrap().view().get<0>() == 9);
+    REQUIRE(message.unwrap().view().get<1>().toVector() == std::vector<uint8_t>{5, 6, 7, 8});
+
+    // not an Identification, dropped:
+    std::vector<uint8_t> other{0x21, 9};
+    shadow().enqueuePacketForRx(other.data(), other.size(), info);
+    REQUIRE(connection->receive<Identification>(100).isValid() == false);
+    REQUIRE(connection->receive(0).isValid() == false);
+}
+
+TEST_CASE( "Rx latency statistics", "" ) {
+    shadow().reset();
+    PjonHL::Bus<Strategy> bus(PjonHL::Address{36}, Strategy{});
+    auto connection = bus.createConnection(PjonHL::Address{42});
+
+    std::vector<uint8_t> payload{0xab, 0xcd, 0xef};
+    PJON_Packet_Info info;
+    info.rx.id = 36;
+    info.tx.id = 42;
+    shadow().enqueuePacketForRx(payload.data(), payload.size(), info);
+
+    REQUIRE(connection->receive(100).isValid() == true);
+
+    auto statistics = connection->getLatencyStatistics();
+    REQUIRE(statistics[PjonHL::LatencyStatistics::RxDispatch].count == 1);
+    REQUIRE(statistics[PjonHL::LatencyStatistics::RxQueueWait].count == 1);
+    REQUIRE(statistics[PjonHL::LatencyStatistics::RxTotal].count == 1);
+    REQUIRE(statistics[PjonHL::LatencyStatistics::TxTotal].count == 0);
+    REQUIRE(bus.getLatencyStatistics()[PjonHL::LatencyStatistics::RxTotal].count == 1);
+}
+
+TEST_CASE( "Rx metrics", "" ) {
+    shadow().reset();
+    PjonHL::Bus<Strategy> bus(PjonHL::Address{36}, Strategy{});
+    auto connection = bus.createConnection(PjonHL::Address{42});
+
+    std::vector<uint8_t> payload{0xab, 0xcd, 0xef};
+    PJON_Packet_Info info;
+    info.rx.id = 36;
+    info.tx.id = 42;
+    shadow().enqueuePacketForRx(payload.data(), payload.size(), info);
+    shadow().enqueuePacketForRx(payload.data(), payload.size(), info);
+    PJON_Packet_Info otherInfo;
+    otherInfo.rx.id = 36;
+    otherInfo.tx.id = 43;
+    shadow().enqueuePacketForRx(payload.data(), payload.size(), otherInfo);
+    while(shadow().getRxQueueSize() > 0)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    auto metrics = bus.getMetrics();
+    REQUIRE(metrics.packetsReceived == 3);
+    REQUIRE(metrics.bytesReceived == 9);
+    REQUIRE(metrics.packetsUnmatched == 1);
+    REQUIRE(metrics.rxQueueDepth.current == 2);
+    REQUIRE(connection->getMetrics().rxQueueDepth.current == 2);
+
+    REQUIRE(connection->receive(100).isValid() == true);
+    REQUIRE(bus.getMetrics().rxQueueDepth.current == 1);
+    REQUIRE(connection->getMetrics().rxQueueDepth.current == 1);
+    REQUIRE(connection->getMetrics().rxQueueDepth.peak == 2);
+    REQUIRE(connection->getMetrics().packetsReceived == 2);
+
+    // destroying the connection drops its queue:
+    connection.reset();
+    REQUIRE(bus.getMetrics().rxQueueDepth.current == 0);
+}
+
+TEST_CASE( "Send latest value moves credit between connections", "" ) {
+    shadow().reset();
+    PjonHL::BusConfig config;
+    config.txQueue.maxPacketsPerConnection = 1;
+    PjonHL::Bus<Strategy> bus(PjonHL::Address{}, Strategy{}, config);
+    auto first = bus.createConnection(PjonHL::Address{42});
+    auto second = bus.createConnection(PjonHL::Address{42});
+    auto other = bus.createConnection(PjonHL::Address{43});
+    shadow().setDefaultSendResult(true);
+    shadow().setHoldInFlight(true);
+
+    auto inFlight = other->send(std::vector<uint8_t>{0x01});
+    while(shadow().sendCount == 0)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    auto superseded = first->sendLatest(std::vector<uint8_t>{0x02});
+    bool creditCalled = false;
+    first->onTxCredit([&]{ creditCalled = true; });
+    REQUIRE(creditCalled == false);
+
+    // replacing the packet of the first connection gives back its credit:
+    auto latest = second->sendLatest(std::vector<uint8_t>{0x03});
+    REQUIRE(superseded.get().isSuperseded() == true);
+    REQUIRE(creditCalled == true);
+    REQUIRE(first->getMetrics().txQueueDepth.current == 0);
+    REQUIRE(second->getMetrics().txQueueDepth.current == 1);
+
+    // a full connection can not take over the place:
+    auto queued = first->send(std::vector<uint8_t>{0x04});
+    auto rejected = first->sendLatest(std::vector<uint8_t>{0x05});
+    REQUIRE(rejected.get().isTxQueueFull() == true);
+    REQUIRE(first->getMetrics().txQueueDepth.current == 1);
+    REQUIRE(second->getMetrics().txQueueDepth.current == 1);
+
+    shadow().setHoldInFlight(false);
+    shadow().releaseInFlight();
+    REQUIRE(inFlight.get().isGood() == true);
+    REQUIRE(latest.get().isGood() == true);
+    REQUIRE(queued.get().isGood() == true);
+    REQUIRE(3 == shadow().sendCount);
+    REQUIRE(bus.getMetrics().txQueueDepth.current == 0);
+}
+
+TEST_CASE( "Rx conflation keeps newest packet per source", "" ) {
+    shadow().reset();
+    PjonHL::Bus<Strategy> bus(PjonHL::Address{36}, Strategy{});
+    PjonHL::Address anyRemote;
+    anyRemote.id = 0;
+    auto connection = bus.createConnection(PjonHL::Address{42}, anyRemote);
+
+    auto enqueue = [](uint8_t f_sender, uint8_t * f_payload)
+        {
+            PJON_Packet_Info info;
+            info.rx.id = 36;
+            info.tx.id = f_sender;
+            shadow().enqueuePacketForRx(f_payload, 1, info);
+            while(shadow().getRxQueueSize() > 0)
+            {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+        };
+    uint8_t payloads[] = {0x01, 0x02, 0x03, 0x04, 0x05};
+
+    SECTION("by source") {
+        connection->setRxConflation(true);
+        enqueue(42, &payloads[0]);
+        enqueue(43, &payloads[1]);
+        enqueue(42, &payloads[2]);
+        REQUIRE(connection->getMetrics().rxQueueDepth.current == 2);
+        REQUIRE(connection->getMetrics().rxPacketsConflated == 1);
+        REQUIRE(bus.getMetrics().rxPacketsConflated == 1);
+
+        // newest packet of 42 in the queue position of the overwritten one:
+        auto first = connection->receive(100);
+        REQUIRE(first.unwrap().remoteAddress.id == 42);
+        REQUIRE(first.unwrap().payload == std::vector<uint8_t>{0x03});
+
+        // received packets are no longer overwritten:
+        enqueue(42, &payloads[3]);
+        REQUIRE(connection->receive(100).unwrap().payload == std::vector<uint8_t>{0x02});
+        REQUIRE(connection->receive(100).unwrap().payload == std::vector<uint8_t>{0x04});
+        REQUIRE(connection->getMetrics().rxPacketsConflated == 1);
+
+        // disabled again:
+        connection->setRxConflation(false);
+        enqueue(42, &payloads[0]);
+        enqueue(42, &payloads[1]);
+        REQUIRE(connection->getMetrics().rxQueueDepth.current == 2);
+    }
+    SECTION("by custom key") {
+        connection->setRxConflation(true, [](const PjonHL::ReceivedPacket & f_packet){ return f_packet.payload.at(0) % 2; });
+        enqueue(42, &payloads[0]);
+        enqueue(43, &payloads[1]);
+        enqueue(44, &payloads[2]);
+        enqueue(45, &payloads[4]);
+        REQUIRE(connection->getMetrics().rxQueueDepth.current == 2);
+        REQUIRE(connection->getMetrics().rxPacketsConflated == 2);
+
+        auto first = connection->receive(100);
+        REQUIRE(first.unwrap().remoteAddress.id == 45);
+        REQUIRE(first.unwrap().payload == std::vector<uint8_t>{0x05});
+        REQUIRE(connection->receive(100).unwrap().payload == std::vector<uint8_t>{0x02});
+    }
+}
+
+TEST_CASE( "Rx port handler", "" ) {
+    shadow().reset();
+    PjonHL::Bus<Strategy> bus(PjonHL::Address{36}, Strategy{});
+    auto connection = bus.createConnection(PjonHL::Address{42});
+
+    std::promise<std::vector<uint8_t>> handledPayload;
+    PjonHL::Address handledRemote;
+    bus.setPortHandler(0, [&](PjonHL::ConstBuffer f_payload, const PjonHL::ReceivedPacketInfo & f_info)
+        {
+            handledRemote = f_info.remoteAddress;
+            REQUIRE(f_info.size == f_payload.size());
+            handledPayload.set_value(f_payload.toVector());
+        });
+
+    std::vector<uint8_t> payload{0xab, 0xcd};
+    PJON_Packet_Info info;
+    info.rx.id = 36;
+    info.tx.id = 42;
+    shadow().enqueuePacketForRx(payload.data(), payload.size(), info);
+    REQUIRE(handledPayload.get_future().get() == payload);
+    REQUIRE(handledRemote.id == 42);
+
+    // not passed to the connection:
+    REQUIRE(connection->receive(20).isValid() == false);
+    REQUIRE(bus.getMetrics().packetsPortDispatched == 1);
+
+    // without handler, connections are matched:
+    bus.setPortHandler(0, PjonHL::PortDispatcher::Handler());
+    shadow().enqueuePacketForRx(payload.data(), payload.size(), info);
+    REQUIRE(connection->receive(100).unwrap().payload == payload);
+    REQUIRE(bus.getMetrics().packetsPortDispatched == 1);
+}
+
+TEST_CASE( "Traffic capture", "" ) {
+    shadow().reset();
+    std::string path = "/tmp/PjonHLTest_bus.cap";
+    PjonHL::Bus<Strategy> bus(PjonHL::Address{36}, Strategy{});
+    auto capture = std::make_shared<PjonHL::TrafficCapture>(path, 16, 64);
+    bus.setTrafficCapture(capture);
+    auto connection = bus.createConnection(PjonHL::Address{42});
+
+    shadow().setNextSendResult(true);
+    REQUIRE(connection->send(std::vector<uint8_t>{0x01, 0x02}).get().isGood() == true);
+
+    std::vector<uint8_t> payload{0xab, 0xcd, 0xef};
+    PJON_Packet_Info info;
+    info.rx.id = 36;
+    info.tx.id = 42;
+    info.id = 7;
+    shadow().enqueuePacketForRx(payload.data(), payload.size(), info);
+    REQUIRE(connection->receive(100).isValid() == true);
+
+    // nullptr stops capturing:
+    bus.setTrafficCapture(nullptr);
+    shadow().setNextSendResult(true);
+    REQUIRE(connection->send(std::vector<uint8_t>{0x03}).get().isGood() == true);
+    REQUIRE(capture->getRecordCount() == 2);
+
+    auto records = PjonHL::TrafficCapture::readFile(path);
+    REQUIRE(records.size() == 2);
+    REQUIRE(records[0].direction == PjonHL::TrafficCapture::Direction::Tx);
+    REQUIRE(records[0].source.id == 36);
+    REQUIRE(records[0].destination.id == 42);
+    REQUIRE(records[0].payload == std::vector<uint8_t>{0x01, 0x02});
+    REQUIRE(records[1].direction == PjonHL::TrafficCapture::Direction::Rx);
+    REQUIRE(records[1].source.id == 42);
+    REQUIRE(records[1].destination.id == 36);
+    REQUIRE(records[1].packetId == 7);
+    REQUIRE(records[1].payload == payload);
+    std::remove(path.c_str());
 }
 
 TEST_CASE( "Rx good case 2 connections", "" ) {
@@ -0,0 +1,112 @@
+// Copyright 2021 Rainer Schoenberger
+// 
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+// 
+//     http://www.apache.org/licenses/LICENSE-2.0
+// 
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "catch2/catch.hpp"
+
+#include "ThreadSetup.hpp"
+#include <pthread.h>
+#include <sched.h>
+#include <thread>
+#include <vector>
+
+namespace
+{
+class CollectingLogger : public PjonHL::Logger
+{
+    public:
+        virtual void log(LogLevel f_level, std::string f_message) override
+        {
+            if(f_level == Error)
+            {
+                errors.push_back(f_message);
+            }
+        }
+        std::vector<std::string> errors;
+};
+
+// runs setUpCurrentThread() in a new thread, so the test thread is unaffected:
+template<typename Check>
+bool setUpThread(const PjonHL::BusConfig::ThreadConfig & f_config, PjonHL::Logger & f_logger, Check f_check)
+{
+    bool result = false;
+    std::thread thread([&]
+        {
+            result = PjonHL::setUpCurrentThread(f_config, f_logger);
+            f_check();
+        });
+    thread.join();
+    return result;
+}
+}
+
+TEST_CASE( "Thread setup default config", "" ) {
+    CollectingLogger logger;
+    PjonHL::BusConfig::ThreadConfig config;
+    config.prefaultStackBytes = 256 * 1024;
+    int policy = -1;
+    REQUIRE(setUpThread(config, logger, [&]
+        {
+            sched_param parameter;
+            pthread_getschedparam(pthread_self(), &policy, &parameter);
+        }));
+    REQUIRE(policy == SCHED_OTHER);
+    REQUIRE(logger.errors.empty());
+}
+
+#if defined(__linux__)
+TEST_CASE( "Thread setup name and affinity", "" ) {
+    CollectingLogger logger;
+    PjonHL::BusConfig::ThreadConfig config;
+    config.name = "PjonHLThreadSetupTest";
+    // CPU 0 may not be available to the process (e.g. in containers):
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    REQUIRE(sched_getaffinity(0, sizeof(allowed), &allowed) == 0);
+    int firstAllowedCpu = 0;
+    while(firstAllowedCpu < CPU_SETSIZE - 1 and not CPU_ISSET(firstAllowedCpu, &allowed))
+    {
+        firstAllowedCpu++;
+    }
+    config.cpuAffinity = {firstAllowedCpu};
+    char name[16] = {};
+    int cpu = -1;
+    REQUIRE(setUpThread(config, logger, [&]
+        {
+            pthread_getname_np(pthread_self(), name, sizeof(name));
+            cpu = sched_getcpu();
+        }));
+    REQUIRE(std::string(name) == "PjonHLThreadSet");
+    REQUIRE(cpu == firstAllowedCpu);
+    REQUIRE(logger.errors.empty());
+}
+
+TEST_CASE( "Thread setup failures are logged", "" ) {
+    CollectingLogger logger;
+    PjonHL::BusConfig::ThreadConfig config;
+    config.cpuAffinity = {-1};
+    // priority 0 is invalid for real-time policies, even with privileges:
+    config.schedulingPolicy = PjonHL::BusConfig::ThreadConfig::SchedulingPolicy::Fifo;
+    config.priority = 0;
+    int policy = -1;
+    REQUIRE(setUpThread(config, logger, [&]
+        {
+            sched_param parameter;
+            pthread_getschedparam(pthread_self(), &policy, &parameter);
+        }) == false);
+    REQUIRE(policy == SCHED_OTHER);
+    REQUIRE(logger.errors.size() == 2);
+    REQUIRE(logger.errors[0].find("Invalid CPU -1") != std::string::npos);
+    REQUIRE(logger.errors[1].find("real-time scheduling") != std::string::npos);
+}
+#endif
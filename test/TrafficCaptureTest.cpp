@@ -0,0 +1,99 @@
+// Copyright 2021 Rainer Schoenberger
+// 
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+// 
+//     http://www.apache.org/licenses/LICENSE-2.0
+// 
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "catch2/catch.hpp"
+
+#include "TrafficCapture.hpp"
+#include <cstdio>
+#include <fstream>
+
+namespace
+{
+std::string capturePath(const char * f_name)
+{
+    return std::string("/tmp/PjonHLTest_") + f_name + ".cap";
+}
+}
+
+TEST_CASE( "Capture roundtrip", "" ) {
+    std::string path = capturePath("roundtrip");
+    {
+        PjonHL::TrafficCapture capture(path, 16, 64);
+        std::vector<uint8_t> payload{1, 2, 3};
+        capture.record(PjonHL::TrafficCapture::Direction::Tx, PjonHL::Address("1.2.3.4/5:6"), PjonHL::Address("7.8.9.10/11:12"), 13, payload.data(), payload.size());
+        capture.record(PjonHL::TrafficCapture::Direction::Rx, PjonHL::Address{42}, PjonHL::Address{36}, 0, payload.data(), 0);
+        REQUIRE(capture.getRecordCount() == 2);
+
+        // readable while capturing:
+        REQUIRE(PjonHL::TrafficCapture::readFile(path).size() == 2);
+    }
+
+    PjonHL::TrafficCapture::FileHeader header;
+    auto records = PjonHL::TrafficCapture::readFile(path, &header);
+    REQUIRE(header.slotCount == 16);
+    REQUIRE(header.slotSize == 64);
+    REQUIRE(header.recordCount == 2);
+    REQUIRE(records.size() == 2);
+
+    REQUIRE(records[0].direction == PjonHL::TrafficCapture::Direction::Tx);
+    REQUIRE(records[0].source.toString() == "1.2.3.4/5:12");
+    REQUIRE(records[0].destination.toString() == "7.8.9.10/11:12");
+    REQUIRE(records[0].packetId == 13);
+    REQUIRE(records[0].payloadLength == 3);
+    REQUIRE(records[0].payload == std::vector<uint8_t>{1, 2, 3});
+    REQUIRE(records[0].unixNanoseconds >= header.startUnixNanoseconds);
+
+    REQUIRE(records[1].direction == PjonHL::TrafficCapture::Direction::Rx);
+    REQUIRE(records[1].source == PjonHL::Address{42});
+    REQUIRE(records[1].payload.empty());
+    REQUIRE(records[1].unixNanoseconds >= records[0].unixNanoseconds);
+    std::remove(path.c_str());
+}
+
+TEST_CASE( "Capture ring wraps and truncates", "" ) {
+    std::string path = capturePath("ring");
+    {
+        PjonHL::TrafficCapture capture(path, 4, 48);
+        for(uint8_t i = 0; i < 10; i++)
+        {
+            std::vector<uint8_t> payload(20, i);
+            capture.record(PjonHL::TrafficCapture::Direction::Tx, PjonHL::Address{1}, PjonHL::Address{2}, i, payload.data(), payload.size());
+        }
+    }
+    auto records = PjonHL::TrafficCapture::readFile(path);
+    // only the newest 4 records are kept, oldest first:
+    REQUIRE(records.size() == 4);
+    for(uint8_t i = 0; i < 4; i++)
+    {
+        REQUIRE(records[i].packetId == 6 + i);
+        REQUIRE(records[i].payloadLength == 20);
+        // 48 - 40 bytes of header:
+        REQUIRE(records[i].payload == std::vector<uint8_t>(8, 6 + i));
+    }
+    std::remove(path.c_str());
+}
+
+TEST_CASE( "Capture invalid files", "" ) {
+    REQUIRE_THROWS_AS(PjonHL::TrafficCapture(capturePath("invalid"), 4, 44), std::runtime_error);
+    REQUIRE_THROWS_AS(PjonHL::TrafficCapture("/nonexistent/dir/capture", 4, 48), std::runtime_error);
+    REQUIRE_THROWS_AS(PjonHL::TrafficCapture::readFile("/nonexistent/dir/capture"), std::runtime_error);
+
+    std::string path = capturePath("garbage");
+    {
+        std::ofstream file(path);
+        file << "this is no capture file, but long enough to contain a header......";
+    }
+    REQUIRE_THROWS_AS(PjonHL::TrafficCapture::readFile(path), std::runtime_error);
+    std::remove(path.c_str());
+}
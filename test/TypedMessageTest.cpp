@@ -0,0 +1,129 @@
+// Copyright 2021 Rainer Schoenberger
+// 
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+// 
+//     http://www.apache.org/licenses/LICENSE-2.0
+// 
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "catch2/catch.hpp"
+
+#include <array>
+#include <string>
+#include <vector>
+#include "TypedMessage.hpp"
+
+using namespace PjonHL;
+
+namespace
+{
+enum class Mode : uint16_t
+{
+    Off = 1,
+    On = 0x0102
+};
+
+using Identification = MessageSchema<0x20, Endian::Little,
+      uint8_t,     // device id
+      Bytes<4>,    // bus id
+      Bytes<8>>;   // device name
+
+using Measurement = MessageSchema<0x21, Endian::Big,
+      uint32_t,
+      int16_t,
+      Mode,
+      double>;
+
+using Ping = MessageSchema<0x22, Endian::Little>;
+}
+
+TEST_CASE( "TypedMessage layout", "" ) {
+    static_assert(Identification::size == 14);
+    static_assert(Identification::offsets[2] == 6);
+    static_assert(Measurement::size == 1 + 4 + 2 + 2 + 8);
+    static_assert(Ping::size == 1);
+    REQUIRE(Ping::encode() == std::vector<uint8_t>{0x22});
+}
+
+TEST_CASE( "TypedMessage byte order", "" ) {
+    auto payload = Measurement::encode(0x01020304, -2, Mode::On, 0.5);
+    REQUIRE(payload.size() == Measurement::size);
+    REQUIRE(std::vector<uint8_t>(payload.begin(), payload.begin() + 9) ==
+            std::vector<uint8_t>{0x21, 0x01, 0x02, 0x03, 0x04, 0xff, 0xfe, 0x01, 0x02});
+
+    auto view = MessageView<Measurement>::validate(payload);
+    REQUIRE(view.isValid() == true);
+    REQUIRE(view.unwrap().get<0>() == 0x01020304);
+    REQUIRE(view.unwrap().get<1>() == -2);
+    REQUIRE(view.unwrap().get<2>() == Mode::On);
+    REQUIRE(view.unwrap().get<3>() == 0.5);
+
+    using LittleMeasurement = MessageSchema<0x21, Endian::Little, uint32_t>;
+    REQUIRE(LittleMeasurement::encode(0x01020304) == std::vector<uint8_t>{0x21, 0x04, 0x03, 0x02, 0x01});
+}
+
+TEST_CASE( "TypedMessage bytes fields are viewed", "" ) {
+    std::string name = "node";
+    auto payload = Identification::encode(42, std::array<uint8_t, 4>{1, 2, 3, 4}, ConstBuffer(name.data(), name.size()));
+
+    auto view = MessageView<Identification>::validate(payload).unwrap();
+    REQUIRE(view.get<0>() == 42);
+    ConstBuffer busId = view.get<1>();
+    REQUIRE(busId.data() == payload.data() + 2);
+    REQUIRE(busId.toVector() == std::vector<uint8_t>{1, 2, 3, 4});
+    // zero padded:
+    REQUIRE(view.get<2>().toVector() == std::vector<uint8_t>{'n', 'o', 'd', 'e', 0, 0, 0, 0});
+    REQUIRE(view.bytes().data() == payload.data());
+
+    std::string longName = "much too long";
+    REQUIRE_THROWS_AS(Identification::encode(1, ConstBuffer(), ConstBuffer(longName.data(), longName.size())), std::length_error);
+}
+
+TEST_CASE( "TypedMessage encodeInto", "" ) {
+    std::array<uint8_t, 20> buffer{};
+    REQUIRE(Identification::encodeInto(buffer, 7, ConstBuffer(), ConstBuffer()) == Identification::size);
+    REQUIRE(buffer[0] == 0x20);
+    REQUIRE(buffer[1] == 7);
+
+    std::array<uint8_t, 4> small{};
+    REQUIRE_THROWS_AS(Identification::encodeInto(small, 7, ConstBuffer(), ConstBuffer()), std::length_error);
+}
+
+TEST_CASE( "TypedMessage validation", "" ) {
+    auto payload = Identification::encode(42, ConstBuffer(), ConstBuffer());
+    REQUIRE(MessageView<Identification>::validate(payload).isValid() == true);
+    REQUIRE(MessageView<Measurement>::validate(payload).isValid() == false);
+
+    payload.pop_back();
+    REQUIRE(MessageView<Identification>::validate(payload).isValid() == false);
+    REQUIRE(MessageView<Identification>::validate(ConstBuffer()).isValid() == false);
+}
+
+TEST_CASE( "TypedMessage dispatcher", "" ) {
+    MessageDispatcher<Identification, Measurement, Ping> dispatcher;
+    std::vector<int> calls;
+    dispatcher.on<Identification>([&](const MessageView<Identification> & f_message)
+        {
+            calls.push_back(f_message.get<0>());
+        });
+    dispatcher.on<Ping>([&](const MessageView<Ping> &)
+        {
+            calls.push_back(-1);
+        });
+
+    REQUIRE(dispatcher.dispatch(Identification::encode(5, ConstBuffer(), ConstBuffer())) == true);
+    REQUIRE(dispatcher.dispatch(Ping::encode()) == true);
+    // no handler:
+    REQUIRE(dispatcher.dispatch(Measurement::encode(1, 2, Mode::Off, 3.0)) == false);
+    // unknown tag, invalid size, empty:
+    REQUIRE(dispatcher.dispatch(std::vector<uint8_t>{0x30}) == false);
+    REQUIRE(dispatcher.dispatch(std::vector<uint8_t>{0x20, 1}) == false);
+    REQUIRE(dispatcher.dispatch(ConstBuffer()) == false);
+    REQUIRE(calls == std::vector<int>{5, -1});
+}
@@ -0,0 +1,157 @@
+// Copyright 2021 Rainer Schoenberger
+// 
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+// 
+//     http://www.apache.org/licenses/LICENSE-2.0
+// 
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Tests the full stack (PjonHL + real PJON) on top of the VirtualMedium
+// strategy. Built as separate executable, as the other tests replace PJON by a
+// mock.
+
+#include "catch2/catch.hpp"
+
+#include <PJON.h>
+#include "PjonHlBus.hpp"
+#include "strategies/VirtualMedium.hpp"
+#include "strategies/VirtualRemoteNode.hpp"
+
+using PjonHL::Address;
+using PjonHL::Bus;
+using PjonHL::VirtualMedium;
+using PjonHL::VirtualRemoteNode;
+using PjonHL::VirtualWire;
+
+namespace
+{
+class SilentLogger : public PjonHL::Logger
+{
+    public:
+        virtual void log(LogLevel f_level, std::string f_message) override
+        {
+        }
+};
+
+std::unique_ptr<PjonHL::Logger> silentLogger()
+{
+    auto logger = std::make_unique<SilentLogger>();
+    logger->setLevel(PjonHL::Logger::Error);
+    return logger;
+}
+}
+
+TEST_CASE( "VirtualMedium stack echo", "" ) {
+    VirtualWire::Config config;
+    config.baudRate = 115200;
+    config.seed = 1;
+    auto wire = std::make_shared<VirtualWire>(config);
+    VirtualRemoteNode node(wire, Address{42}, VirtualRemoteNode::echo());
+    Bus<VirtualMedium> bus(Address{36}, VirtualMedium(wire), PjonHL::BusConfig{}, silentLogger());
+    auto connection = bus.createConnection(Address{42});
+
+    for(uint8_t i = 0; i < 10; i++)
+    {
+        REQUIRE(connection->send({i, 0xab, 0xcd}).get().isGood());
+        auto packet = connection->receive(1000);
+        REQUIRE(packet.isValid());
+        auto data = packet.unwrap();
+        REQUIRE(data.payload == std::vector<uint8_t>{i, 0xab, 0xcd});
+        // VirtualMedium reports the frame start, which is at least the air
+        // time of the frame before PJON delivers it:
+        REQUIRE(data.frameStartTime + wire->getAirTime(3) <= data.rxTime);
+    }
+    REQUIRE(node.getReceivedCount() == 10);
+    REQUIRE(node.getSentCount() == 10);
+}
+
+TEST_CASE( "VirtualMedium stack script", "" ) {
+    VirtualWire::Config config;
+    config.baudRate = 0;
+    auto wire = std::make_shared<VirtualWire>(config);
+    VirtualRemoteNode node(wire, Address{42}, VirtualRemoteNode::script({{{1}}, {}, {{2}, {3}}}));
+    Bus<VirtualMedium> bus(Address{36}, VirtualMedium(wire), PjonHL::BusConfig{}, silentLogger());
+    auto connection = bus.createConnection(Address{42});
+
+    auto receiveResponses = [&connection]
+        {
+            std::vector<uint8_t> received;
+            while(true)
+            {
+                auto packet = connection->receive(100);
+                if(not packet.isValid())
+                {
+                    return received;
+                }
+                received.push_back(packet.unwrap().payload.at(0));
+            }
+        };
+
+    REQUIRE(connection->send({0x00}).get().isGood());
+    REQUIRE(receiveResponses() == std::vector<uint8_t>{1});
+    REQUIRE(connection->send({0x00}).get().isGood());
+    REQUIRE(receiveResponses() == std::vector<uint8_t>{});
+    REQUIRE(connection->send({0x00}).get().isGood());
+    REQUIRE(receiveResponses() == std::vector<uint8_t>{2, 3});
+    REQUIRE(connection->send({0x00}).get().isGood());
+    REQUIRE(receiveResponses() == std::vector<uint8_t>{1});
+}
+
+TEST_CASE( "VirtualMedium stack unknown remote", "" ) {
+    VirtualWire::Config config;
+    config.baudRate = 0;
+    config.responseTimeoutMicroseconds = 1000;
+    config.maxAttempts = 3;
+    config.backOffMicroseconds = 100;
+    auto wire = std::make_shared<VirtualWire>(config);
+    VirtualRemoteNode node(wire, Address{42});
+    Bus<VirtualMedium> bus(Address{36}, VirtualMedium(wire), PjonHL::BusConfig{}, silentLogger());
+    auto connection = bus.createConnection(Address{43});
+
+    REQUIRE(connection->send({0x00}, 1000, false).get().isGood() == false);
+    REQUIRE(node.getReceivedCount() == 0);
+}
+
+TEST_CASE( "VirtualMedium stack lossy wire", "" ) {
+    VirtualWire::Config config;
+    config.baudRate = 0;
+    config.lossRate = 0.2;
+    config.bitErrorRate = 0.001;
+    config.responseTimeoutMicroseconds = 2000;
+    config.backOffMicroseconds = 200;
+    config.seed = 7;
+    auto wire = std::make_shared<VirtualWire>(config);
+    VirtualRemoteNode node(wire, Address{42});
+    Bus<VirtualMedium> bus(Address{36}, VirtualMedium(wire), PjonHL::BusConfig{}, silentLogger());
+    auto connection = bus.createConnection(Address{42});
+
+    // PJON retries hide the losses:
+    size_t good = 0;
+    for(int i = 0; i < 50; i++)
+    {
+        good += connection->send({0x01, 0x02, 0x03, 0x04}, 5000).get().isGood();
+    }
+    REQUIRE(good == 50);
+    REQUIRE(wire->getStatistics().lostDeliveries > 0);
+    REQUIRE(node.getReceivedCount() >= 50);
+}
+
+TEST_CASE( "VirtualMedium stack unsolicited", "" ) {
+    VirtualWire::Config config;
+    config.baudRate = 0;
+    auto wire = std::make_shared<VirtualWire>(config);
+    Bus<VirtualMedium> bus(Address{36}, VirtualMedium(wire), PjonHL::BusConfig{}, silentLogger());
+    auto connection = bus.createConnection(Address{42});
+    VirtualRemoteNode node(wire, Address{42});
+
+    node.send(Address{36}, {0xca, 0xfe});
+    auto packet = connection->receive(1000);
+    REQUIRE(packet.isValid());
+    REQUIRE(packet.unwrap().payload == std::vector<uint8_t>{0xca, 0xfe});
+}
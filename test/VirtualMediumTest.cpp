@@ -0,0 +1,195 @@
+// Copyright 2021 Rainer Schoenberger
+// 
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+// 
+//     http://www.apache.org/licenses/LICENSE-2.0
+// 
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "catch2/catch.hpp"
+
+#include "strategies/VirtualMedium.hpp"
+#include <future>
+#include <thread>
+
+using PjonHL::VirtualMedium;
+using PjonHL::VirtualWire;
+
+TEST_CASE( "VirtualMedium frame delivery", "" ) {
+    VirtualWire::Config config;
+    config.baudRate = 0;
+    auto wire = std::make_shared<VirtualWire>(config);
+    VirtualMedium a(wire);
+    VirtualMedium b(wire);
+    VirtualMedium c(wire);
+
+    uint8_t frame[] = {1, 2, 3, 4};
+    uint8_t buffer[16];
+    REQUIRE(b.receive_frame(buffer, sizeof(buffer)) == PJON_FAIL);
+    a.send_frame(frame, sizeof(frame));
+
+    // everyone but the sender receives the frame:
+    REQUIRE(a.receive_frame(buffer, sizeof(buffer)) == PJON_FAIL);
+    REQUIRE(b.receive_frame(buffer, sizeof(buffer)) == 4);
+    REQUIRE(std::vector<uint8_t>(buffer, buffer + 4) == std::vector<uint8_t>{1, 2, 3, 4});
+    REQUIRE(b.receive_frame(buffer, sizeof(buffer)) == PJON_FAIL);
+    REQUIRE(c.receive_frame(buffer, sizeof(buffer)) == 4);
+
+    // truncated to buffer size:
+    a.send_frame(frame, sizeof(frame));
+    REQUIRE(b.receive_frame(buffer, 2) == 2);
+    REQUIRE(wire->getStatistics().transmissions == 2);
+}
+
+TEST_CASE( "VirtualMedium air time", "" ) {
+    VirtualWire::Config config;
+    config.baudRate = 100000;
+    config.propagationDelayMicroseconds = 5000;
+    auto wire = std::make_shared<VirtualWire>(config);
+    VirtualMedium a(wire);
+    VirtualMedium b(wire);
+
+    // 200 bytes * 10 bits at 100 kBaud = 20ms
+    REQUIRE(wire->getAirTime(200) == std::chrono::milliseconds(20));
+    std::vector<uint8_t> frame(200, 0xab);
+    auto start = std::chrono::steady_clock::now();
+    a.send_frame(frame.data(), frame.size());
+    REQUIRE(std::chrono::steady_clock::now() - start >= std::chrono::milliseconds(20));
+
+    // still propagating (unless this thread was descheduled for long):
+    uint8_t buffer[256];
+    if(std::chrono::steady_clock::now() - start < std::chrono::milliseconds(24))
+    {
+        REQUIRE(b.receive_frame(buffer, sizeof(buffer)) == PJON_FAIL);
+    }
+    REQUIRE(b.waitForFrame(std::chrono::milliseconds(100)));
+    REQUIRE(std::chrono::steady_clock::now() - start >= std::chrono::milliseconds(25));
+    REQUIRE(b.receive_frame(buffer, sizeof(buffer)) == 200);
+
+    // first bit arrived after propagation delay:
+    REQUIRE(b.getLastFrameStartTime() >= start + std::chrono::milliseconds(5));
+    REQUIRE(b.getLastFrameStartTime() <= std::chrono::steady_clock::now() - std::chrono::milliseconds(20));
+}
+
+TEST_CASE( "VirtualMedium response", "" ) {
+    VirtualWire::Config config;
+    config.baudRate = 0;
+    config.responseTimeoutMicroseconds = 10000;
+    auto wire = std::make_shared<VirtualWire>(config);
+    VirtualMedium a(wire);
+    VirtualMedium b(wire);
+
+    uint8_t frame[] = {1, 2, 3};
+    a.send_frame(frame, sizeof(frame));
+    auto responder = std::async(std::launch::async, [&b]
+            {
+                b.waitForFrame(std::chrono::seconds(1));
+                uint8_t buffer[16];
+                b.receive_frame(buffer, sizeof(buffer));
+                b.send_response(PJON_ACK);
+            });
+    REQUIRE(a.receive_response() == PJON_ACK);
+    responder.get();
+
+    // no response:
+    a.send_frame(frame, sizeof(frame));
+    auto start = std::chrono::steady_clock::now();
+    REQUIRE(a.receive_response() == PJON_FAIL);
+    REQUIRE(std::chrono::steady_clock::now() - start >= std::chrono::milliseconds(10));
+}
+
+TEST_CASE( "VirtualMedium loss and bit errors", "" ) {
+    uint8_t frame[] = {0x00, 0x0f, 0xaa};
+    uint8_t buffer[16];
+    {
+        VirtualWire::Config config;
+        config.baudRate = 0;
+        config.lossRate = 1.0;
+        auto wire = std::make_shared<VirtualWire>(config);
+        VirtualMedium a(wire);
+        VirtualMedium b(wire);
+        a.send_frame(frame, sizeof(frame));
+        REQUIRE(b.receive_frame(buffer, sizeof(buffer)) == PJON_FAIL);
+        REQUIRE(wire->getStatistics().lostDeliveries == 1);
+    }
+    {
+        VirtualWire::Config config;
+        config.baudRate = 0;
+        config.bitErrorRate = 1.0;
+        auto wire = std::make_shared<VirtualWire>(config);
+        VirtualMedium a(wire);
+        VirtualMedium b(wire);
+        a.send_frame(frame, sizeof(frame));
+        REQUIRE(b.receive_frame(buffer, sizeof(buffer)) == 3);
+        REQUIRE(std::vector<uint8_t>(buffer, buffer + 3) == std::vector<uint8_t>{0xff, 0xf0, 0x55});
+        REQUIRE(wire->getStatistics().corruptedDeliveries == 1);
+    }
+    {
+        VirtualWire::Config config;
+        config.baudRate = 0;
+        config.bitErrorRate = 0.01;
+        config.seed = 42;
+        auto wire = std::make_shared<VirtualWire>(config);
+        VirtualMedium a(wire);
+        VirtualMedium b(wire);
+        std::vector<uint8_t> zeros(1000, 0);
+        a.send_frame(zeros.data(), zeros.size());
+        std::vector<uint8_t> received(1000);
+        REQUIRE(b.receive_frame(received.data(), received.size()) == 1000);
+        size_t flippedBits = 0;
+        for(uint8_t byte : received)
+        {
+            flippedBits += __builtin_popcount(byte);
+        }
+        // 8000 bits at 1%:
+        REQUIRE(flippedBits > 40);
+        REQUIRE(flippedBits < 120);
+    }
+}
+
+TEST_CASE( "VirtualMedium collision", "" ) {
+    VirtualWire::Config config;
+    config.baudRate = 10000;
+    config.propagationDelayMicroseconds = 1000;
+    auto wire = std::make_shared<VirtualWire>(config);
+    VirtualMedium a(wire);
+    VirtualMedium b(wire);
+    VirtualMedium c(wire);
+
+    // 50 bytes = 50ms
+    std::vector<uint8_t> frame(50, 0x11);
+    REQUIRE(b.can_start());
+    auto sender = std::async(std::launch::async, [&a, &frame]{ a.send_frame(frame.data(), frame.size()); });
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    // carrier sense:
+    REQUIRE(not b.can_start());
+    REQUIRE(c.receive_frame(frame.data(), frame.size()) == PJON_FAIL);
+
+    // b ignores the busy wire:
+    std::vector<uint8_t> otherFrame(5, 0x22);
+    b.send_frame(otherFrame.data(), otherFrame.size());
+    sender.get();
+    REQUIRE(c.waitForFrame(std::chrono::milliseconds(100)));
+
+    std::vector<uint8_t> buffer(64);
+    REQUIRE(c.receive_frame(buffer.data(), buffer.size()) == 50);
+    REQUIRE(std::vector<uint8_t>(buffer.begin(), buffer.begin() + 50) != std::vector<uint8_t>(50, 0x11));
+    REQUIRE(wire->getStatistics().collisions == 1);
+    REQUIRE(wire->getStatistics().corruptedDeliveries >= 1);
+}
+
+TEST_CASE( "VirtualMedium not attached", "" ) {
+    VirtualMedium medium;
+    uint8_t frame[] = {1};
+    REQUIRE(medium.begin() == false);
+    REQUIRE(medium.can_start() == false);
+    medium.send_frame(frame, 1);
+    REQUIRE(medium.receive_frame(frame, 1) == PJON_FAIL);
+    REQUIRE(medium.receive_response() == PJON_FAIL);
+}
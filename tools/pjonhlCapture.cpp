@@ -0,0 +1,189 @@
+// Copyright 2021 Rainer Schoenberger
+// 
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+// 
+//     http://www.apache.org/licenses/LICENSE-2.0
+// 
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Offline converter for capture files written by PjonHL::TrafficCapture
+// (see Bus::setTrafficCapture()).
+//
+// Usage:
+//   pjonhlCapture <capture file>                  print records as text
+//   pjonhlCapture <capture file> --pcap <out>     convert to pcap
+//
+// Text output, one record per line:
+//   <utc time> <TX|RX> <source> -> <destination> id=<packet id> len=<length> <hex payload>
+//
+// The pcap file uses link type LINKTYPE_USER0 (147). Each packet consists of
+// the following pseudo header followed by the captured payload:
+//
+//   offset size
+//        0    1  direction (0 = TX, 1 = RX)
+//        1    4  source bus id
+//        5    1  source device id
+//        6    4  destination bus id
+//       10    1  destination device id
+//       11    2  port (big endian)
+//       13    2  packet id (big endian, 0 if not used)
+//
+// In Wireshark it can be decoded by assigning a dissector to DLT User 0.
+
+#include "TrafficCapture.hpp"
+
+#include <cstdio>
+#include <ctime>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+namespace
+{
+
+constexpr uint32_t PcapLinkTypeUser0 = 147;
+constexpr uint32_t PcapPseudoHeaderSize = 15;
+
+template<typename T>
+void writeValue(std::ofstream & f_file, T f_value)
+{
+    f_file.write(reinterpret_cast<const char*>(&f_value), sizeof(f_value));
+}
+
+void printRecord(const PjonHL::TrafficCapture::Record & f_record)
+{
+    std::time_t seconds = f_record.unixNanoseconds / 1000000000;
+    long microseconds = (f_record.unixNanoseconds % 1000000000) / 1000;
+    std::tm utc;
+    gmtime_r(&seconds, &utc);
+    char time[32];
+    std::strftime(time, sizeof(time), "%Y-%m-%d %H:%M:%S", &utc);
+
+    char prefix[128];
+    std::snprintf(prefix, sizeof(prefix), "%s.%06ld %s ",
+            time,
+            microseconds,
+            f_record.direction == PjonHL::TrafficCapture::Direction::Tx ? "TX" : "RX"
+            );
+    std::cout << prefix << f_record.source << " -> " << f_record.destination
+        << " id=" << f_record.packetId
+        << " len=" << f_record.payloadLength << " ";
+    for(uint8_t byte : f_record.payload)
+    {
+        char hex[3];
+        std::snprintf(hex, sizeof(hex), "%02x", byte);
+        std::cout << hex;
+    }
+    if(f_record.payload.size() < f_record.payloadLength)
+    {
+        std::cout << "...";
+    }
+    std::cout << "\n";
+}
+
+void writePcap(const std::string & f_path, const std::vector<PjonHL::TrafficCapture::Record> & f_records)
+{
+    std::ofstream file(f_path, std::ios::binary | std::ios::trunc);
+    if(not file)
+    {
+        throw std::runtime_error("Could not open " + f_path);
+    }
+    // global header (native byte order, readers detect it via the magic):
+    writeValue<uint32_t>(file, 0xa1b2c3d4);
+    writeValue<uint16_t>(file, 2);
+    writeValue<uint16_t>(file, 4);
+    writeValue<int32_t>(file, 0);
+    writeValue<uint32_t>(file, 0);
+    writeValue<uint32_t>(file, 65535 + PcapPseudoHeaderSize);
+    writeValue<uint32_t>(file, PcapLinkTypeUser0);
+
+    for(const auto & record : f_records)
+    {
+        writeValue<uint32_t>(file, record.unixNanoseconds / 1000000000);
+        writeValue<uint32_t>(file, (record.unixNanoseconds % 1000000000) / 1000);
+        writeValue<uint32_t>(file, PcapPseudoHeaderSize + record.payload.size());
+        writeValue<uint32_t>(file, PcapPseudoHeaderSize + record.payloadLength);
+
+        uint8_t header[PcapPseudoHeaderSize];
+        header[0] = static_cast<uint8_t>(record.direction);
+        std::copy(record.source.busId.begin(), record.source.busId.end(), header + 1);
+        header[5] = record.source.id;
+        std::copy(record.destination.busId.begin(), record.destination.busId.end(), header + 6);
+        header[10] = record.destination.id;
+        header[11] = record.destination.port >> 8;
+        header[12] = record.destination.port & 0xff;
+        header[13] = record.packetId >> 8;
+        header[14] = record.packetId & 0xff;
+        file.write(reinterpret_cast<const char*>(header), sizeof(header));
+        file.write(reinterpret_cast<const char*>(record.payload.data()), record.payload.size());
+    }
+    if(not file)
+    {
+        throw std::runtime_error("Could not write " + f_path);
+    }
+}
+
+}
+
+int main(int argc, char * argv[])
+{
+    std::string capturePath;
+    std::string pcapPath;
+    for(int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        if(arg == "--pcap" and i + 1 < argc)
+        {
+            pcapPath = argv[++i];
+        }
+        else if(arg.size() > 0 and arg[0] != '-' and capturePath.empty())
+        {
+            capturePath = arg;
+        }
+        else
+        {
+            capturePath.clear();
+            break;
+        }
+    }
+    if(capturePath.empty())
+    {
+        std::cerr << "Usage: " << argv[0] << " <capture file> [--pcap <output file>]\n";
+        return 1;
+    }
+
+    try
+    {
+        PjonHL::TrafficCapture::FileHeader header;
+        auto records = PjonHL::TrafficCapture::readFile(capturePath, &header);
+        if(header.recordCount > header.slotCount)
+        {
+            std::cerr << (header.recordCount - header.slotCount) << " oldest records were overwritten.\n";
+        }
+        if(pcapPath.empty())
+        {
+            for(const auto & record : records)
+            {
+                printRecord(record);
+            }
+        }
+        else
+        {
+            writePcap(pcapPath, records);
+            std::cerr << "Wrote " << records.size() << " records to " << pcapPath << "\n";
+        }
+    }
+    catch(const std::exception & e)
+    {
+        std::cerr << e.what() << "\n";
+        return 1;
+    }
+    return 0;
+}
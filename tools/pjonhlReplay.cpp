@@ -0,0 +1,163 @@
+// Copyright 2021 Rainer Schoenberger
+// 
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+// 
+//     http://www.apache.org/licenses/LICENSE-2.0
+// 
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Replays a trace recorded with PjonHL::RecordingStrategy through a Bus and
+// reports how fast the packets were delivered to a consumer connection
+// receiving everything addressed to the bus.
+//
+// Usage:
+//   pjonhlReplay <trace file> --local <address> [--speed <factor> | --fast] [--no-ack]
+//
+//   --local <address>  address of the recording Bus, e.g. 0.0.0.0/36
+//   --speed <factor>   replay <factor> times faster than recorded
+//   --fast             replay as fast as possible
+//   --no-ack           do not ACK packets sent by the Bus during replay
+//
+// Exit code is 0 if all frames were injected, 2 otherwise.
+
+#include <PJON.h>
+#include "PjonHlBus.hpp"
+#include "strategies/ReplayStrategy.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <string>
+
+namespace
+{
+class SilentLogger : public PjonHL::Logger
+{
+    public:
+        virtual void log(LogLevel f_level, std::string f_message) override
+        {
+        }
+};
+
+void printUsage(const char * f_name)
+{
+    std::cerr << "Usage: " << f_name << " <trace file> --local <address> [--speed <factor> | --fast] [--no-ack]\n";
+}
+}
+
+int main(int argc, char * argv[])
+{
+    std::string tracePath;
+    PjonHL::Address localAddress;
+    bool hasLocalAddress = false;
+    PjonHL::ReplayConfig config;
+    config.autoStart = false;
+    try
+    {
+        for(int i = 1; i < argc; i++)
+        {
+            std::string arg = argv[i];
+            if(arg == "--local" and i + 1 < argc)
+            {
+                localAddress = PjonHL::Address(argv[++i]);
+                hasLocalAddress = true;
+            }
+            else if(arg == "--speed" and i + 1 < argc)
+            {
+                config.timing = PjonHL::ReplayConfig::Timing::SpeedUp;
+                config.speedUp = std::stod(argv[++i]);
+            }
+            else if(arg == "--fast")
+            {
+                config.timing = PjonHL::ReplayConfig::Timing::AsFastAsPossible;
+            }
+            else if(arg == "--no-ack")
+            {
+                config.acknowledge = false;
+            }
+            else if(arg.size() > 0 and arg[0] != '-' and tracePath.empty())
+            {
+                tracePath = arg;
+            }
+            else
+            {
+                printUsage(argv[0]);
+                return 1;
+            }
+        }
+    }
+    catch(const std::exception & e)
+    {
+        std::cerr << "Invalid argument: " << e.what() << "\n";
+        return 1;
+    }
+    if(tracePath.empty() or not hasLocalAddress or config.speedUp <= 0)
+    {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    PjonHL::ReplayTrace trace;
+    try
+    {
+        trace = PjonHL::ReplayTrace::load(tracePath);
+    }
+    catch(const std::exception & e)
+    {
+        std::cerr << e.what() << "\n";
+        return 1;
+    }
+    auto session = std::make_shared<PjonHL::ReplaySession>(std::move(trace), config);
+
+    uint64_t packets = 0;
+    uint64_t bytes = 0;
+    auto logger = std::make_unique<SilentLogger>();
+    logger->setLevel(PjonHL::Logger::Error);
+    PjonHL::Bus<PjonHL::ReplayStrategy> bus(localAddress, PjonHL::ReplayStrategy(session), PjonHL::BusConfig{}, std::move(logger));
+    auto connection = bus.createDetachedConnection(
+            PjonHL::Address(),
+            localAddress,
+            PjonHL::Address("0.0.0.0/0:0"), // any remote
+            PjonHL::Address("255.255.255.255/255:0") // any port
+            );
+    session->start();
+    while(true)
+    {
+        auto packet = connection->receive(100);
+        if(packet.isValid())
+        {
+            packets++;
+            bytes += packet.unwrap().payload.size();
+        }
+        else if(session->isFinished())
+        {
+            break;
+        }
+    }
+    // duration until the last frame was injected, i.e. without the final
+    // receive timeout:
+    auto statistics = session->getStatistics();
+    auto duration = std::chrono::duration<double>(statistics.duration).count();
+    auto comparison = session->compare();
+    std::printf("frames injected:    %" PRIu64 " (%" PRIu64 " bytes, %" PRIu64 " dropped as too large)\n", statistics.framesInjected, statistics.bytesInjected, statistics.framesDropped);
+    std::printf("packets received:   %" PRIu64 " (%" PRIu64 " bytes payload)\n", packets, bytes);
+    std::printf("replay duration:    %.3f s\n", duration);
+    if(duration > 0)
+    {
+        std::printf("throughput:         %.0f packets/s\n", packets / duration);
+    }
+    std::printf("frames transmitted: %" PRIu64 " (%" PRIu64 " matching trace, %" PRIu64 " differing, %" PRIu64 " missing, %" PRIu64 " unexpected)\n",
+            statistics.framesTransmitted,
+            comparison.matched,
+            comparison.mismatched,
+            comparison.missing,
+            comparison.unexpected
+            );
+    return session->isFinished() ? 0 : 2;
+}